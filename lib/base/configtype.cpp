@@ -43,6 +43,9 @@ void ConfigType::RegisterObject(const ConfigObject::Ptr& object)
 
 		m_ObjectMap[name] = object;
 		m_ObjectVector.push_back(object);
+
+		m_Snapshot.reset();
+		m_TypedSnapshots.clear();
 	}
 }
 
@@ -55,18 +58,40 @@ void ConfigType::UnregisterObject(const ConfigObject::Ptr& object)
 
 		m_ObjectMap.erase(name);
 		m_ObjectVector.erase(std::remove(m_ObjectVector.begin(), m_ObjectVector.end(), object), m_ObjectVector.end());
+
+		m_Snapshot.reset();
+		m_TypedSnapshots.clear();
 	}
 }
 
-std::vector<ConfigObject::Ptr> ConfigType::GetObjects() const
+/**
+ * Returns all objects of this type, see ConfigObjectsSnapshot.
+ */
+ConfigObjectsSnapshot<ConfigObject> ConfigType::GetObjects() const
 {
-	std::shared_lock<decltype(m_Mutex)> lock (m_Mutex);
-	return m_ObjectVector;
+	return GetUntypedSnapshot();
+}
+
+std::shared_ptr<const ConfigType::ObjectVector> ConfigType::GetUntypedSnapshot() const
+{
+	{
+		std::shared_lock<decltype(m_Mutex)> lock (m_Mutex);
+
+		if (m_Snapshot)
+			return m_Snapshot;
+	}
+
+	std::unique_lock<decltype(m_Mutex)> lock (m_Mutex);
+
+	if (!m_Snapshot)
+		m_Snapshot = std::make_shared<const ObjectVector>(m_ObjectVector);
+
+	return m_Snapshot;
 }
 
-std::vector<ConfigObject::Ptr> ConfigType::GetObjectsHelper(Type *type)
+ConfigType *ConfigType::GetConfigType(Type *type)
 {
-	return static_cast<TypeImpl<ConfigObject> *>(type)->GetObjects();
+	return static_cast<TypeImpl<ConfigObject> *>(type);
 }
 
 int ConfigType::GetObjectCount() const
@@ -7,14 +7,73 @@
 #include "base/object.hpp"
 #include "base/type.hpp"
 #include "base/dictionary.hpp"
+#include <memory>
 #include <shared_mutex>
+#include <typeindex>
 #include <unordered_map>
+#include <vector>
 
 namespace icinga
 {
 
 class ConfigObject;
 
+/**
+ * An immutable snapshot of all objects of a type.
+ *
+ * All readers share the same snapshot until an object is (un)registered, so
+ * iterating over it neither copies the objects nor touches their refcounts.
+ *
+ * @ingroup base
+ */
+template<typename T>
+class ConfigObjectsSnapshot
+{
+public:
+	typedef std::vector<intrusive_ptr<T> > Vector;
+	typedef typename Vector::const_iterator const_iterator;
+	typedef const_iterator iterator;
+	typedef typename Vector::size_type size_type;
+	typedef typename Vector::value_type value_type;
+
+	ConfigObjectsSnapshot(std::shared_ptr<const Vector> objects)
+		: m_Objects(std::move(objects))
+	{ }
+
+	const_iterator begin() const
+	{
+		return m_Objects->begin();
+	}
+
+	const_iterator end() const
+	{
+		return m_Objects->end();
+	}
+
+	size_type size() const
+	{
+		return m_Objects->size();
+	}
+
+	bool empty() const
+	{
+		return m_Objects->empty();
+	}
+
+	const intrusive_ptr<T>& operator[](size_type index) const
+	{
+		return (*m_Objects)[index];
+	}
+
+	operator Vector() const
+	{
+		return *m_Objects;
+	}
+
+private:
+	std::shared_ptr<const Vector> m_Objects;
+};
+
 class ConfigType
 {
 public:
@@ -25,7 +84,7 @@ public:
 	void RegisterObject(const intrusive_ptr<ConfigObject>& object);
 	void UnregisterObject(const intrusive_ptr<ConfigObject>& object);
 
-	std::vector<intrusive_ptr<ConfigObject> > GetObjects() const;
+	ConfigObjectsSnapshot<ConfigObject> GetObjects() const;
 
 	template<typename T>
 	static TypeImpl<T> *Get()
@@ -35,15 +94,9 @@ public:
 	}
 
 	template<typename T>
-	static std::vector<intrusive_ptr<T> > GetObjectsByType()
+	static ConfigObjectsSnapshot<T> GetObjectsByType()
 	{
-		std::vector<intrusive_ptr<ConfigObject> > objects = GetObjectsHelper(T::TypeInstance.get());
-		std::vector<intrusive_ptr<T> > result;
-		result.reserve(objects.size());
-for (const auto& object : objects) {
-			result.push_back(static_pointer_cast<T>(object));
-		}
-		return result;
+		return GetConfigType(T::TypeInstance.get())->template GetSnapshot<T>();
 	}
 
 	int GetObjectCount() const;
@@ -56,7 +109,49 @@ private:
 	ObjectMap m_ObjectMap;
 	ObjectVector m_ObjectVector;
 
-	static std::vector<intrusive_ptr<ConfigObject> > GetObjectsHelper(Type *type);
+	/* Built on demand and dropped on (un)register, m_TypedSnapshots holds a std::vector<intrusive_ptr<T>> per T */
+	mutable std::shared_ptr<const ObjectVector> m_Snapshot;
+	mutable std::unordered_map<std::type_index, std::shared_ptr<const void> > m_TypedSnapshots;
+
+	static ConfigType *GetConfigType(Type *type);
+
+	std::shared_ptr<const ObjectVector> GetUntypedSnapshot() const;
+
+	template<typename T>
+	ConfigObjectsSnapshot<T> GetSnapshot() const
+	{
+		typedef typename ConfigObjectsSnapshot<T>::Vector Vector;
+
+		std::type_index type (typeid(T));
+
+		{
+			std::shared_lock<decltype(m_Mutex)> lock (m_Mutex);
+
+			auto it (m_TypedSnapshots.find(type));
+
+			if (it != m_TypedSnapshots.end())
+				return std::static_pointer_cast<const Vector>(it->second);
+		}
+
+		/* Cast the objects without holding the exclusive lock, (un)registering objects doesn't wait for that. */
+		auto objects (GetUntypedSnapshot());
+		auto snapshot (std::make_shared<Vector>());
+		snapshot->reserve(objects->size());
+
+		for (const auto& object : *objects) {
+			snapshot->push_back(static_pointer_cast<T>(object));
+		}
+
+		{
+			std::unique_lock<decltype(m_Mutex)> lock (m_Mutex);
+
+			/* Objects may have been (un)registered in the meantime, don't cache an outdated snapshot. */
+			if (m_Snapshot == objects)
+				m_TypedSnapshots.emplace(type, snapshot);
+		}
+
+		return std::shared_ptr<const Vector>(std::move(snapshot));
+	}
 };
 
 }
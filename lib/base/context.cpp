@@ -1,31 +1,27 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "base/context.hpp"
-#include <boost/thread/tss.hpp>
 #include <iostream>
 #include <sstream>
 #include <utility>
 
 using namespace icinga;
 
-static boost::thread_specific_ptr<std::vector<std::function<void(std::ostream&)>>> l_Frames;
+thread_local std::vector<ContextFrame::Frame> ContextFrame::m_Frames;
 
-ContextFrame::ContextFrame(std::function<void(std::ostream&)> message)
+void ContextFrame::Push(const ContextFrame::Frame& frame)
 {
-	GetFrames().emplace_back(std::move(message));
+	m_Frames.emplace_back(frame);
 }
 
 ContextFrame::~ContextFrame()
 {
-	GetFrames().pop_back();
+	m_Frames.pop_back();
 }
 
-std::vector<std::function<void(std::ostream&)>>& ContextFrame::GetFrames()
+std::vector<ContextFrame::Frame>& ContextFrame::GetFrames()
 {
-	if (!l_Frames.get())
-		l_Frames.reset(new std::vector<std::function<void(std::ostream&)>>());
-
-	return *l_Frames;
+	return m_Frames;
 }
 
 ContextTrace::ContextTrace()
@@ -33,7 +29,7 @@ ContextTrace::ContextTrace()
 	for (auto frame (ContextFrame::GetFrames().rbegin()); frame != ContextFrame::GetFrames().rend(); ++frame) {
 		std::ostringstream oss;
 
-		(*frame)(oss);
+		frame->Format(frame->Message, oss);
 		m_Frames.emplace_back(oss.str());
 	}
 }
@@ -5,7 +5,7 @@
 
 #include "base/i2-base.hpp"
 #include "base/string.hpp"
-#include <functional>
+#include <ostream>
 #include <vector>
 
 namespace icinga
@@ -29,25 +29,48 @@ std::ostream& operator<<(std::ostream& stream, const ContextTrace& trace);
 /**
  * A context frame.
  *
+ * The frame only references its message callable, which is invoked only if
+ * a ContextTrace is actually created, e.g. when logging an exception.
+ * So a frame costs neither a string nor an allocation.
+ *
  * @ingroup base
  */
 class ContextFrame
 {
 public:
-	ContextFrame(std::function<void(std::ostream&)> message);
+	template<typename F>
+	ContextFrame(const F& message)
+	{
+		Push({ &message, [](const void *message, std::ostream& fp) { (*static_cast<const F*>(message))(fp); } });
+	}
+
+	ContextFrame(const ContextFrame&) = delete;
+	ContextFrame& operator=(const ContextFrame&) = delete;
+
 	~ContextFrame();
 
 private:
-	static std::vector<std::function<void(std::ostream&)>>& GetFrames();
+	struct Frame
+	{
+		const void *Message;
+		void (*Format)(const void *message, std::ostream& fp);
+	};
+
+	static thread_local std::vector<Frame> m_Frames;
+
+	static void Push(const Frame& frame);
+	static std::vector<Frame>& GetFrames();
 
 	friend class ContextTrace;
 };
 
-/* The currentContextFrame variable has to be volatile in order to prevent
+/* The message callable has to outlive the frame, so it's a variable of its own.
+ * The currentContextFrame variable has to be volatile in order to prevent
  * the compiler from optimizing it away. */
-#define CONTEXT(message) volatile icinga::ContextFrame currentContextFrame ([&](std::ostream& _CONTEXT_stream) { \
+#define CONTEXT(message) auto currentContextMessage ([&](std::ostream& _CONTEXT_stream) { \
 _CONTEXT_stream << message; \
-})
+}); \
+volatile icinga::ContextFrame currentContextFrame (currentContextMessage)
 
 }
 
@@ -0,0 +1,94 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/deadlinescheduler.hpp"
+#include "base/exception.hpp"
+#include "base/logger.hpp"
+#include "base/utility.hpp"
+#include <vector>
+
+using namespace icinga;
+
+/**
+ * Constructor for the DeadlineScheduler class.
+ *
+ * @param name The name for log messages
+ * @param callback The function to call for due objects, it may (re-)schedule them
+ * @param precision How often to check for due objects, in seconds
+ */
+DeadlineScheduler::DeadlineScheduler(String name, Callback callback, double precision)
+	: m_Name(std::move(name)), m_Callback(std::move(callback))
+{
+	m_Timer = Timer::Create();
+	m_Timer->SetInterval(precision);
+	m_Timer->OnTimerExpired.connect([this](const Timer * const&) { TimerHandler(); });
+	m_Timer->Start();
+}
+
+DeadlineScheduler::~DeadlineScheduler()
+{
+	m_Timer->Stop(true);
+}
+
+/**
+ * Schedules an object, replacing its previous deadline if any.
+ *
+ * @param object The object
+ * @param deadline The UNIX timestamp after which the callback is called for the object
+ */
+void DeadlineScheduler::Schedule(const Object::Ptr& object, double deadline)
+{
+	std::unique_lock<std::mutex> lock (m_Mutex);
+
+	m_Entries.erase(object);
+	m_Entries.insert(Entry{object, deadline});
+}
+
+/**
+ * Removes an object's deadline if any.
+ *
+ * @param object The object
+ */
+void DeadlineScheduler::Unschedule(const Object::Ptr& object)
+{
+	std::unique_lock<std::mutex> lock (m_Mutex);
+
+	m_Entries.erase(object);
+}
+
+/**
+ * Returns the number of scheduled objects.
+ */
+size_t DeadlineScheduler::GetLength() const
+{
+	std::unique_lock<std::mutex> lock (m_Mutex);
+
+	return m_Entries.size();
+}
+
+void DeadlineScheduler::TimerHandler()
+{
+	double now = Utility::GetTime();
+	std::vector<Object::Ptr> due;
+
+	{
+		std::unique_lock<std::mutex> lock (m_Mutex);
+
+		auto& idx (m_Entries.get<1>());
+		auto end (idx.upper_bound(now));
+
+		for (auto it (idx.begin()); it != end; ++it) {
+			due.emplace_back(it->Target);
+		}
+
+		idx.erase(idx.begin(), end);
+	}
+
+	for (auto& object : due) {
+		try {
+			m_Callback(object);
+		} catch (const std::exception& ex) {
+			Log(LogCritical, "DeadlineScheduler")
+				<< "Exception occurred in scheduler '" << m_Name << "': " << DiagnosticInformation(ex, false);
+		}
+	}
+}
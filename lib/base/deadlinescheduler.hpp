@@ -0,0 +1,69 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef DEADLINESCHEDULER_H
+#define DEADLINESCHEDULER_H
+
+#include "base/i2-base.hpp"
+#include "base/object.hpp"
+#include "base/timer.hpp"
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <functional>
+#include <mutex>
+
+namespace icinga
+{
+
+/**
+ * Calls a function for objects whose deadline has passed.
+ *
+ * Unlike a timer per object (or a timer which checks all objects of a type),
+ * a scheduler only visits the objects which are actually due, no matter how
+ * many objects are scheduled. Each object has at most one deadline.
+ *
+ * @ingroup base
+ */
+class DeadlineScheduler final : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(DeadlineScheduler);
+
+	typedef std::function<void (const Object::Ptr&)> Callback;
+
+	DeadlineScheduler(String name, Callback callback, double precision = 1);
+	~DeadlineScheduler() override;
+
+	void Schedule(const Object::Ptr& object, double deadline);
+	void Unschedule(const Object::Ptr& object);
+
+	size_t GetLength() const;
+
+private:
+	struct Entry
+	{
+		Object::Ptr Target;
+		double Deadline;
+	};
+
+	typedef boost::multi_index_container<
+		Entry,
+		boost::multi_index::indexed_by<
+			boost::multi_index::ordered_unique<boost::multi_index::member<Entry, Object::Ptr, &Entry::Target> >,
+			boost::multi_index::ordered_non_unique<boost::multi_index::member<Entry, double, &Entry::Deadline> >
+		>
+	> EntrySet;
+
+	String m_Name;
+	Callback m_Callback;
+	Timer::Ptr m_Timer;
+
+	mutable std::mutex m_Mutex;
+	EntrySet m_Entries;
+
+	void TimerHandler();
+};
+
+}
+
+#endif /* DEADLINESCHEDULER_H */
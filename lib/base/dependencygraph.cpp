@@ -1,47 +1,64 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "base/dependencygraph.hpp"
+#include <cstdint>
 
 using namespace icinga;
 
-std::mutex DependencyGraph::m_Mutex;
-std::map<Object *, std::map<Object *, int> > DependencyGraph::m_Dependencies;
+std::array<DependencyGraph::Shard, 64> DependencyGraph::m_Shards;
+
+DependencyGraph::Shard& DependencyGraph::GetShard(Object *child)
+{
+	/* The lower bits of heap addresses are mostly zero due to alignment. */
+	return m_Shards[(reinterpret_cast<uintptr_t>(child) >> 4) % m_Shards.size()];
+}
 
 void DependencyGraph::AddDependency(Object *parent, Object *child)
 {
-	std::unique_lock<std::mutex> lock(m_Mutex);
-	m_Dependencies[child][parent]++;
+	Shard& shard = GetShard(child);
+
+	std::unique_lock<std::shared_timed_mutex> lock(shard.Mutex);
+	shard.Dependencies[child][parent]++;
 }
 
 void DependencyGraph::RemoveDependency(Object *parent, Object *child)
 {
-	std::unique_lock<std::mutex> lock(m_Mutex);
+	Shard& shard = GetShard(child);
+
+	std::unique_lock<std::shared_timed_mutex> lock(shard.Mutex);
 
-	auto& refs = m_Dependencies[child];
-	auto it = refs.find(parent);
+	auto refs = shard.Dependencies.find(child);
 
-	if (it == refs.end())
+	if (refs == shard.Dependencies.end())
+		return;
+
+	auto it = refs->second.find(parent);
+
+	if (it == refs->second.end())
 		return;
 
 	it->second--;
 
 	if (it->second == 0)
-		refs.erase(it);
+		refs->second.erase(it);
 
-	if (refs.empty())
-		m_Dependencies.erase(child);
+	if (refs->second.empty())
+		shard.Dependencies.erase(refs);
 }
 
 std::vector<Object::Ptr> DependencyGraph::GetParents(const Object::Ptr& child)
 {
 	std::vector<Object::Ptr> objects;
 
-	std::unique_lock<std::mutex> lock(m_Mutex);
-	auto it = m_Dependencies.find(child.get());
+	Shard& shard = GetShard(child.get());
+
+	std::shared_lock<std::shared_timed_mutex> lock(shard.Mutex);
+	auto it = shard.Dependencies.find(child.get());
+
+	if (it != shard.Dependencies.end()) {
+		objects.reserve(it->second.size());
 
-	if (it != m_Dependencies.end()) {
-		typedef std::pair<Object *, int> kv_pair;
-		for (const kv_pair& kv : it->second) {
+		for (auto& kv : it->second) {
 			objects.emplace_back(kv.first);
 		}
 	}
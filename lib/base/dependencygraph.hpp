@@ -5,14 +5,18 @@
 
 #include "base/i2-base.hpp"
 #include "base/object.hpp"
-#include <map>
-#include <mutex>
+#include <array>
+#include <shared_mutex>
+#include <unordered_map>
 
 namespace icinga {
 
 /**
  * A graph that tracks dependencies between objects.
  *
+ * The graph is split into shards by child object, each with its own lock,
+ * so that unrelated objects can be updated and queried concurrently.
+ *
  * @ingroup base
  */
 class DependencyGraph
@@ -25,8 +29,15 @@ public:
 private:
 	DependencyGraph();
 
-	static std::mutex m_Mutex;
-	static std::map<Object *, std::map<Object *, int> > m_Dependencies;
+	struct Shard
+	{
+		std::shared_timed_mutex Mutex;
+		std::unordered_map<Object *, std::unordered_map<Object *, int> > Dependencies;
+	};
+
+	static std::array<Shard, 64> m_Shards;
+
+	static Shard& GetShard(Object *child);
 };
 
 }
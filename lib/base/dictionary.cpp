@@ -5,29 +5,183 @@
 #include "base/debug.hpp"
 #include "base/primitivetype.hpp"
 #include "base/configwriter.hpp"
+#include <algorithm>
 #include <sstream>
 
 using namespace icinga;
 
-template class std::map<String, Value>;
+template class std::vector<std::pair<String, Value> >;
 
 REGISTER_PRIMITIVE_TYPE(Dictionary, Object, Dictionary::GetPrototype());
 
+static bool DictionaryKeyLess(const Dictionary::Pair& kv, const String& key)
+{
+	return kv.first < key;
+}
+
 Dictionary::Dictionary(const DictionaryData& other)
+	: m_Data(other)
 {
-	for (const auto& kv : other)
-		m_Data.insert(kv);
+	Normalize();
 }
 
 Dictionary::Dictionary(DictionaryData&& other)
+	: m_Data(std::move(other))
 {
-	for (auto& kv : other)
-		m_Data.insert(std::move(kv));
+	Normalize();
 }
 
 Dictionary::Dictionary(std::initializer_list<Dictionary::Pair> init)
 	: m_Data(init)
-{ }
+{
+	Normalize();
+}
+
+/**
+ * Sorts the pairs passed to a constructor by key and drops all but the first one of duplicate keys.
+ */
+void Dictionary::Normalize()
+{
+	auto keyLess ([](const Pair& lhs, const Pair& rhs) { return lhs.first < rhs.first; });
+
+	if (!std::is_sorted(m_Data.begin(), m_Data.end(), keyLess))
+		std::stable_sort(m_Data.begin(), m_Data.end(), keyLess);
+
+	m_Data.erase(std::unique(m_Data.begin(), m_Data.end(), [](const Pair& lhs, const Pair& rhs) {
+		return lhs.first == rhs.first;
+	}), m_Data.end());
+}
+
+Dictionary::Iterator Dictionary::Find(const String& key)
+{
+	auto it (static_cast<const Dictionary *>(this)->Find(key));
+
+	return m_Data.begin() + (it - m_Data.cbegin());
+}
+
+DictionaryData::const_iterator Dictionary::Find(const String& key) const
+{
+	if (!m_IndexValid.load(std::memory_order_acquire) && !TryRebuildIndex()) {
+		auto it (std::lower_bound(m_Data.begin(), m_Data.end(), key, DictionaryKeyLess));
+
+		if (it == m_Data.end() || it->first != key)
+			return m_Data.end();
+
+		return it;
+	}
+
+	auto position (m_Index[FindIndexSlot(key)]);
+
+	if (!position)
+		return m_Data.end();
+
+	return m_Data.begin() + (position - 1u);
+}
+
+/**
+ * Inserts a new pair. Only appending keeps the hash table valid.
+ *
+ * @param position Where to insert the pair to keep the pairs sorted.
+ * @param key The key, must not exist yet.
+ * @param value The value.
+ */
+void Dictionary::Insert(Dictionary::Iterator position, const String& key, Value value)
+{
+	SizeType offset = position - m_Data.begin();
+
+	m_Data.emplace(position, key, std::move(value));
+
+	/* Appending (e.g. by CopyTo()) doesn't move other pairs. Keep the load factor below 1/2. */
+	if (m_IndexValid.load(std::memory_order_relaxed) && offset + 1u == m_Data.size() && m_Data.size() * 2u <= m_Index.size()) {
+		m_Index[FindIndexSlot(key)] = offset + 1u;
+		return;
+	}
+
+	InvalidateIndex();
+}
+
+/**
+ * Removes a pair and invalidates the hash table.
+ *
+ * @param position The pair.
+ */
+void Dictionary::Erase(Dictionary::Iterator position)
+{
+	m_Data.erase(position);
+
+	InvalidateIndex();
+
+	if (m_Data.size() <= IndexThreshold / 2u)
+		std::vector<uint32_t>().swap(m_Index);
+}
+
+/**
+ * Rebuilds the invalid hash table of a large dictionary once as many lookups as a quarter of its pairs
+ * have fallen back to binary search since it has been invalidated, so that rebuilding it is amortized
+ * over a batch of modifications and lookups.
+ *
+ * May be called concurrently while holding a shared lock, only one caller rebuilds the hash table.
+ *
+ * @returns Whether the hash table is valid.
+ */
+bool Dictionary::TryRebuildIndex() const
+{
+	if (m_Data.size() <= IndexThreshold || ++m_IndexMisses < m_Data.size() / 4u)
+		return false;
+
+	std::unique_lock<std::mutex> lock (m_IndexMutex, std::try_to_lock);
+
+	if (!lock)
+		return false;
+
+	if (!m_IndexValid.load(std::memory_order_relaxed)) {
+		RebuildIndex();
+		m_IndexValid.store(true, std::memory_order_release);
+	}
+
+	return true;
+}
+
+void Dictionary::RebuildIndex() const
+{
+	size_t size = 64;
+
+	while (size < m_Data.size() * 4u)
+		size *= 2u;
+
+	m_Index.assign(size, 0);
+
+	for (SizeType i = 0; i < m_Data.size(); i++) {
+		m_Index[FindIndexSlot(m_Data[i].first)] = i + 1u;
+	}
+}
+
+/**
+ * Invalidates the hash table after the pairs have moved. Requires an exclusive lock.
+ */
+void Dictionary::InvalidateIndex()
+{
+	m_IndexValid.store(false, std::memory_order_relaxed);
+	m_IndexMisses.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * Finds a key's slot in the hash table.
+ *
+ * @param key The key.
+ * @returns The slot containing the key's position or, if the key doesn't exist, the free slot for it.
+ */
+size_t Dictionary::FindIndexSlot(const String& key) const
+{
+	size_t mask = m_Index.size() - 1u;
+
+	for (size_t slot = std::hash<String>()(key) & mask;; slot = (slot + 1u) & mask) {
+		auto position (m_Index[slot]);
+
+		if (!position || m_Data[position - 1u].first == key)
+			return slot;
+	}
+}
 
 /**
  * Retrieves a value from a dictionary.
@@ -39,7 +193,7 @@ Value Dictionary::Get(const String& key) const
 {
 	std::shared_lock<std::shared_timed_mutex> lock (m_DataMutex);
 
-	auto it = m_Data.find(key);
+	auto it = Find(key);
 
 	if (it == m_Data.end())
 		return Empty;
@@ -58,7 +212,7 @@ bool Dictionary::Get(const String& key, Value *result) const
 {
 	std::shared_lock<std::shared_timed_mutex> lock (m_DataMutex);
 
-	auto it = m_Data.find(key);
+	auto it = Find(key);
 
 	if (it == m_Data.end())
 		return false;
@@ -82,7 +236,14 @@ void Dictionary::Set(const String& key, Value value, bool overrideFrozen)
 	if (m_Frozen && !overrideFrozen)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Value in dictionary must not be modified."));
 
-	m_Data[key] = std::move(value);
+	auto it (Find(key));
+
+	if (it != m_Data.end()) {
+		it->second = std::move(value);
+		return;
+	}
+
+	Insert(std::lower_bound(m_Data.begin(), m_Data.end(), key, DictionaryKeyLess), key, std::move(value));
 }
 
 /**
@@ -107,13 +268,14 @@ bool Dictionary::Contains(const String& key) const
 {
 	std::shared_lock<std::shared_timed_mutex> lock (m_DataMutex);
 
-	return (m_Data.find(key) != m_Data.end());
+	return (Find(key) != m_Data.end());
 }
 
 /**
  * Returns an iterator to the beginning of the dictionary.
  *
  * Note: Caller must hold the object lock while using the iterator.
+ * Setting new keys or removing keys invalidates it.
  *
  * @returns An iterator.
  */
@@ -151,7 +313,7 @@ void Dictionary::Remove(Dictionary::Iterator it)
 	if (m_Frozen)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Dictionary must not be modified."));
 
-	m_Data.erase(it);
+	Erase(it);
 }
 
 /**
@@ -168,12 +330,12 @@ void Dictionary::Remove(const String& key)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Dictionary must not be modified."));
 
 	Dictionary::Iterator it;
-	it = m_Data.find(key);
+	it = Find(key);
 
 	if (it == m_Data.end())
 		return;
 
-	m_Data.erase(it);
+	Erase(it);
 }
 
 /**
@@ -188,6 +350,8 @@ void Dictionary::Clear()
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Dictionary must not be modified."));
 
 	m_Data.clear();
+	std::vector<uint32_t>().swap(m_Index);
+	InvalidateIndex();
 }
 
 void Dictionary::CopyTo(const Dictionary::Ptr& dest) const
@@ -207,7 +371,17 @@ void Dictionary::CopyTo(const Dictionary::Ptr& dest) const
 Dictionary::Ptr Dictionary::ShallowClone() const
 {
 	Dictionary::Ptr clone = new Dictionary();
-	CopyTo(clone);
+
+	std::shared_lock<std::shared_timed_mutex> lock (m_DataMutex);
+
+	clone->m_Data = m_Data;
+
+	/* Readers may be rebuilding an invalid hash table. */
+	if (m_IndexValid.load(std::memory_order_acquire)) {
+		clone->m_Index = m_Index;
+		clone->m_IndexValid.store(true, std::memory_order_relaxed);
+	}
+
 	return clone;
 }
 
@@ -7,8 +7,11 @@
 #include "base/object.hpp"
 #include "base/value.hpp"
 #include <boost/range/iterator.hpp>
-#include <map>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
 #include <shared_mutex>
+#include <utility>
 #include <vector>
 
 namespace icinga
@@ -19,6 +22,18 @@ typedef std::vector<std::pair<String, Value> > DictionaryData;
 /**
  * A container that holds key-value pairs.
  *
+ * The pairs are stored in a vector sorted by key, i.e. without a heap allocation
+ * per pair and iterated over in key order. Small dictionaries are searched via
+ * binary search, large ones get an additional open addressing hash table.
+ * Modifications other than appending invalidate the hash table. It's rebuilt
+ * lazily, once enough lookups have fallen back to binary search.
+ *
+ * Setting a new key or removing one moves the pairs behind it, i.e. is O(n).
+ * That's cheap for the small dictionaries which make up most of them (the pairs
+ * are moved, not copied), but building a large dictionary key by key out of order
+ * is quadratic. Large dictionaries from external input (e.g. JsonDecode()) are
+ * therefore collected as DictionaryData and sorted once by the constructor.
+ *
  * @ingroup base
  */
 class Dictionary final : public Object
@@ -28,12 +43,17 @@ public:
 
 	/**
 	 * An iterator that can be used to iterate over dictionary elements.
+	 *
+	 * Unlike with a node-based map, setting a new key or removing any key
+	 * invalidates all iterators (see begin()), not only the ones to the
+	 * removed pair. Collect the keys first to modify the dictionary based
+	 * on an iteration.
 	 */
-	typedef std::map<String, Value>::iterator Iterator;
+	typedef DictionaryData::iterator Iterator;
 
-	typedef std::map<String, Value>::size_type SizeType;
+	typedef DictionaryData::size_type SizeType;
 
-	typedef std::map<String, Value>::value_type Pair;
+	typedef DictionaryData::value_type Pair;
 
 	Dictionary() = default;
 	Dictionary(const DictionaryData& other);
@@ -75,9 +95,28 @@ public:
 	bool GetOwnField(const String& field, Value *result) const override;
 
 private:
-	std::map<String, Value> m_Data; /**< The data for the dictionary. */
+	/* Dictionaries with more pairs than this get a hash table. */
+	static constexpr SizeType IndexThreshold = 32;
+
+	DictionaryData m_Data; /**< The data for the dictionary, sorted by key. */
+	mutable std::vector<uint32_t> m_Index; /**< Hash table of m_Data positions plus one (or 0 if free), only used if m_IndexValid. */
+	mutable std::atomic<bool> m_IndexValid{false};
+	mutable std::atomic<SizeType> m_IndexMisses{0}; /**< Lookups since the hash table has been invalidated. */
+	mutable std::mutex m_IndexMutex; /**< Held by the reader rebuilding the hash table. */
 	mutable std::shared_timed_mutex m_DataMutex;
 	bool m_Frozen{false};
+
+	void Normalize();
+
+	Iterator Find(const String& key);
+	DictionaryData::const_iterator Find(const String& key) const;
+	void Insert(Iterator position, const String& key, Value value);
+	void Erase(Iterator position);
+
+	bool TryRebuildIndex() const;
+	void RebuildIndex() const;
+	void InvalidateIndex();
+	size_t FindIndexSlot(const String& key) const;
 };
 
 Dictionary::Iterator begin(const Dictionary::Ptr& x);
@@ -85,6 +124,6 @@ Dictionary::Iterator end(const Dictionary::Ptr& x);
 
 }
 
-extern template class std::map<icinga::String, icinga::Value>;
+extern template class std::vector<std::pair<icinga::String, icinga::Value> >;
 
 #endif /* DICTIONARY_H */
@@ -8,6 +8,7 @@
 #include "base/objectlock.hpp"
 #include "base/convert.hpp"
 #include "base/utility.hpp"
+#include <algorithm>
 #include <bitset>
 #include <boost/exception_ptr.hpp>
 #include <cstdint>
@@ -38,8 +39,18 @@ public:
 	Value GetResult();
 
 private:
+	/* Objects are collected as pairs and only turned into a Dictionary at their end,
+	 * so their keys are sorted once instead of being inserted one by one.
+	 */
+	struct Node
+	{
+		String Key; /**< The key of this node in its parent object. */
+		DictionaryData Pairs;
+		Array::Ptr Items; /**< Set for arrays only. */
+	};
+
 	Value m_Root;
-	std::stack<std::pair<Dictionary*, Array*>> m_CurrentSubtree;
+	std::stack<Node> m_CurrentSubtree;
 	String m_CurrentKey;
 
 	void FillCurrentTarget(Value value);
@@ -276,11 +287,7 @@ bool JsonSax::binary(JsonSax::binary_t& val)
 inline
 bool JsonSax::start_object(std::size_t)
 {
-	auto object (new Dictionary());
-
-	FillCurrentTarget(object);
-
-	m_CurrentSubtree.push({object, nullptr});
+	m_CurrentSubtree.push({m_CurrentKey, DictionaryData(), nullptr});
 
 	return true;
 }
@@ -296,7 +303,14 @@ bool JsonSax::key(JsonSax::string_t& val)
 inline
 bool JsonSax::end_object()
 {
+	auto node (std::move(m_CurrentSubtree.top()));
 	m_CurrentSubtree.pop();
+
+	/* The Dictionary keeps the first of duplicate keys, JSON parsers usually the last one. */
+	std::reverse(node.Pairs.begin(), node.Pairs.end());
+
+	m_CurrentKey = std::move(node.Key);
+	FillCurrentTarget(new Dictionary(std::move(node.Pairs)));
 	m_CurrentKey = String();
 
 	return true;
@@ -305,11 +319,11 @@ bool JsonSax::end_object()
 inline
 bool JsonSax::start_array(std::size_t)
 {
-	auto array (new Array());
+	Array::Ptr array = new Array();
 
 	FillCurrentTarget(array);
 
-	m_CurrentSubtree.push({nullptr, array});
+	m_CurrentSubtree.push({String(), DictionaryData(), array});
 
 	return true;
 }
@@ -342,10 +356,10 @@ void JsonSax::FillCurrentTarget(Value value)
 	} else {
 		auto& node (m_CurrentSubtree.top());
 
-		if (node.first) {
-			node.first->Set(m_CurrentKey, value);
+		if (node.Items) {
+			node.Items->Add(std::move(value));
 		} else {
-			node.second->Add(value);
+			node.Pairs.emplace_back(m_CurrentKey, std::move(value));
 		}
 	}
 }
@@ -7,7 +7,10 @@
 #include "base/logger.hpp"
 #include "base/function.hpp"
 #include <boost/algorithm/string.hpp>
+#include <charconv>
 #include <cmath>
+#include <cstring>
+#include <limits>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
@@ -225,96 +228,202 @@ PerfdataValue::PerfdataValue(const String& label, double value, bool counter,
 	SetMax(max, true);
 }
 
+PerfdataValue::PerfdataValue(const PerfdataValueView& view)
+{
+	String label (view.Label.begin(), view.Label.end());
+
+	if (!view.MultiPrefix.empty())
+		label = String(view.MultiPrefix.begin(), view.MultiPrefix.end()) + "::" + label;
+
+	auto toValue ([](double value) -> Value {
+		return std::isnan(value) ? Empty : Value(value);
+	});
+
+	SetLabel(std::move(label), true);
+	SetValue(view.Value, true);
+	SetCounter(view.Counter, true);
+	SetUnit(view.Unit, true);
+	SetWarn(toValue(view.Warn), true);
+	SetCrit(toValue(view.Crit), true);
+	SetMin(toValue(view.Min), true);
+	SetMax(toValue(view.Max), true);
+}
+
 PerfdataValue::Ptr PerfdataValue::Parse(const String& perfdata)
 {
-	size_t eqp = perfdata.FindLastOf('=');
+	PerfdataValueView view;
 
-	if (eqp == String::NPos)
+	if (!ParseView(perfdata.GetData(), view))
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid performance data value: " + perfdata));
 
-	String label = perfdata.SubStr(0, eqp);
+	return new PerfdataValue(view);
+}
 
-	if (label.GetLength() > 2 && label[0] == '\'' && label[label.GetLength() - 1] == '\'')
-		label = label.SubStr(1, label.GetLength() - 2);
+/**
+ * Parses a number like boost::lexical_cast<double>() does, but without copying it.
+ *
+ * @return Whether the whole string is a number
+ */
+static bool ParsePerfdataNumber(std::string_view str, double& result)
+{
+	/* std::from_chars() doesn't accept an explicit plus sign. */
+	if (!str.empty() && str[0] == '+') {
+		str.remove_prefix(1);
 
-	size_t spq = perfdata.FindFirstOf(' ', eqp);
+		if (!str.empty() && str[0] == '-')
+			return false;
+	}
 
-	if (spq == String::NPos)
-		spq = perfdata.GetLength();
+	if (str.empty())
+		return false;
 
-	String valueStr = perfdata.SubStr(eqp + 1, spq - eqp - 1);
-	std::vector<String> tokens = valueStr.Split(";");
+	auto end (str.data() + str.size());
+	auto res (std::from_chars(str.data(), end, result));
 
-	if (valueStr.FindFirstOf(',') != String::NPos || tokens.empty()) {
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid performance data value: " + perfdata));
-	}
+	return res.ec == std::errc() && res.ptr == end;
+}
 
-	// Find the position where to split value and unit. Possible values of tokens[0] include:
-	// "1000", "1.0", "1.", "-.1", "+1", "1e10", "1GB", "1e10GB", "1e10EB", "1E10EB", "1.5GB", "1.GB", "+1.E-1EW"
-	// Consider everything up to and including the last digit or decimal point as part of the value.
-	size_t pos = tokens[0].FindLastOf("0123456789.");
-	if (pos != String::NPos) {
-		pos++;
+/**
+ * Parses a warning/critical/minimum/maximum token, unsupported ones (e.g. ranges) are ignored.
+ *
+ * @return false if the token looks like a number, but isn't one
+ */
+static bool ParseWarnCritMinMaxToken(std::string_view token, const char *description, double& result)
+{
+	result = std::numeric_limits<double>::quiet_NaN();
+
+	if (token.empty())
+		return true;
+
+	if (token == "U" || token.find_first_not_of("+-0123456789.eE") != std::string_view::npos) {
+		Log(LogDebug, "PerfdataValue")
+			<< "Ignoring unsupported perfdata " << description << " range, value: '" << token << "'.";
+		return true;
 	}
 
-	double value = Convert::ToDouble(tokens[0].SubStr(0, pos));
+	return ParsePerfdataNumber(token, result);
+}
 
-	bool counter = false;
-	String unit;
-	Value warn, crit, min, max;
+/**
+ * Looks up a unit, first case-sensitively, then case-insensitively.
+ *
+ * @return The unit or nullptr if it's unknown
+ */
+static const UoM* FindUoM(std::string_view unit)
+{
+	/* Short enough for the small string optimization, i.e. the lookups don't allocate. */
+	if (unit.size() > 15)
+		return nullptr;
 
-	if (pos != String::NPos)
-		unit = tokens[0].SubStr(pos, String::NPos);
+	std::string key (unit);
 
-	double base;
+	auto uom (l_CsUoMs.find(key));
 
-	{
-		auto uom (l_CsUoMs.find(unit.GetData()));
+	if (uom != l_CsUoMs.end())
+		return &uom->second;
 
-		if (uom == l_CsUoMs.end()) {
-			auto ciUnit (unit.ToLower());
-			auto uom (l_CiUoMs.find(ciUnit.GetData()));
+	boost::algorithm::to_lower(key);
 
-			if (uom == l_CiUoMs.end()) {
-				Log(LogDebug, "PerfdataValue")
-					<< "Invalid performance data unit: " << unit;
+	uom = l_CiUoMs.find(key);
 
-				unit = "";
-				base = 1.0;
-			} else {
-				unit = uom->second.Out;
-				base = uom->second.Factor;
-			}
-		} else {
-			unit = uom->second.Out;
-			base = uom->second.Factor;
-		}
+	if (uom != l_CiUoMs.end())
+		return &uom->second;
+
+	return nullptr;
+}
+
+/**
+ * Parses a performance data value (e.g. "'my label'=1.5GB;2;3;0;10") without copying any parts of it.
+ *
+ * @param perfdata The performance data value
+ * @param result Receives the value, its label refers to perfdata
+ *
+ * @return Whether the value is valid
+ */
+bool PerfdataValue::ParseView(std::string_view perfdata, PerfdataValueView& result)
+{
+	size_t eqp = perfdata.rfind('=');
+
+	if (eqp == std::string_view::npos)
+		return false;
+
+	std::string_view label = perfdata.substr(0, eqp);
+
+	if (label.size() > 2 && label.front() == '\'' && label.back() == '\'')
+		label = label.substr(1, label.size() - 2);
+
+	size_t spq = perfdata.find(' ', eqp);
+
+	if (spq == std::string_view::npos)
+		spq = perfdata.size();
+
+	std::string_view valueStr = perfdata.substr(eqp + 1, spq - eqp - 1);
+
+	if (valueStr.find(',') != std::string_view::npos)
+		return false;
+
+	/* value[unit];warn;crit;min;max, further tokens are ignored */
+	std::string_view tokens[5];
+
+	for (auto& token : tokens) {
+		size_t semicolon = valueStr.find(';');
+
+		token = valueStr.substr(0, semicolon);
+
+		if (semicolon == std::string_view::npos)
+			break;
+
+		valueStr.remove_prefix(semicolon + 1);
 	}
 
-	if (unit == "c") {
-		counter = true;
+	// Find the position where to split value and unit. Possible values of tokens[0] include:
+	// "1000", "1.0", "1.", "-.1", "+1", "1e10", "1GB", "1e10GB", "1e10EB", "1E10EB", "1.5GB", "1.GB", "+1.E-1EW"
+	// Consider everything up to and including the last digit or decimal point as part of the value.
+	size_t pos = tokens[0].find_last_of("0123456789.");
+	std::string_view unit;
+
+	if (pos != std::string_view::npos) {
+		unit = tokens[0].substr(pos + 1);
+		tokens[0] = tokens[0].substr(0, pos + 1);
 	}
 
-	warn = ParseWarnCritMinMaxToken(tokens, 1, "warning");
-	crit = ParseWarnCritMinMaxToken(tokens, 2, "critical");
-	min = ParseWarnCritMinMaxToken(tokens, 3, "minimum");
-	max = ParseWarnCritMinMaxToken(tokens, 4, "maximum");
+	double value;
 
-	value = value * base;
+	if (!ParsePerfdataNumber(tokens[0], value))
+		return false;
 
-	if (!warn.IsEmpty())
-		warn = warn * base;
+	double base;
+	const UoM *uom = FindUoM(unit);
 
-	if (!crit.IsEmpty())
-		crit = crit * base;
+	if (uom) {
+		result.Unit = uom->Out;
+		base = uom->Factor;
+	} else {
+		Log(LogDebug, "PerfdataValue")
+			<< "Invalid performance data unit: " << unit;
 
-	if (!min.IsEmpty())
-		min = min * base;
+		result.Unit = "";
+		base = 1.0;
+	}
 
-	if (!max.IsEmpty())
-		max = max * base;
+	if (!ParseWarnCritMinMaxToken(tokens[1], "warning", result.Warn)
+		|| !ParseWarnCritMinMaxToken(tokens[2], "critical", result.Crit)
+		|| !ParseWarnCritMinMaxToken(tokens[3], "minimum", result.Min)
+		|| !ParseWarnCritMinMaxToken(tokens[4], "maximum", result.Max))
+		return false;
 
-	return new PerfdataValue(label, value, counter, unit, warn, crit, min, max);
+	result.Label = label;
+	result.MultiPrefix = std::string_view();
+	result.Counter = strcmp(result.Unit, "c") == 0;
+	result.Value = value * base;
+
+	/* NaN stays NaN. */
+	result.Warn *= base;
+	result.Crit *= base;
+	result.Min *= base;
+	result.Max *= base;
+
+	return true;
 }
 
 static const std::unordered_map<std::string, const char*> l_FormatUoMs ({
@@ -381,15 +490,3 @@ String PerfdataValue::Format() const
 
 	return result.str();
 }
-
-Value PerfdataValue::ParseWarnCritMinMaxToken(const std::vector<String>& tokens, std::vector<String>::size_type index, const String& description)
-{
-	if (tokens.size() > index && tokens[index] != "U" && tokens[index] != "" && tokens[index].FindFirstNotOf("+-0123456789.eE") == String::NPos)
-		return Convert::ToDouble(tokens[index]);
-	else {
-		if (tokens.size() > index && tokens[index] != "")
-			Log(LogDebug, "PerfdataValue")
-				<< "Ignoring unsupported perfdata " << description << " range, value: '" << tokens[index] << "'.";
-		return Empty;
-	}
-}
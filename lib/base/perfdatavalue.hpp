@@ -5,10 +5,32 @@
 
 #include "base/i2-base.hpp"
 #include "base/perfdatavalue-ti.hpp"
+#include <string_view>
 
 namespace icinga
 {
 
+/**
+ * A parsed performance data value which refers to the string it has been parsed from,
+ * i.e. it's only valid as long as that string is.
+ *
+ * @ingroup base
+ */
+struct PerfdataValueView
+{
+	std::string_view Label; /* without quotes */
+	std::string_view MultiPrefix; /* check_multi prefix, to be joined with Label by "::" */
+	const char *Unit; /* normalized, e.g. "bytes" */
+	double Value;
+	bool Counter;
+
+	/* NaN if not specified */
+	double Warn;
+	double Crit;
+	double Min;
+	double Max;
+};
+
 /**
  * A performance data value.
  *
@@ -25,12 +47,11 @@ public:
 		const Value& warn = Empty, const Value& crit = Empty,
 		const Value& min = Empty, const Value& max = Empty);
 
+	explicit PerfdataValue(const PerfdataValueView& view);
+
 	static PerfdataValue::Ptr Parse(const String& perfdata);
+	static bool ParseView(std::string_view perfdata, PerfdataValueView& result);
 	String Format() const;
-
-private:
-	static Value ParseWarnCritMinMaxToken(const std::vector<String>& tokens,
-		std::vector<String>::size_type index, const String& description);
 };
 
 }
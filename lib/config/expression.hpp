@@ -622,6 +622,16 @@ public:
 
 	void MakeInline();
 
+	inline bool IsInline() const noexcept
+	{
+		return m_Inline;
+	}
+
+	inline const std::vector<std::unique_ptr<Expression> >& GetExpressions() const noexcept
+	{
+		return m_Expressions;
+	}
+
 protected:
 	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
 
@@ -581,3 +581,48 @@ void DbConnection::DecreasePendingQueries(int count)
 	m_PendingQueries.fetch_sub(count);
 	m_OutputQueries.InsertValue(Utility::GetTime(), count);
 }
+
+/**
+ * Registers a query which is about to be queued.
+ *
+ * Of the queued full status updates of an object only the latest one
+ * has to be executed, it overwrites all the columns of the older ones.
+ *
+ * @param query The query
+ * @return The serial to pass to DequeueStatusUpdate(), 0 if the query isn't a full status update
+ */
+uint_fast64_t DbConnection::QueueStatusUpdate(const DbQuery& query)
+{
+	if (!query.StatusUpdate || query.Type != (DbQueryInsert | DbQueryUpdate) || !query.Object)
+		return 0;
+
+	std::unique_lock<std::mutex> lock (m_StatusUpdatesMutex);
+
+	auto serial (++m_StatusUpdateSerial);
+	m_QueuedStatusUpdates[{ query.Object, query.Table }] = serial;
+
+	return serial;
+}
+
+/**
+ * Checks whether a queued query has to be executed.
+ *
+ * @param query The query
+ * @param serial As returned by QueueStatusUpdate()
+ * @return false if a more recent status update of the same object has been queued
+ */
+bool DbConnection::DequeueStatusUpdate(const DbQuery& query, uint_fast64_t serial)
+{
+	if (!serial)
+		return true;
+
+	std::unique_lock<std::mutex> lock (m_StatusUpdatesMutex);
+
+	auto it (m_QueuedStatusUpdates.find({ query.Object, query.Table }));
+
+	if (it == m_QueuedStatusUpdates.end() || it->second != serial)
+		return false;
+
+	m_QueuedStatusUpdates.erase(it);
+	return true;
+}
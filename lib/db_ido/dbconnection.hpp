@@ -96,6 +96,9 @@ protected:
 	void IncreasePendingQueries(int count);
 	void DecreasePendingQueries(int count);
 
+	uint_fast64_t QueueStatusUpdate(const DbQuery& query);
+	bool DequeueStatusUpdate(const DbQuery& query, uint_fast64_t serial);
+
 	WorkQueue m_QueryQueue{10000000, 1, LogNotice};
 
 private:
@@ -126,6 +129,10 @@ private:
 	RingBuffer m_InputQueries{10};
 	RingBuffer m_OutputQueries{10};
 	Atomic<uint_fast64_t> m_PendingQueries{0};
+
+	std::mutex m_StatusUpdatesMutex;
+	std::map<std::pair<DbObject::Ptr, String>, uint_fast64_t> m_QueuedStatusUpdates;
+	uint_fast64_t m_StatusUpdateSerial{0};
 };
 
 struct database_error : virtual std::exception, virtual boost::exception { };
@@ -18,6 +18,9 @@
 
 using namespace icinga;
 
+/* Rows per multi-row INSERT of history data. */
+static const size_t l_IdoMysqlMaxInsertBatchRows = 1000;
+
 REGISTER_TYPE(IdoMysqlConnection);
 REGISTER_STATSFUNCTION(IdoMysqlConnection, &IdoMysqlConnection::StatsFunc);
 
@@ -513,6 +516,9 @@ void IdoMysqlConnection::AsyncQuery(const String& query, const std::function<voi
 {
 	AssertOnWorkQueue();
 
+	/* Keep the order of the queries. */
+	FlushInsertBatch();
+
 	IdoAsyncQuery aq;
 	aq.Query = query;
 	/* XXX: Important: The callback must not immediately execute a query, but enqueue it!
@@ -522,8 +528,53 @@ void IdoMysqlConnection::AsyncQuery(const String& query, const std::function<voi
 	m_AsyncQueries.emplace_back(std::move(aq));
 }
 
+/**
+ * Queues a row to be inserted, possibly together with the previous ones.
+ *
+ * @param head "INSERT INTO table (columns) VALUES "
+ * @param values "(values)"
+ */
+void IdoMysqlConnection::AsyncInsert(const String& head, const String& values)
+{
+	AssertOnWorkQueue();
+
+	if (m_InsertBatchRows > 0 && (head != m_InsertBatchHead || m_InsertBatchRows >= l_IdoMysqlMaxInsertBatchRows
+		|| m_InsertBatchHead.GetLength() + m_InsertBatchValues.GetLength() + values.GetLength() + 1 > m_MaxPacketSize / 2)) {
+		FlushInsertBatch();
+	}
+
+	if (m_InsertBatchRows == 0) {
+		m_InsertBatchHead = head;
+		m_InsertBatchValues = values;
+	} else {
+		m_InsertBatchValues += ",";
+		m_InsertBatchValues += values;
+	}
+
+	m_InsertBatchRows++;
+}
+
+void IdoMysqlConnection::FlushInsertBatch()
+{
+	if (m_InsertBatchRows == 0)
+		return;
+
+	IdoAsyncQuery aq;
+	aq.Query = m_InsertBatchHead + m_InsertBatchValues;
+	m_AsyncQueries.emplace_back(std::move(aq));
+
+	/* Each row has been counted as a pending query, but they're one query now. */
+	DecreasePendingQueries(m_InsertBatchRows - 1);
+
+	m_InsertBatchHead = String();
+	m_InsertBatchValues = String();
+	m_InsertBatchRows = 0;
+}
+
 void IdoMysqlConnection::FinishAsyncQueries()
 {
+	FlushInsertBatch();
+
 	std::vector<IdoAsyncQuery> queries;
 	m_AsyncQueries.swap(queries);
 
@@ -930,7 +981,18 @@ void IdoMysqlConnection::ExecuteQuery(const DbQuery& query)
 #endif /* I2_DEBUG */
 
 	IncreasePendingQueries(1);
-	m_QueryQueue.Enqueue([this, query]() { InternalExecuteQuery(query, -1); }, query.Priority, true);
+
+	auto serial (QueueStatusUpdate(query));
+
+	m_QueryQueue.Enqueue([this, query, serial]() {
+		/* Superseded by a more recent status update of the same object. */
+		if (!DequeueStatusUpdate(query, serial)) {
+			DecreasePendingQueries(1);
+			return;
+		}
+
+		InternalExecuteQuery(query, -1);
+	}, query.Priority, true);
 }
 
 void IdoMysqlConnection::ExecuteMultipleQueries(const std::vector<DbQuery>& queries)
@@ -1178,8 +1240,17 @@ void IdoMysqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 				first = false;
 		}
 
-		if (type == DbQueryInsert)
+		if (type == DbQueryInsert) {
+			/* Neither an insert ID nor the affected rows are needed for these. */
+			if (!query.ConfigUpdate && !query.StatusUpdate && !query.NotificationInsertID
+				&& (query.Table == "statehistory" || query.Table == "logentries")) {
+				AsyncInsert("INSERT INTO " + GetTablePrefix() + query.Table + " (" + colbuf.str() + ") VALUES ",
+					"(" + valbuf.str() + ")");
+				return;
+			}
+
 			qbuf << " (" << colbuf.str() << ") VALUES (" << valbuf.str() << ")";
+		}
 	}
 
 	if (type != DbQueryInsert)
@@ -69,6 +69,11 @@ private:
 	std::vector<IdoAsyncQuery> m_AsyncQueries;
 	uint_fast32_t m_UncommittedAsyncQueries = 0;
 
+	/* Consecutive history INSERTs into the same table are merged into one multi-row INSERT. */
+	String m_InsertBatchHead;
+	String m_InsertBatchValues;
+	size_t m_InsertBatchRows = 0;
+
 	Timer::Ptr m_ReconnectTimer;
 	Timer::Ptr m_TxTimer;
 
@@ -80,6 +85,8 @@ private:
 	void DiscardRows(const IdoMysqlResult& result);
 
 	void AsyncQuery(const String& query, const IdoAsyncCallback& callback = IdoAsyncCallback());
+	void AsyncInsert(const String& head, const String& values);
+	void FlushInsertBatch();
 	void FinishAsyncQueries();
 
 	bool FieldToEscapedString(const String& key, const Value& value, Value *result);
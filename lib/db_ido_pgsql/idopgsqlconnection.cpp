@@ -15,10 +15,18 @@
 #include "base/context.hpp"
 #include "base/statsfunction.hpp"
 #include "base/defer.hpp"
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <algorithm>
 #include <utility>
 
 using namespace icinga;
 
+/* DEALLOCATE ALL once there are more prepared statements. */
+static const size_t l_IdoPgsqlMaxPreparedStatements = 1024;
+
+/* Fewer inserts into a table aren't worth a COPY. */
+static const size_t l_IdoPgsqlMinCopyRows = 8;
+
 REGISTER_TYPE(IdoPgsqlConnection);
 
 REGISTER_STATSFUNCTION(IdoPgsqlConnection, &IdoPgsqlConnection::StatsFunc);
@@ -60,13 +68,17 @@ void IdoPgsqlConnection::StatsFunc(const Dictionary::Ptr& status, const Array::P
 	for (const IdoPgsqlConnection::Ptr& idopgsqlconnection : ConfigType::GetObjectsByType<IdoPgsqlConnection>()) {
 		size_t queryQueueItems = idopgsqlconnection->m_QueryQueue.GetLength();
 		double queryQueueItemRate = idopgsqlconnection->m_QueryQueue.GetTaskCount(60) / 60.0;
+		double queryRate = idopgsqlconnection->GetQueryCount(60) / 60.0;
+		double queryLatency = idopgsqlconnection->GetAverageQueryLatency();
 
 		nodes.emplace_back(idopgsqlconnection->GetName(), new Dictionary({
 			{ "version", idopgsqlconnection->GetSchemaVersion() },
 			{ "instance_name", idopgsqlconnection->GetInstanceName() },
 			{ "connected", idopgsqlconnection->GetConnected() },
 			{ "query_queue_items", queryQueueItems },
-			{ "query_queue_item_rate", queryQueueItemRate }
+			{ "query_queue_item_rate", queryQueueItemRate },
+			{ "query_rate", queryRate },
+			{ "query_latency_avg", queryLatency }
 		}));
 
 		perfdata->Add(new PerfdataValue("idopgsqlconnection_" + idopgsqlconnection->GetName() + "_queries_rate", idopgsqlconnection->GetQueryCount(60) / 60.0));
@@ -75,6 +87,7 @@ void IdoPgsqlConnection::StatsFunc(const Dictionary::Ptr& status, const Array::P
 		perfdata->Add(new PerfdataValue("idopgsqlconnection_" + idopgsqlconnection->GetName() + "_queries_15mins", idopgsqlconnection->GetQueryCount(15 * 60)));
 		perfdata->Add(new PerfdataValue("idopgsqlconnection_" + idopgsqlconnection->GetName() + "_query_queue_items", queryQueueItems));
 		perfdata->Add(new PerfdataValue("idopgsqlconnection_" + idopgsqlconnection->GetName() + "_query_queue_item_rate", queryQueueItemRate));
+		perfdata->Add(new PerfdataValue("idopgsqlconnection_" + idopgsqlconnection->GetName() + "_query_latency_avg", queryLatency));
 	}
 
 	status->Set("idopgsqlconnection", new Dictionary(std::move(nodes)));
@@ -241,6 +254,7 @@ void IdoPgsqlConnection::Reconnect()
 		conninfo += " sslrootcert=" + sslCa;
 
 	/* connection */
+	m_PreparedStatements.clear();
 	m_Connection = m_Pgsql->connectdb(conninfo.CStr());
 
 	if (!m_Connection)
@@ -479,8 +493,85 @@ IdoPgsqlResult IdoPgsqlConnection::Query(const String& query)
 
 	IncreaseQueryCount();
 
+	double startTime = Utility::GetTime();
 	PGresult *result = m_Pgsql->exec(m_Connection, query.CStr());
+	RecordQueryDuration(startTime);
+
+	return HandleResult(result, query);
+}
+
+/**
+ * Executes a query as a prepared statement. Each distinct query is prepared once per connection.
+ *
+ * @param query The query with $1, $2, ... as placeholders
+ * @param params The parameters, Empty for NULL
+ */
+IdoPgsqlResult IdoPgsqlConnection::ExecutePrepared(const String& query, const std::vector<Value>& params)
+{
+	AssertOnWorkQueue();
+
+	Defer decreaseQueries ([this]() { DecreasePendingQueries(1); });
+
+	Log(LogDebug, "IdoPgsqlConnection")
+		<< "Query: " << query;
+
+	IncreaseQueryCount();
+
+	auto it (m_PreparedStatements.find(query));
+
+	if (it == m_PreparedStatements.end()) {
+		if (m_PreparedStatements.size() >= l_IdoPgsqlMaxPreparedStatements) {
+			HandleResult(m_Pgsql->exec(m_Connection, "DEALLOCATE ALL"), "DEALLOCATE ALL");
+			m_PreparedStatements.clear();
+		}
+
+		String name = "icinga_" + Convert::ToString(m_PreparedStatements.size());
+
+		HandleResult(m_Pgsql->prepare(m_Connection, name.CStr(), query.CStr(), params.size(), nullptr), query);
+
+		it = m_PreparedStatements.emplace(query, std::move(name)).first;
+	}
+
+	std::vector<String> values;
+	std::vector<const char *> valuePtrs;
+
+	GetParameterValues(params, values, valuePtrs);
+
+	double startTime = Utility::GetTime();
+	PGresult *result = m_Pgsql->execPrepared(m_Connection, it->second.CStr(), params.size(), valuePtrs.data(), nullptr, nullptr, 0);
+	RecordQueryDuration(startTime);
+
+	return HandleResult(result, query);
+}
+
+/**
+ * Converts the parameters of a prepared statement to the text format of libpq.
+ *
+ * @param params The parameters, Empty is NULL
+ * @param values Keeps the texts, must stay alive as long as valuePtrs is used
+ * @param valuePtrs One text per parameter, nullptr for NULL
+ */
+void IdoPgsqlConnection::GetParameterValues(const std::vector<Value>& params, std::vector<String>& values, std::vector<const char *>& valuePtrs)
+{
+	values.clear();
+	valuePtrs.clear();
+
+	/* valuePtrs point into values, so it must not reallocate. */
+	values.reserve(params.size());
+	valuePtrs.reserve(params.size());
+
+	for (const Value& param : params) {
+		if (IsNull(param)) {
+			valuePtrs.emplace_back(nullptr);
+		} else {
+			values.emplace_back(param);
+			valuePtrs.emplace_back(values.back().CStr());
+		}
+	}
+}
 
+IdoPgsqlResult IdoPgsqlConnection::HandleResult(PGresult *result, const String& query)
+{
 	if (!result) {
 		String message = m_Pgsql->errorMessage(m_Connection);
 		Log(LogCritical, "IdoPgsqlConnection")
@@ -518,6 +609,85 @@ IdoPgsqlResult IdoPgsqlConnection::Query(const String& query)
 	return IdoPgsqlResult(result, [this](PGresult* result) { m_Pgsql->clear(result); });
 }
 
+/**
+ * Inserts rows with COPY ... FROM STDIN.
+ *
+ * @param table The table without prefix
+ * @param columns The comma separated column names
+ * @param rows The rows in COPY's text format
+ * @param count The number of rows, i.e. of pending queries
+ */
+void IdoPgsqlConnection::Copy(const String& table, const String& columns, const String& rows, size_t count)
+{
+	AssertOnWorkQueue();
+
+	Defer decreaseQueries ([this, count]() { DecreasePendingQueries(count); });
+
+	String query = "COPY " + GetTablePrefix() + table + " (" + columns + ") FROM STDIN";
+
+	Log(LogDebug, "IdoPgsqlConnection")
+		<< "Query: " << query << " (" << count << " rows)";
+
+	IncreaseQueryCount();
+
+	double startTime = Utility::GetTime();
+	PGresult *result = m_Pgsql->exec(m_Connection, query.CStr());
+
+	if (!result || m_Pgsql->resultStatus(result) != PGRES_COPY_IN) {
+		HandleResult(result, query);
+
+		BOOST_THROW_EXCEPTION(
+			database_error()
+			<< errinfo_message("COPY didn't start")
+			<< errinfo_database_query(query)
+		);
+	}
+
+	m_Pgsql->clear(result);
+
+	if (m_Pgsql->putCopyData(m_Connection, rows.CStr(), rows.GetLength()) != 1 || m_Pgsql->putCopyEnd(m_Connection, nullptr) != 1) {
+		String message = m_Pgsql->errorMessage(m_Connection);
+		Log(LogCritical, "IdoPgsqlConnection")
+			<< "Error \"" << message << "\" when executing query \"" << query << "\"";
+
+		BOOST_THROW_EXCEPTION(
+			database_error()
+			<< errinfo_message(message)
+			<< errinfo_database_query(query)
+		);
+	}
+
+	result = m_Pgsql->getResult(m_Connection);
+	RecordQueryDuration(startTime);
+
+	HandleResult(result, query);
+
+	while ((result = m_Pgsql->getResult(m_Connection)))
+		m_Pgsql->clear(result);
+}
+
+void IdoPgsqlConnection::RecordQueryDuration(double startTime)
+{
+	double now = Utility::GetTime();
+
+	m_QueryDurations.InsertValue(now, (now - startTime) * 1000000);
+	m_TimedQueries.InsertValue(now, 1);
+}
+
+/**
+ * Returns the average duration of the queries within the last minute in seconds.
+ */
+double IdoPgsqlConnection::GetAverageQueryLatency()
+{
+	double now = Utility::GetTime();
+	int queries = m_TimedQueries.UpdateAndGetValues(now, 60);
+
+	if (!queries)
+		return 0;
+
+	return m_QueryDurations.UpdateAndGetValues(now, 60) / 1000000.0 / queries;
+}
+
 DbReference IdoPgsqlConnection::GetSequenceValue(const String& table, const String& column)
 {
 	AssertOnWorkQueue();
@@ -653,8 +823,19 @@ void IdoPgsqlConnection::InternalDeactivateObject(const DbObject::Ptr& dbobj)
 	SetObjectActive(dbobj, false);
 }
 
-bool IdoPgsqlConnection::FieldToEscapedString(const String& key, const Value& value, Value *result)
+/**
+ * Converts a field's value to what's stored in the database.
+ *
+ * @param result The value, Empty for NULL
+ * @param timestamp Set to whether the value is a UNIX timestamp
+ * @param quote Set to whether the value is a string, i.e. has to be quoted in SQL
+ * @return false if the value refers to an object which has no ID yet
+ */
+bool IdoPgsqlConnection::FieldToRawValue(const String& key, const Value& value, Value *result, bool *timestamp, bool *quote)
 {
+	*timestamp = false;
+	*quote = false;
+
 	if (key == "instance_id") {
 		*result = static_cast<long>(m_InstanceID);
 		return true;
@@ -666,7 +847,7 @@ bool IdoPgsqlConnection::FieldToEscapedString(const String& key, const Value& va
 	Value rawvalue = DbValue::ExtractValue(value);
 
 	if (rawvalue.GetType() == ValueEmpty) {
-		*result = "NULL";
+		*result = Empty;
 	} else if (rawvalue.IsObjectType<ConfigObject>()) {
 		DbObject::Ptr dbobjcol = DbObject::GetOrCreateByObject(rawvalue);
 
@@ -700,10 +881,8 @@ bool IdoPgsqlConnection::FieldToEscapedString(const String& key, const Value& va
 
 		*result = static_cast<long>(dbrefcol);
 	} else if (DbValue::IsTimestamp(value)) {
-		long ts = rawvalue;
-		std::ostringstream msgbuf;
-		msgbuf << "TO_TIMESTAMP(" << ts << ") AT TIME ZONE 'UTC'";
-		*result = Value(msgbuf.str());
+		*result = static_cast<long>(rawvalue);
+		*timestamp = true;
 	} else if (DbValue::IsObjectInsertID(value)) {
 		auto id = static_cast<long>(rawvalue);
 
@@ -711,21 +890,119 @@ bool IdoPgsqlConnection::FieldToEscapedString(const String& key, const Value& va
 			return false;
 
 		*result = id;
-		return true;
 	} else {
-		Value fvalue;
-
 		if (rawvalue.IsBoolean())
-			fvalue = Convert::ToLong(rawvalue);
+			*result = Convert::ToLong(rawvalue);
 		else
-			fvalue = rawvalue;
+			*result = rawvalue;
+
+		*quote = true;
+	}
+
+	return true;
+}
 
-		*result = "'" + Escape(fvalue) + "'";
+bool IdoPgsqlConnection::FieldToEscapedString(const String& key, const Value& value, Value *result)
+{
+	Value rawvalue;
+	bool timestamp, quote;
+
+	if (!FieldToRawValue(key, value, &rawvalue, &timestamp, &quote))
+		return false;
+
+	if (IsNull(rawvalue)) {
+		*result = "NULL";
+	} else if (timestamp) {
+		std::ostringstream msgbuf;
+		msgbuf << "TO_TIMESTAMP(" << static_cast<long>(rawvalue) << ") AT TIME ZONE 'UTC'";
+		*result = Value(msgbuf.str());
+	} else if (quote) {
+		*result = "'" + Escape(rawvalue) + "'";
+	} else {
+		*result = rawvalue;
 	}
 
 	return true;
 }
 
+/**
+ * Adds a field's value to the parameters of a prepared statement and its placeholder to the statement.
+ */
+bool IdoPgsqlConnection::FieldToParameter(const String& key, const Value& value, std::vector<Value>& params, std::ostringstream& sql)
+{
+	Value rawvalue;
+	bool timestamp, quote;
+
+	if (!FieldToRawValue(key, value, &rawvalue, &timestamp, &quote))
+		return false;
+
+	params.emplace_back(std::move(rawvalue));
+
+	if (timestamp)
+		sql << "TO_TIMESTAMP($" << params.size() << ") AT TIME ZONE 'UTC'";
+	else
+		sql << "$" << params.size();
+
+	return true;
+}
+
+/**
+ * Adds a field's value to a row in COPY's text format.
+ */
+bool IdoPgsqlConnection::FieldToCopyValue(const String& key, const Value& value, std::ostringstream& row)
+{
+	Value rawvalue;
+	bool timestamp, quote;
+
+	if (!FieldToRawValue(key, value, &rawvalue, &timestamp, &quote))
+		return false;
+
+	FormatCopyValue(rawvalue, timestamp, row);
+
+	return true;
+}
+
+/**
+ * Whether a raw field value (see FieldToRawValue()) is NULL. Empty strings aren't.
+ */
+bool IdoPgsqlConnection::IsNull(const Value& rawvalue)
+{
+	return rawvalue.GetType() == ValueEmpty;
+}
+
+/**
+ * Adds a raw field value (see FieldToRawValue()) to a row in COPY's text format.
+ */
+void IdoPgsqlConnection::FormatCopyValue(const Value& rawvalue, bool timestamp, std::ostringstream& row)
+{
+	if (IsNull(rawvalue)) {
+		row << "\\N";
+	} else if (timestamp) {
+		row << boost::posix_time::to_iso_extended_string(boost::posix_time::from_time_t(static_cast<long>(rawvalue)));
+	} else {
+		String text = rawvalue;
+
+		for (char ch : text) {
+			switch (ch) {
+				case '\\':
+					row << "\\\\";
+					break;
+				case '\n':
+					row << "\\n";
+					break;
+				case '\r':
+					row << "\\r";
+					break;
+				case '\t':
+					row << "\\t";
+					break;
+				default:
+					row << ch;
+			}
+		}
+	}
+}
+
 void IdoPgsqlConnection::ExecuteQuery(const DbQuery& query)
 {
 	if (IsPaused() && GetPauseCalled())
@@ -734,7 +1011,18 @@ void IdoPgsqlConnection::ExecuteQuery(const DbQuery& query)
 	ASSERT(query.Category != DbCatInvalid);
 
 	IncreasePendingQueries(1);
-	m_QueryQueue.Enqueue([this, query]() { InternalExecuteQuery(query, -1); }, query.Priority, true);
+
+	auto serial (QueueStatusUpdate(query));
+
+	m_QueryQueue.Enqueue([this, query, serial]() {
+		/* Superseded by a more recent status update of the same object. */
+		if (!DequeueStatusUpdate(query, serial)) {
+			DecreasePendingQueries(1);
+			return;
+		}
+
+		InternalExecuteQuery(query, -1);
+	}, query.Priority, true);
 }
 
 void IdoPgsqlConnection::ExecuteMultipleQueries(const std::vector<DbQuery>& queries)
@@ -801,9 +1089,120 @@ void IdoPgsqlConnection::InternalExecuteMultipleQueries(const std::vector<DbQuer
 		}
 	}
 
+	std::vector<const DbQuery*> copyable;
+
 	for (const DbQuery& query : queries) {
+		if (CanCopyQuery(query)) {
+			copyable.emplace_back(&query);
+			continue;
+		}
+
+		CopyQueries(copyable);
 		InternalExecuteQuery(query);
 	}
+
+	CopyQueries(copyable);
+}
+
+/**
+ * Checks whether a query is a plain INSERT which doesn't need its ID and hence may be done by COPY.
+ */
+bool IdoPgsqlConnection::CanCopyQuery(const DbQuery& query)
+{
+	if (query.Type != DbQueryInsert || query.ConfigUpdate || query.StatusUpdate || query.NotificationInsertID)
+		return false;
+
+	if (!query.Fields || query.Fields->GetLength() == 0)
+		return false;
+
+	if (GetCategoryFilter() != DbCatEverything && (query.Category & GetCategoryFilter()) == 0)
+		return false;
+
+	if (query.Object && query.Object->GetObject()->GetExtension("agent_check").ToBool())
+		return false;
+
+	return true;
+}
+
+/**
+ * Executes consecutive INSERTs, grouped by table and columns, via COPY. Small groups are INSERTed as usual.
+ *
+ * @param queries The queries, cleared afterwards
+ */
+void IdoPgsqlConnection::CopyQueries(std::vector<const DbQuery*>& queries)
+{
+	if (queries.size() < l_IdoPgsqlMinCopyRows) {
+		for (auto query : queries)
+			InternalExecuteQuery(*query);
+
+		queries.clear();
+		return;
+	}
+
+	std::vector<std::pair<std::pair<String, String>, std::vector<const DbQuery*>>> groups;
+
+	for (auto query : queries) {
+		std::ostringstream colbuf;
+
+		{
+			ObjectLock olock(query->Fields);
+			bool first = true;
+
+			for (const Dictionary::Pair& kv : query->Fields) {
+				if (!first)
+					colbuf << ", ";
+
+				colbuf << kv.first;
+				first = false;
+			}
+		}
+
+		std::pair<String, String> key (query->Table, colbuf.str());
+		auto group (std::find_if(groups.begin(), groups.end(), [&key](const auto& group) { return group.first == key; }));
+
+		if (group == groups.end()) {
+			groups.emplace_back(std::move(key), std::vector<const DbQuery*>());
+			group = groups.end() - 1;
+		}
+
+		group->second.emplace_back(query);
+	}
+
+	queries.clear();
+
+	for (auto& group : groups) {
+		std::ostringstream rows;
+		bool copy = group.second.size() >= l_IdoPgsqlMinCopyRows;
+
+		for (auto query : group.second) {
+			if (!copy)
+				break;
+
+			ObjectLock olock(query->Fields);
+			bool first = true;
+
+			for (const Dictionary::Pair& kv : query->Fields) {
+				if (!first)
+					rows << '\t';
+
+				if (!FieldToCopyValue(kv.first, kv.second, rows)) {
+					copy = false;
+					break;
+				}
+
+				first = false;
+			}
+
+			rows << '\n';
+		}
+
+		if (copy) {
+			Copy(group.first.first, group.first.second, rows.str(), group.second.size());
+		} else {
+			for (auto query : group.second)
+				InternalExecuteQuery(*query);
+		}
+	}
 }
 
 void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOverride)
@@ -844,25 +1243,25 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 	}
 
 	std::ostringstream qbuf, where;
+	std::vector<Value> whereParams;
 	int type;
 
 	if (query.WhereCriteria) {
 		where << " WHERE ";
 
 		ObjectLock olock(query.WhereCriteria);
-		Value value;
 		bool first = true;
 
 		for (const Dictionary::Pair& kv : query.WhereCriteria) {
-			if (!FieldToEscapedString(kv.first, kv.second, &value)) {
-				m_QueryQueue.Enqueue([this, query]() { InternalExecuteQuery(query, -1); }, query.Priority);
-				return;
-			}
-
 			if (!first)
 				where << " AND ";
 
-			where << kv.first << " = " << value;
+			where << kv.first << " = ";
+
+			if (!FieldToParameter(kv.first, kv.second, whereParams, where)) {
+				m_QueryQueue.Enqueue([this, query]() { InternalExecuteQuery(query, -1); }, query.Priority);
+				return;
+			}
 
 			if (first)
 				first = false;
@@ -893,7 +1292,7 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 		std::ostringstream qdel;
 		qdel << "DELETE FROM " << GetTablePrefix() << query.Table << where.str();
 		IncreasePendingQueries(1);
-		Query(qdel.str());
+		ExecutePrepared(qdel.str(), whereParams);
 
 		type = DbQueryInsert;
 	}
@@ -912,6 +1311,12 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 			VERIFY(!"Invalid query type.");
 	}
 
+	/* The WHERE clause's parameters come first as they've already been numbered. */
+	std::vector<Value> params;
+
+	if (type != DbQueryInsert)
+		params = whereParams;
+
 	if (type == DbQueryInsert || type == DbQueryUpdate) {
 		std::ostringstream colbuf, valbuf;
 
@@ -920,14 +1325,8 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 
 		ObjectLock olock(query.Fields);
 
-		Value value;
 		bool first = true;
 		for (const Dictionary::Pair& kv : query.Fields) {
-			if (!FieldToEscapedString(kv.first, kv.second, &value)) {
-				m_QueryQueue.Enqueue([this, query]() { InternalExecuteQuery(query, -1); }, query.Priority);
-				return;
-			}
-
 			if (type == DbQueryInsert) {
 				if (!first) {
 					colbuf << ", ";
@@ -935,12 +1334,16 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 				}
 
 				colbuf << kv.first;
-				valbuf << value;
 			} else {
 				if (!first)
 					qbuf << ", ";
 
-				qbuf << " " << kv.first << " = " << value;
+				qbuf << " " << kv.first << " = ";
+			}
+
+			if (!FieldToParameter(kv.first, kv.second, params, type == DbQueryInsert ? valbuf : qbuf)) {
+				m_QueryQueue.Enqueue([this, query]() { InternalExecuteQuery(query, -1); }, query.Priority);
+				return;
 			}
 
 			if (first)
@@ -954,7 +1357,7 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 	if (type != DbQueryInsert)
 		qbuf << where.str();
 
-	Query(qbuf.str());
+	ExecutePrepared(qbuf.str(), params);
 
 	if (upsert && GetAffectedRows() == 0) {
 		IncreasePendingQueries(1);
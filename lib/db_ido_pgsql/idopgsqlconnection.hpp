@@ -9,6 +9,10 @@
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
 #include "base/library.hpp"
+#include "base/ringbuffer.hpp"
+#include <sstream>
+#include <unordered_map>
+#include <vector>
 
 namespace icinga
 {
@@ -35,6 +39,10 @@ public:
 
 	int GetPendingQueryCount() const override;
 
+	static bool IsNull(const Value& rawvalue);
+	static void GetParameterValues(const std::vector<Value>& params, std::vector<String>& values, std::vector<const char *>& valuePtrs);
+	static void FormatCopyValue(const Value& rawvalue, bool timestamp, std::ostringstream& row);
+
 protected:
 	void OnConfigLoaded() override;
 	void Resume() override;
@@ -58,16 +66,30 @@ private:
 	PGconn *m_Connection;
 	int m_AffectedRows;
 
+	/* SQL text -> name of the prepared statement, per connection */
+	std::unordered_map<String, String> m_PreparedStatements;
+
+	RingBuffer m_QueryDurations{60}; /* in microseconds */
+	RingBuffer m_TimedQueries{60};
+
 	Timer::Ptr m_ReconnectTimer;
 	Timer::Ptr m_TxTimer;
 
 	IdoPgsqlResult Query(const String& query);
+	IdoPgsqlResult ExecutePrepared(const String& query, const std::vector<Value>& params);
+	IdoPgsqlResult HandleResult(PGresult *result, const String& query);
+	void Copy(const String& table, const String& columns, const String& rows, size_t count);
+	void RecordQueryDuration(double startTime);
+	double GetAverageQueryLatency();
 	DbReference GetSequenceValue(const String& table, const String& column);
 	int GetAffectedRows();
 	String Escape(const String& s);
 	Dictionary::Ptr FetchRow(const IdoPgsqlResult& result, int row);
 
+	bool FieldToRawValue(const String& key, const Value& value, Value *result, bool *timestamp, bool *quote);
 	bool FieldToEscapedString(const String& key, const Value& value, Value *result);
+	bool FieldToParameter(const String& key, const Value& value, std::vector<Value>& params, std::ostringstream& sql);
+	bool FieldToCopyValue(const String& key, const Value& value, std::ostringstream& row);
 	void InternalActivateObject(const DbObject::Ptr& dbobj);
 	void InternalDeactivateObject(const DbObject::Ptr& dbobj);
 
@@ -84,6 +106,8 @@ private:
 
 	void InternalExecuteQuery(const DbQuery& query, int typeOverride = -1);
 	void InternalExecuteMultipleQueries(const std::vector<DbQuery>& queries);
+	bool CanCopyQuery(const DbQuery& query);
+	void CopyQueries(std::vector<const DbQuery*>& queries);
 	void InternalCleanUpExecuteQuery(const String& table, const String& time_key, double time_value);
 
 	void ClearTableBySession(const String& table);
@@ -82,6 +82,8 @@ void Checkable::SendNotifications(NotificationType type, const CheckResult::Ptr&
 							{"author", author},
 							{"text", text}
 						}));
+
+						notification->NotifyStashedNotifications();
 					} else {
 						notification->BeginExecuteNotification(type, cr, force, false, author, text);
 					}
@@ -107,6 +109,8 @@ void Checkable::SendNotifications(NotificationType type, const CheckResult::Ptr&
 				{"author", author},
 				{"text", text}
 			}));
+
+			notification->NotifyStashedNotifications();
 		}
 	}
 }
@@ -4,6 +4,7 @@
 #include "icinga/checkable-ti.cpp"
 #include "icinga/host.hpp"
 #include "icinga/service.hpp"
+#include "remote/objectindex.hpp"
 #include "base/objectlock.hpp"
 #include "base/utility.hpp"
 #include "base/exception.hpp"
@@ -41,6 +42,34 @@ void Checkable::StaticInitialize()
 	Downtime::OnDowntimeTriggered.connect([](const Downtime::Ptr& downtime) { Checkable::NotifyFlexibleDowntimeStart(downtime); });
 	/* fixed/flexible downtime end */
 	Downtime::OnDowntimeRemoved.connect([](const Downtime::Ptr& downtime) { Checkable::NotifyDowntimeEnd(downtime); });
+
+	/* indexes for API object queries */
+	for (const Type::Ptr& type : { Host::TypeInstance, Service::TypeInstance }) {
+		for (const char *attribute : { "state", "state_type", "last_hard_state", "acknowledgement", "groups" }) {
+			ObjectIndex::Register(type, attribute);
+		}
+	}
+
+	ObjectIndex::Register(Service::TypeInstance, "host_name");
+
+	Checkable::OnStateRawChanged.connect([](const Checkable::Ptr& checkable, const Value&) {
+		ObjectIndex::UpdateObject(checkable, "state");
+	});
+	Checkable::OnStateTypeChanged.connect([](const Checkable::Ptr& checkable, const Value&) {
+		ObjectIndex::UpdateObject(checkable, "state_type");
+	});
+	Checkable::OnLastHardStateRawChanged.connect([](const Checkable::Ptr& checkable, const Value&) {
+		ObjectIndex::UpdateObject(checkable, "last_hard_state");
+	});
+	Checkable::OnAcknowledgementRawChanged.connect([](const Checkable::Ptr& checkable, const Value&) {
+		ObjectIndex::UpdateObject(checkable, "acknowledgement");
+	});
+	Host::OnGroupsChanged.connect([](const Host::Ptr& host, const Value&) {
+		ObjectIndex::UpdateObject(host, "groups");
+	});
+	Service::OnGroupsChanged.connect([](const Service::Ptr& service, const Value&) {
+		ObjectIndex::UpdateObject(service, "groups");
+	});
 }
 
 Checkable::Checkable()
@@ -113,6 +142,13 @@ void Checkable::Start(bool runtimeCreated)
 	});
 }
 
+void Checkable::Stop(bool runtimeRemoved)
+{
+	ObjectImpl<Checkable>::Stop(runtimeRemoved);
+
+	ObjectIndex::RemoveObject(this);
+}
+
 void Checkable::AddGroup(const String& name)
 {
 	std::unique_lock<std::mutex> lock(m_CheckableMutex);
@@ -132,6 +168,12 @@ void Checkable::AddGroup(const String& name)
 		groups = new Array();
 
 	groups->Add(name);
+
+	lock.unlock();
+
+	/* The array was modified in place, so there's no OnGroupsChanged signal. */
+	if (IsActive())
+		ObjectIndex::UpdateObject(this, "groups");
 }
 
 AcknowledgementType Checkable::GetAcknowledgement()
@@ -210,6 +210,7 @@ public:
 
 protected:
 	void Start(bool runtimeCreated) override;
+	void Stop(bool runtimeRemoved) override;
 	void OnConfigLoaded() override;
 	void OnAllConfigLoaded() override;
 
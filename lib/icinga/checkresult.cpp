@@ -2,6 +2,7 @@
 
 #include "icinga/checkresult.hpp"
 #include "icinga/checkresult-ti.cpp"
+#include "base/objectlock.hpp"
 #include "base/scriptglobal.hpp"
 
 using namespace icinga;
@@ -32,3 +33,49 @@ double CheckResult::CalculateLatency() const
 
 	return latency;
 }
+
+/**
+ * Returns the performance data with all of its string values parsed.
+ *
+ * The values are parsed once on first use and shared by all callers (e.g. the
+ * perfdata writers), so they must not be modified.
+ *
+ * @return The values in their original order, empty if there's no performance data
+ */
+std::shared_ptr<const ParsedPerfdata> CheckResult::GetParsedPerformanceData() const
+{
+	Array::Ptr perfdata = GetPerformanceData();
+
+	std::unique_lock<std::mutex> lock (m_ParsedPerfdataMutex);
+
+	/* Somebody may have replaced the performance data after we've parsed it. */
+	if (m_ParsedPerfdata && m_ParsedPerfdataSource == perfdata)
+		return m_ParsedPerfdata;
+
+	auto parsed (std::make_shared<ParsedPerfdata>());
+
+	if (perfdata) {
+		ObjectLock olock(perfdata);
+
+		parsed->reserve(perfdata->GetLength());
+
+		for (const Value& val : perfdata) {
+			PerfdataValue::Ptr pdv;
+			PerfdataValueView view;
+
+			if (val.IsObjectType<PerfdataValue>()) {
+				pdv = val;
+			} else if (val.IsString() && PerfdataValue::ParseView(val.Get<String>().GetData(), view)) {
+				/* Parsed in place, invalid values don't cost an exception. */
+				pdv = new PerfdataValue(view);
+			}
+
+			parsed->push_back({ val, std::move(pdv) });
+		}
+	}
+
+	m_ParsedPerfdataSource = perfdata;
+	m_ParsedPerfdata = std::move(parsed);
+
+	return m_ParsedPerfdata;
+}
@@ -5,10 +5,27 @@
 
 #include "icinga/i2-icinga.hpp"
 #include "icinga/checkresult-ti.hpp"
+#include "base/perfdatavalue.hpp"
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace icinga
 {
 
+/**
+ * A performance data value of a check result.
+ *
+ * @ingroup icinga
+ */
+struct ParsedPerfdataValue
+{
+	Value Raw;
+	PerfdataValue::Ptr Parsed; /* nullptr if Raw is invalid */
+};
+
+typedef std::vector<ParsedPerfdataValue> ParsedPerfdata;
+
 /**
  * A check result.
  *
@@ -21,6 +38,13 @@ public:
 
 	double CalculateExecutionTime() const;
 	double CalculateLatency() const;
+
+	std::shared_ptr<const ParsedPerfdata> GetParsedPerformanceData() const;
+
+private:
+	mutable std::mutex m_ParsedPerfdataMutex;
+	mutable Array::Ptr m_ParsedPerfdataSource;
+	mutable std::shared_ptr<const ParsedPerfdata> m_ParsedPerfdata;
 };
 
 }
@@ -6,7 +6,7 @@
 #include "remote/configobjectutility.hpp"
 #include "base/utility.hpp"
 #include "base/configtype.hpp"
-#include "base/timer.hpp"
+#include "base/deadlinescheduler.hpp"
 #include <boost/thread/once.hpp>
 
 using namespace icinga;
@@ -14,7 +14,7 @@ using namespace icinga;
 static int l_NextCommentID = 1;
 static std::mutex l_CommentMutex;
 static std::map<int, String> l_LegacyCommentsCache;
-static Timer::Ptr l_CommentsExpireTimer;
+static DeadlineScheduler::Ptr l_CommentsExpireScheduler;
 
 boost::signals2::signal<void (const Comment::Ptr&)> Comment::OnCommentAdded;
 boost::signals2::signal<void (const Comment::Ptr&)> Comment::OnCommentRemoved;
@@ -81,10 +81,15 @@ void Comment::Start(bool runtimeCreated)
 	static boost::once_flag once = BOOST_ONCE_INIT;
 
 	boost::call_once(once, [this]() {
-		l_CommentsExpireTimer = Timer::Create();
-		l_CommentsExpireTimer->SetInterval(60);
-		l_CommentsExpireTimer->OnTimerExpired.connect([](const Timer * const&) { CommentsExpireTimerHandler(); });
-		l_CommentsExpireTimer->Start();
+		l_CommentsExpireScheduler = new DeadlineScheduler("Comment", [](const Object::Ptr& object) {
+			CommentExpiredHandler(static_pointer_cast<Comment>(object));
+		});
+
+		/* The expiry time may be changed later on, e.g. via the API. */
+		OnExpireTimeChanged.connect([](const Comment::Ptr& comment, const Value&) {
+			if (comment->IsActive())
+				comment->ScheduleExpiry();
+		});
 	});
 
 	{
@@ -97,6 +102,8 @@ void Comment::Start(bool runtimeCreated)
 
 	GetCheckable()->RegisterComment(this);
 
+	ScheduleExpiry();
+
 	if (runtimeCreated)
 		OnCommentAdded(this);
 }
@@ -105,6 +112,8 @@ void Comment::Stop(bool runtimeRemoved)
 {
 	GetCheckable()->UnregisterComment(this);
 
+	l_CommentsExpireScheduler->Unschedule(this);
+
 	if (runtimeRemoved)
 		OnCommentRemoved(this);
 
@@ -237,22 +246,25 @@ String Comment::GetCommentIDFromLegacyID(int id)
 	return it->second;
 }
 
-void Comment::CommentsExpireTimerHandler()
+void Comment::ScheduleExpiry()
 {
-	std::vector<Comment::Ptr> comments;
-
-	for (const Comment::Ptr& comment : ConfigType::GetObjectsByType<Comment>()) {
-		comments.push_back(comment);
-	}
+	/* Do not remove persistent comments from an acknowledgement */
+	if (GetExpireTime() != 0 && !(GetEntryType() == CommentAcknowledgement && GetPersistent()))
+		l_CommentsExpireScheduler->Schedule(this, GetExpireTime());
+	else
+		l_CommentsExpireScheduler->Unschedule(this);
+}
 
-	for (const Comment::Ptr& comment : comments) {
-		/* Only remove comments which are activated after daemon start. */
-		if (comment->IsActive() && comment->IsExpired()) {
-			/* Do not remove persistent comments from an acknowledgement */
-			if (comment->GetEntryType() == CommentAcknowledgement && comment->GetPersistent())
-				continue;
+void Comment::CommentExpiredHandler(const Comment::Ptr& comment)
+{
+	/* Only remove comments which are activated after daemon start. */
+	if (!comment->IsActive())
+		return;
 
-			RemoveComment(comment->GetName());
-		}
+	if (!comment->IsExpired()) {
+		l_CommentsExpireScheduler->Schedule(comment, comment->GetExpireTime());
+		return;
 	}
+
+	RemoveComment(comment->GetName());
 }
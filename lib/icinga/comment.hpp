@@ -51,7 +51,9 @@ protected:
 private:
 	ObjectImpl<Checkable>::Ptr m_Checkable;
 
-	static void CommentsExpireTimerHandler();
+	void ScheduleExpiry();
+
+	static void CommentExpiredHandler(const Comment::Ptr& comment);
 };
 
 }
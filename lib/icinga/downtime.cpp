@@ -6,8 +6,8 @@
 #include "icinga/scheduleddowntime.hpp"
 #include "remote/configobjectutility.hpp"
 #include "base/configtype.hpp"
+#include "base/deadlinescheduler.hpp"
 #include "base/utility.hpp"
-#include "base/timer.hpp"
 #include <boost/thread/once.hpp>
 #include <cmath>
 #include <utility>
@@ -17,8 +17,9 @@ using namespace icinga;
 static int l_NextDowntimeID = 1;
 static std::mutex l_DowntimeMutex;
 static std::map<int, String> l_LegacyDowntimesCache;
-static Timer::Ptr l_DowntimesOrphanedTimer;
-static Timer::Ptr l_DowntimesStartTimer;
+static DeadlineScheduler::Ptr l_DowntimesStartScheduler;
+static DeadlineScheduler::Ptr l_DowntimesCleanupScheduler;
+static DeadlineScheduler::Ptr l_DowntimesConfigOwnerScheduler;
 
 boost::signals2::signal<void (const Downtime::Ptr&)> Downtime::OnDowntimeAdded;
 boost::signals2::signal<void (const Downtime::Ptr&)> Downtime::OnDowntimeRemoved;
@@ -87,23 +88,40 @@ void Downtime::OnAllConfigLoaded()
 		BOOST_THROW_EXCEPTION(ScriptError("Downtime '" + GetName() + "' references a host/service which doesn't exist.", GetDebugInfo()));
 }
 
-void Downtime::Start(bool runtimeCreated)
+/**
+ * Creates the schedulers for all downtimes on first use.
+ */
+void Downtime::EnsureSchedulers()
 {
-	ObjectImpl<Downtime>::Start(runtimeCreated);
-
 	static boost::once_flag once = BOOST_ONCE_INIT;
 
-	boost::call_once(once, [this]() {
-		l_DowntimesStartTimer = Timer::Create();
-		l_DowntimesStartTimer->SetInterval(5);
-		l_DowntimesStartTimer->OnTimerExpired.connect([](const Timer * const&){ DowntimesStartTimerHandler(); });
-		l_DowntimesStartTimer->Start();
+	boost::call_once(once, []() {
+		l_DowntimesStartScheduler = new DeadlineScheduler("Downtime start", [](const Object::Ptr& object) {
+			DowntimeStartHandler(static_pointer_cast<Downtime>(object));
+		});
+
+		l_DowntimesCleanupScheduler = new DeadlineScheduler("Downtime cleanup", [](const Object::Ptr& object) {
+			DowntimeCleanupHandler(static_pointer_cast<Downtime>(object));
+		});
+
+		l_DowntimesConfigOwnerScheduler = new DeadlineScheduler("Downtime config owner", [](const Object::Ptr& object) {
+			DowntimeConfigOwnerHandler(static_pointer_cast<Downtime>(object));
+		});
+
+		auto timesChanged ([](const Downtime::Ptr& downtime, const Value&) { TimesChangedHandler(downtime); });
 
-		l_DowntimesOrphanedTimer = Timer::Create();
-		l_DowntimesOrphanedTimer->SetInterval(60);
-		l_DowntimesOrphanedTimer->OnTimerExpired.connect([](const Timer * const&) { DowntimesOrphanedTimerHandler(); });
-		l_DowntimesOrphanedTimer->Start();
+		OnStartTimeChanged.connect(timesChanged);
+		OnEndTimeChanged.connect(timesChanged);
+		OnDurationChanged.connect(timesChanged);
+		OnFixedChanged.connect(timesChanged);
 	});
+}
+
+void Downtime::Start(bool runtimeCreated)
+{
+	ObjectImpl<Downtime>::Start(runtimeCreated);
+
+	EnsureSchedulers();
 
 	{
 		std::unique_lock<std::mutex> lock(l_DowntimeMutex);
@@ -143,13 +161,25 @@ void Downtime::Start(bool runtimeCreated)
 
 		/* Trigger fixed downtime immediately. */
 		TriggerDowntime(std::fmax(GetStartTime(), GetEntryTime()));
+	} else if (GetFixed() && GetStartTime() > Utility::GetTime()) {
+		/* Start fixed downtimes later. Flexible downtimes will be triggered on-demand. */
+		l_DowntimesStartScheduler->Schedule(this, GetStartTime());
 	}
+
+	/* Give the zones and the config owner (if any) some time to show up. */
+	if (!GetConfigOwner().IsEmpty())
+		ScheduleConfigOwnerCheck(Utility::GetTime() + 60);
 }
 
 void Downtime::Stop(bool runtimeRemoved)
 {
 	GetCheckable()->UnregisterDowntime(this);
 
+	EnsureSchedulers();
+	l_DowntimesStartScheduler->Unschedule(this);
+	l_DowntimesCleanupScheduler->Unschedule(this);
+	l_DowntimesConfigOwnerScheduler->Unschedule(this);
+
 	Downtime::Ptr parent = GetByName(GetParent());
 
 	if (parent)
@@ -163,9 +193,8 @@ void Downtime::Stop(bool runtimeRemoved)
 
 void Downtime::Pause()
 {
-	if (m_CleanupTimer) {
-		m_CleanupTimer->Stop();
-	}
+	EnsureSchedulers();
+	l_DowntimesCleanupScheduler->Unschedule(this);
 
 	ObjectImpl<Downtime>::Pause();
 }
@@ -173,7 +202,7 @@ void Downtime::Pause()
 void Downtime::Resume()
 {
 	ObjectImpl<Downtime>::Resume();
-	SetupCleanupTimer();
+	ScheduleCleanup();
 }
 
 Checkable::Ptr Downtime::GetCheckable() const
@@ -444,26 +473,23 @@ bool Downtime::CanBeTriggered()
 	return true;
 }
 
-void Downtime::SetupCleanupTimer()
+void Downtime::ScheduleCleanup()
 {
-	if (!m_CleanupTimer) {
-		m_CleanupTimer = Timer::Create();
-
-		auto name (GetName());
-
-		m_CleanupTimer->OnTimerExpired.connect([name=std::move(name)](const Timer * const&) {
-			auto downtime (Downtime::GetByName(name));
-
-			if (downtime && downtime->IsExpired()) {
-				RemoveDowntime(name, false, false, true);
-			}
-		});
-	}
-
 	auto triggerTime (GetTriggerTime());
 
-	m_CleanupTimer->Reschedule((GetFixed() || triggerTime <= 0 ? GetEndTime() : triggerTime + GetDuration()) + 0.1);
-	m_CleanupTimer->Start();
+	EnsureSchedulers();
+	l_DowntimesCleanupScheduler->Schedule(this, (GetFixed() || triggerTime <= 0 ? GetEndTime() : triggerTime + GetDuration()) + 0.1);
+}
+
+/**
+ * Removes the downtime later on if its config owner (i.e. scheduled downtime) doesn't exist anymore by then.
+ *
+ * @param when The UNIX timestamp to check at
+ */
+void Downtime::ScheduleConfigOwnerCheck(double when)
+{
+	EnsureSchedulers();
+	l_DowntimesConfigOwnerScheduler->Schedule(this, when);
 }
 
 void Downtime::TriggerDowntime(double triggerTime)
@@ -482,7 +508,7 @@ void Downtime::TriggerDowntime(double triggerTime)
 
 	{
 		ObjectLock olock (this);
-		SetupCleanupTimer();
+		ScheduleCleanup();
 	}
 
 	Array::Ptr triggers = GetTriggers();
@@ -525,29 +551,54 @@ String Downtime::GetDowntimeIDFromLegacyID(int id)
 	return it->second;
 }
 
-void Downtime::DowntimesStartTimerHandler()
+/**
+ * Moves the start and the cleanup of a downtime whose times have been changed, e.g. via the API.
+ */
+void Downtime::TimesChangedHandler(const Downtime::Ptr& downtime)
 {
-	/* Start fixed downtimes. Flexible downtimes will be triggered on-demand. */
-	for (const Downtime::Ptr& downtime : ConfigType::GetObjectsByType<Downtime>()) {
-		if (downtime->IsActive() &&
-			downtime->CanBeTriggered() &&
-			downtime->GetFixed()) {
-			/* Send notifications. */
-			OnDowntimeStarted(downtime);
+	if (!downtime->IsActive())
+		return;
 
-			/* Trigger fixed downtime immediately. */
-			downtime->TriggerDowntime(std::fmax(downtime->GetStartTime(), downtime->GetEntryTime()));
-		}
-	}
+	/* Started fixed downtimes won't be triggered again, see CanBeTriggered(). */
+	if (downtime->GetFixed())
+		l_DowntimesStartScheduler->Schedule(downtime, downtime->GetStartTime());
+	else
+		l_DowntimesStartScheduler->Unschedule(downtime);
+
+	if (!downtime->IsPaused())
+		downtime->ScheduleCleanup();
 }
 
-void Downtime::DowntimesOrphanedTimerHandler()
+void Downtime::DowntimeStartHandler(const Downtime::Ptr& downtime)
 {
-	for (const Downtime::Ptr& downtime : ConfigType::GetObjectsByType<Downtime>()) {
-		/* Only remove downtimes which are activated after daemon start. */
-		if (downtime->IsActive() && !downtime->HasValidConfigOwner())
-			RemoveDowntime(downtime->GetName(), false, false, true);
+	if (!downtime->IsActive())
+		return;
+
+	if (Utility::GetTime() < downtime->GetStartTime()) {
+		l_DowntimesStartScheduler->Schedule(downtime, downtime->GetStartTime());
+		return;
 	}
+
+	if (downtime->CanBeTriggered()) {
+		/* Send notifications. */
+		OnDowntimeStarted(downtime);
+
+		/* Trigger fixed downtime immediately. */
+		downtime->TriggerDowntime(std::fmax(downtime->GetStartTime(), downtime->GetEntryTime()));
+	}
+}
+
+void Downtime::DowntimeCleanupHandler(const Downtime::Ptr& downtime)
+{
+	if (downtime->IsExpired())
+		RemoveDowntime(downtime->GetName(), false, false, true);
+}
+
+void Downtime::DowntimeConfigOwnerHandler(const Downtime::Ptr& downtime)
+{
+	/* Only remove downtimes which are activated after daemon start. */
+	if (downtime->IsActive() && !downtime->HasValidConfigOwner())
+		RemoveDowntime(downtime->GetName(), false, false, true);
 }
 
 void Downtime::ValidateStartTime(const Lazy<Timestamp>& lvalue, const ValidationUtils& utils)
@@ -60,6 +60,7 @@ public:
 	std::set<Downtime::Ptr> GetChildren() const;
 
 	void TriggerDowntime(double triggerTime);
+	void ScheduleConfigOwnerCheck(double when);
 	void SetRemovalInfo(const String& removedBy, double removeTime, const MessageOrigin::Ptr& origin = nullptr);
 
 	void OnAllConfigLoaded() override;
@@ -84,14 +85,16 @@ private:
 	std::set<Downtime::Ptr> m_Children;
 	mutable std::mutex m_ChildrenMutex;
 
-	Timer::Ptr m_CleanupTimer;
-
 	bool CanBeTriggered();
 
-	void SetupCleanupTimer();
+	void ScheduleCleanup();
+
+	static void EnsureSchedulers();
 
-	static void DowntimesStartTimerHandler();
-	static void DowntimesOrphanedTimerHandler();
+	static void TimesChangedHandler(const Downtime::Ptr& downtime);
+	static void DowntimeStartHandler(const Downtime::Ptr& downtime);
+	static void DowntimeCleanupHandler(const Downtime::Ptr& downtime);
+	static void DowntimeConfigOwnerHandler(const Downtime::Ptr& downtime);
 };
 
 }
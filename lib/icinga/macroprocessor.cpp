@@ -85,21 +85,91 @@ static MacroProcessor::ResolverList GetDefaultResolvers()
 	};
 }
 
-bool MacroProcessor::ResolveMacro(const String& macro, const ResolverList& resolvers,
-	const CheckResult::Ptr& cr, Value *result, bool *recursive_macro)
+/* Compiled macro strings are dropped altogether once there are that many of them. */
+static const size_t l_MaxMacroTemplates = 16384;
+
+std::shared_timed_mutex MacroProcessor::m_TemplatesMutex;
+std::unordered_map<String, std::shared_ptr<const MacroProcessor::MacroTemplate>> MacroProcessor::m_Templates;
+
+/**
+ * Returns the compiled form of a macro string.
+ *
+ * Compiled strings are cached by their content, so a modified command line
+ * or argument just gets compiled again.
+ *
+ * @param str The macro string
+ */
+std::shared_ptr<const MacroProcessor::MacroTemplate> MacroProcessor::GetTemplate(const String& str)
 {
-	CONTEXT("Resolving macro '" << macro << "'");
+	{
+		std::shared_lock<std::shared_timed_mutex> lock (m_TemplatesMutex);
 
-	*recursive_macro = false;
+		auto it (m_Templates.find(str));
+
+		if (it != m_Templates.end())
+			return it->second;
+	}
+
+	auto tmpl (CompileTemplate(str));
+
+	std::unique_lock<std::shared_timed_mutex> lock (m_TemplatesMutex);
+
+	if (m_Templates.size() >= l_MaxMacroTemplates)
+		m_Templates.clear();
+
+	m_Templates.emplace(str, tmpl);
+
+	return tmpl;
+}
+
+std::shared_ptr<const MacroProcessor::MacroTemplate> MacroProcessor::CompileTemplate(const String& str)
+{
+	auto tmpl (std::make_shared<MacroTemplate>());
+	size_t offset = 0, pos_first, pos_second;
 
-	std::vector<String> tokens = macro.Split(".");
+	tmpl->Unterminated = false;
 
-	String objName;
-	if (tokens.size() > 1) {
-		objName = tokens[0];
-		tokens.erase(tokens.begin());
+	while ((pos_first = str.FindFirstOf("$", offset)) != String::NPos) {
+		pos_second = str.FindFirstOf("$", pos_first + 1);
+
+		if (pos_second == String::NPos) {
+			tmpl->Unterminated = true;
+			break;
+		}
+
+		tmpl->Literals.emplace_back(str.SubStr(offset, pos_first - offset));
+
+		MacroReference macro;
+		macro.Name = str.SubStr(pos_first + 1, pos_second - pos_first - 1);
+		macro.Tokens = macro.Name.Split(".");
+
+		if (macro.Tokens.size() > 1) {
+			macro.ObjName = macro.Tokens[0];
+			macro.Tokens.erase(macro.Tokens.begin());
+		}
+
+		macro.Attribute = boost::algorithm::join(macro.Tokens, ".");
+
+		tmpl->Macros.emplace_back(std::move(macro));
+
+		offset = pos_second + 1;
 	}
 
+	tmpl->Literals.emplace_back(str.SubStr(offset));
+
+	return tmpl;
+}
+
+bool MacroProcessor::ResolveMacro(const MacroReference& macro, const ResolverList& resolvers,
+	const CheckResult::Ptr& cr, Value *result, bool *recursive_macro)
+{
+	CONTEXT("Resolving macro '" << macro.Name << "'");
+
+	*recursive_macro = false;
+
+	const String& objName = macro.ObjName;
+	const std::vector<String>& tokens = macro.Tokens;
+
 	const auto defaultResolvers (GetDefaultResolvers());
 
 	for (auto resolverList : {&resolvers, &defaultResolvers}) {
@@ -116,8 +186,8 @@ bool MacroProcessor::ResolveMacro(const String& macro, const ResolverList& resol
 				if (dobj) {
 					Dictionary::Ptr vars = dobj->GetVars();
 
-					if (vars && vars->Contains(macro)) {
-						*result = vars->Get(macro);
+					if (vars && vars->Contains(macro.Name)) {
+						*result = vars->Get(macro.Name);
 						*recursive_macro = true;
 						return true;
 					}
@@ -126,7 +196,7 @@ bool MacroProcessor::ResolveMacro(const String& macro, const ResolverList& resol
 
 			auto *mresolver = dynamic_cast<MacroResolver *>(resolver.Obj.get());
 
-			if (mresolver && mresolver->ResolveMacro(boost::algorithm::join(tokens, "."), cr, result))
+			if (mresolver && mresolver->ResolveMacro(macro.Attribute, cr, result))
 				return true;
 
 			Value ref = resolver.Obj;
@@ -232,38 +302,34 @@ Value MacroProcessor::InternalResolveMacros(const String& str, const ResolverLis
 	if (recursionLevel > 15)
 		BOOST_THROW_EXCEPTION(std::runtime_error("Infinite recursion detected while resolving macros"));
 
-	size_t offset, pos_first, pos_second;
-	offset = 0;
+	/* Most arguments don't contain any macros at all. */
+	if (str.FindFirstOf("$") == String::NPos)
+		return str;
 
-	Dictionary::Ptr resolvers_this;
+	auto tmpl (GetTemplate(str));
+	String result = tmpl->Literals[0];
 
-	String result = str;
-	while ((pos_first = result.FindFirstOf("$", offset)) != String::NPos) {
-		pos_second = result.FindFirstOf("$", pos_first + 1);
-
-		if (pos_second == String::NPos)
-			BOOST_THROW_EXCEPTION(std::runtime_error("Closing $ not found in macro format string."));
-
-		String name = result.SubStr(pos_first + 1, pos_second - pos_first - 1);
+	for (size_t i = 0; i < tmpl->Macros.size(); i++) {
+		const MacroReference& macro = tmpl->Macros[i];
+		const String& name = macro.Name;
 
 		Value resolved_macro;
 		bool recursive_macro;
 		bool found;
 
-		if (useResolvedMacros) {
+		/* $$ is an escape sequence for $. */
+		if (name.IsEmpty()) {
+			resolved_macro = "$";
+			recursive_macro = false;
+			found = true;
+		} else if (useResolvedMacros) {
 			recursive_macro = false;
 			found = resolvedMacros->Contains(name);
 
 			if (found)
 				resolved_macro = resolvedMacros->Get(name);
 		} else
-			found = ResolveMacro(name, resolvers, cr, &resolved_macro, &recursive_macro);
-
-		/* $$ is an escape sequence for $. */
-		if (name.IsEmpty()) {
-			resolved_macro = "$";
-			found = true;
-		}
+			found = ResolveMacro(macro, resolvers, cr, &resolved_macro, &recursive_macro);
 
 		if (resolved_macro.IsObjectType<Function>()) {
 			resolved_macro = EvaluateFunction(resolved_macro, resolvers, cr, escapeFn,
@@ -309,25 +375,20 @@ Value MacroProcessor::InternalResolveMacros(const String& str, const ResolverLis
 			resolved_macro = escapeFn(resolved_macro);
 
 		/* we're done if this is the only macro and there are no other non-macro parts in the string */
-		if (pos_first == 0 && pos_second == str.GetLength() - 1)
-			return resolved_macro;
-		else if (resolved_macro.IsObjectType<Array>())
-				BOOST_THROW_EXCEPTION(std::invalid_argument("Mixing both strings and non-strings in macros is not allowed."));
-
-		if (resolved_macro.IsObjectType<Array>()) {
-			/* don't allow mixing strings and arrays in macro strings */
-			if (pos_first != 0 || pos_second != str.GetLength() - 1)
-				BOOST_THROW_EXCEPTION(std::invalid_argument("Mixing both strings and non-strings in macros is not allowed."));
-
+		if (tmpl->Macros.size() == 1 && !tmpl->Unterminated && tmpl->Literals[0].IsEmpty() && tmpl->Literals[1].IsEmpty())
 			return resolved_macro;
-		}
 
-		String resolved_macro_str = resolved_macro;
+		/* don't allow mixing strings and arrays in macro strings */
+		if (resolved_macro.IsObjectType<Array>())
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Mixing both strings and non-strings in macros is not allowed."));
 
-		result.Replace(pos_first, pos_second - pos_first + 1, resolved_macro_str);
-		offset = pos_first + resolved_macro_str.GetLength();
+		result += static_cast<String>(resolved_macro);
+		result += tmpl->Literals[i + 1];
 	}
 
+	if (tmpl->Unterminated)
+		BOOST_THROW_EXCEPTION(std::runtime_error("Closing $ not found in macro format string."));
+
 	return result;
 }
 
@@ -6,6 +6,9 @@
 #include "icinga/i2-icinga.hpp"
 #include "icinga/checkable.hpp"
 #include "base/value.hpp"
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 
@@ -51,9 +54,37 @@ public:
 	static void ValidateCustomVars(const ConfigObject::Ptr& object, const Dictionary::Ptr& value);
 
 private:
+	/**
+	 * A macro reference, e.g. $host.vars.x$, split into its parts.
+	 */
+	struct MacroReference
+	{
+		String Name; /* host.vars.x */
+		String ObjName; /* host, empty for short macros like $address$ */
+		std::vector<String> Tokens; /* vars, x */
+		String Attribute; /* vars.x */
+	};
+
+	/**
+	 * A macro string split into literal segments and the macro references between them,
+	 * i.e. Literals[0] Macros[0] Literals[1] ... Macros[n-1] Literals[n].
+	 */
+	struct MacroTemplate
+	{
+		std::vector<String> Literals;
+		std::vector<MacroReference> Macros;
+		bool Unterminated; /* the last $ isn't closed */
+	};
+
+	static std::shared_timed_mutex m_TemplatesMutex;
+	static std::unordered_map<String, std::shared_ptr<const MacroTemplate>> m_Templates;
+
 	MacroProcessor();
 
-	static bool ResolveMacro(const String& macro, const ResolverList& resolvers,
+	static std::shared_ptr<const MacroTemplate> GetTemplate(const String& str);
+	static std::shared_ptr<const MacroTemplate> CompileTemplate(const String& str);
+
+	static bool ResolveMacro(const MacroReference& macro, const ResolverList& resolvers,
 		const CheckResult::Ptr& cr, Value *result, bool *recursive_macro);
 	static Value InternalResolveMacros(const String& str,
 		const ResolverList& resolvers, const CheckResult::Ptr& cr,
@@ -126,56 +126,108 @@ std::pair<String, String> PluginUtility::ParseCheckOutput(const String& output)
 	return std::make_pair(text, perfdata);
 }
 
-Array::Ptr PluginUtility::SplitPerfdata(const String& perfdata)
+/**
+ * Splits performance data into its values.
+ *
+ * @param perfdata The performance data
+ * @param callback Called with each value's label (without quotes), the check_multi prefix
+ *                 the label is relative to, the whole value and the part after the label
+ */
+template<class F>
+static void SplitPerfdataValues(std::string_view perfdata, const F& callback)
 {
-	ArrayData result;
-
 	size_t begin = 0;
-	String multi_prefix;
+	std::string_view multiPrefix;
 
 	for (;;) {
-		size_t eqp = perfdata.FindFirstOf('=', begin);
+		size_t eqp = perfdata.find('=', begin);
 
-		if (eqp == String::NPos)
+		if (eqp == std::string_view::npos)
 			break;
 
-		String label = perfdata.SubStr(begin, eqp - begin);
+		std::string_view label = perfdata.substr(begin, eqp - begin);
 
-		if (label.GetLength() > 2 && label[0] == '\'' && label[label.GetLength() - 1] == '\'')
-			label = label.SubStr(1, label.GetLength() - 2);
+		if (label.size() > 2 && label.front() == '\'' && label.back() == '\'')
+			label = label.substr(1, label.size() - 2);
 
-		size_t multi_index = label.RFind("::");
+		size_t multiIndex = label.rfind("::");
 
-		if (multi_index != String::NPos)
-			multi_prefix = "";
+		if (multiIndex != std::string_view::npos)
+			multiPrefix = std::string_view();
 
-		size_t spq = perfdata.FindFirstOf(' ', eqp);
+		size_t spq = perfdata.find(' ', eqp);
 
-		if (spq == String::NPos)
-			spq = perfdata.GetLength();
+		if (spq == std::string_view::npos)
+			spq = perfdata.size();
 
-		String value = perfdata.SubStr(eqp + 1, spq - eqp - 1);
+		callback(label, multiPrefix, perfdata.substr(begin, spq - begin), perfdata.substr(eqp + 1, spq - eqp - 1));
 
-		if (!multi_prefix.IsEmpty())
-			label = multi_prefix + "::" + label;
+		if (multiIndex != std::string_view::npos)
+			multiPrefix = label.substr(0, multiIndex);
 
-		String pdv;
-		if (label.FindFirstOf(" ") != String::NPos)
-			pdv = "'" + label + "'=" + value;
-		else
-			pdv = label + "=" + value;
+		begin = spq + 1;
+	}
+}
 
-		result.emplace_back(std::move(pdv));
+Array::Ptr PluginUtility::SplitPerfdata(const String& perfdata)
+{
+	ArrayData result;
 
-		if (multi_index != String::NPos)
-			multi_prefix = label.SubStr(0, multi_index);
+	SplitPerfdataValues(perfdata.GetData(), [&result](std::string_view label, std::string_view multiPrefix, std::string_view, std::string_view value) {
+		bool quote = label.find(' ') != std::string_view::npos || multiPrefix.find(' ') != std::string_view::npos;
+		std::string pdv;
 
-		begin = spq + 1;
-	}
+		pdv.reserve(multiPrefix.size() + label.size() + value.size() + 5);
+
+		if (quote)
+			pdv += '\'';
+
+		if (!multiPrefix.empty()) {
+			pdv += multiPrefix;
+			pdv += "::";
+		}
+
+		pdv += label;
+
+		if (quote)
+			pdv += '\'';
+
+		pdv += '=';
+		pdv += value;
+
+		result.emplace_back(String(std::move(pdv)));
+	});
 
 	return new Array(std::move(result));
 }
 
+/**
+ * Parses performance data without copying any parts of it.
+ *
+ * @param perfdata The performance data
+ * @param result The values are appended to it, they refer to perfdata
+ *
+ * @return The number of invalid values which have been skipped
+ */
+size_t PluginUtility::ParsePerfdata(std::string_view perfdata, std::vector<PerfdataValueView>& result)
+{
+	size_t invalid = 0;
+
+	SplitPerfdataValues(perfdata, [&result, &invalid](std::string_view, std::string_view multiPrefix, std::string_view pdv, std::string_view) {
+		PerfdataValueView view;
+
+		if (!PerfdataValue::ParseView(pdv, view)) {
+			invalid++;
+			return;
+		}
+
+		view.MultiPrefix = multiPrefix;
+		result.push_back(view);
+	});
+
+	return invalid;
+}
+
 String PluginUtility::FormatPerfdata(const Array::Ptr& perfdata, bool normalize)
 {
 	if (!perfdata)
@@ -195,17 +247,12 @@ String PluginUtility::FormatPerfdata(const Array::Ptr& perfdata, bool normalize)
 		if (pdv.IsObjectType<PerfdataValue>()) {
 			result << static_cast<PerfdataValue::Ptr>(pdv)->Format();
 		} else if (normalize) {
-			PerfdataValue::Ptr normalized;
-
-			try {
-				normalized = PerfdataValue::Parse(pdv);
-			} catch (const std::invalid_argument& ex) {
-				Log(LogDebug, "PerfdataValue") << ex.what();
-			}
+			PerfdataValueView view;
 
-			if (normalized) {
-				result << normalized->Format();
+			if (pdv.IsString() && PerfdataValue::ParseView(pdv.Get<String>().GetData(), view)) {
+				result << PerfdataValue::Ptr(new PerfdataValue(view))->Format();
 			} else {
+				Log(LogDebug, "PerfdataValue") << "Invalid performance data value: " << pdv;
 				result << pdv;
 			}
 		} else {
@@ -7,6 +7,8 @@
 #include "icinga/checkable.hpp"
 #include "icinga/checkcommand.hpp"
 #include "icinga/macroprocessor.hpp"
+#include "base/perfdatavalue.hpp"
+#include <string_view>
 #include <vector>
 
 namespace icinga
@@ -31,6 +33,7 @@ public:
 	static std::pair<String, String> ParseCheckOutput(const String& output);
 
 	static Array::Ptr SplitPerfdata(const String& perfdata);
+	static size_t ParsePerfdata(std::string_view perfdata, std::vector<PerfdataValueView>& result);
 	static String FormatPerfdata(const Array::Ptr& perfdata, bool normalize = false);
 
 private:
@@ -5,7 +5,7 @@
 #include "icinga/legacytimeperiod.hpp"
 #include "icinga/downtime.hpp"
 #include "icinga/service.hpp"
-#include "base/timer.hpp"
+#include "base/deadlinescheduler.hpp"
 #include "base/tlsutility.hpp"
 #include "base/configtype.hpp"
 #include "base/utility.hpp"
@@ -22,7 +22,7 @@ using namespace icinga;
 
 REGISTER_TYPE(ScheduledDowntime);
 
-static Timer::Ptr l_Timer;
+static DeadlineScheduler::Ptr l_Scheduler;
 
 String ScheduledDowntimeNameComposer::MakeName(const String& shortName, const Object::Ptr& context) const
 {
@@ -78,38 +78,76 @@ void ScheduledDowntime::Start(bool runtimeCreated)
 	static boost::once_flag once = BOOST_ONCE_INIT;
 
 	boost::call_once(once, [this]() {
-		l_Timer = Timer::Create();
-		l_Timer->SetInterval(60);
-		l_Timer->OnTimerExpired.connect([](const Timer * const&) { TimerProc(); });
-		l_Timer->Start();
+		l_Scheduler = new DeadlineScheduler("ScheduledDowntime", [](const Object::Ptr& object) {
+			ScheduleHandler(static_pointer_cast<ScheduledDowntime>(object));
+		});
+
+		/* The next run is only scheduled for the current options, check again if they're changed (e.g. via the API). */
+		auto reschedule ([](const ScheduledDowntime::Ptr& sd, const Value&) {
+			if (sd->IsActive())
+				l_Scheduler->Schedule(sd, Utility::GetTime());
+		});
+
+		OnRangesChanged.connect(reschedule);
+		OnDurationChanged.connect(reschedule);
+		OnFixedChanged.connect(reschedule);
+		OnChildOptionsChanged.connect(reschedule);
 	});
 
 	if (!IsPaused())
 		Utility::QueueAsyncCallback([this]() { CreateNextDowntime(); });
+
+	l_Scheduler->Schedule(this, Utility::GetTime() + 60);
+}
+
+void ScheduledDowntime::Stop(bool runtimeRemoved)
+{
+	l_Scheduler->Unschedule(this);
+
+	if (runtimeRemoved) {
+		auto name (GetName());
+
+		/* Our downtimes are orphaned as soon as we're gone, i.e. some seconds later. */
+		for (const Downtime::Ptr& downtime : GetCheckable()->GetDowntimes()) {
+			if (downtime->GetConfigOwner() == name)
+				downtime->ScheduleConfigOwnerCheck(Utility::GetTime() + 5);
+		}
+	}
+
+	ObjectImpl<ScheduledDowntime>::Stop(runtimeRemoved);
 }
 
-void ScheduledDowntime::TimerProc()
+void ScheduledDowntime::ScheduleHandler(const ScheduledDowntime::Ptr& sd)
 {
-	for (const ScheduledDowntime::Ptr& sd : ConfigType::GetObjectsByType<ScheduledDowntime>()) {
-		if (sd->IsActive() && !sd->IsPaused()) {
-			try {
-				sd->CreateNextDowntime();
-			} catch (const std::exception& ex) {
-				Log(LogCritical, "ScheduledDowntime")
-					<< "Exception occurred during creation of next downtime for scheduled downtime '"
-					<< sd->GetName() << "': " << DiagnosticInformation(ex, false);
-				continue;
-			}
-
-			try {
-				sd->RemoveObsoleteDowntimes();
-			} catch (const std::exception& ex) {
-				Log(LogCritical, "ScheduledDowntime")
-					<< "Exception occurred during removal of obsolete downtime for scheduled downtime '"
-					<< sd->GetName() << "': " << DiagnosticInformation(ex, false);
-			}
+	if (!sd->IsActive())
+		return;
+
+	/* Retry (or wait for becoming unpaused) a minute later unless there's a pending downtime to wait for. */
+	double next = Utility::GetTime() + 60;
+
+	if (!sd->IsPaused()) {
+		try {
+			sd->CreateNextDowntime();
+			next = sd->GetNextDowntimeStart(next);
+		} catch (const std::exception& ex) {
+			Log(LogCritical, "ScheduledDowntime")
+				<< "Exception occurred during creation of next downtime for scheduled downtime '"
+				<< sd->GetName() << "': " << DiagnosticInformation(ex, false);
+
+			l_Scheduler->Schedule(sd, next);
+			return;
+		}
+
+		try {
+			sd->RemoveObsoleteDowntimes();
+		} catch (const std::exception& ex) {
+			Log(LogCritical, "ScheduledDowntime")
+				<< "Exception occurred during removal of obsolete downtime for scheduled downtime '"
+				<< sd->GetName() << "': " << DiagnosticInformation(ex, false);
 		}
 	}
+
+	l_Scheduler->Schedule(sd, next);
 }
 
 Checkable::Ptr ScheduledDowntime::GetCheckable() const
@@ -310,6 +348,36 @@ void ScheduledDowntime::CreateNextDowntime()
 	}
 }
 
+/**
+ * Returns when CreateNextDowntime() has something to do again, i.e. when our pending downtime starts.
+ *
+ * @param fallback Returned if there's no pending downtime
+ * @return UNIX timestamp
+ */
+double ScheduledDowntime::GetNextDowntimeStart(double fallback)
+{
+	auto name (GetName());
+	auto downtimeOptionsHash (HashDowntimeOptions());
+	double now = Utility::GetTime();
+	double next = 0;
+
+	for (const Downtime::Ptr& downtime : GetCheckable()->GetDowntimes()) {
+		if (downtime->GetScheduledBy() != name)
+			continue;
+
+		auto configOwnerHash (downtime->GetConfigOwnerHash());
+		if (!configOwnerHash.IsEmpty() && configOwnerHash != downtimeOptionsHash)
+			continue;
+
+		double start = downtime->GetStartTime();
+
+		if (start >= now && (next == 0 || start < next))
+			next = start;
+	}
+
+	return next == 0 ? fallback : next;
+}
+
 void ScheduledDowntime::RemoveObsoleteDowntimes()
 {
 	auto name (GetName());
@@ -40,13 +40,15 @@ public:
 protected:
 	void OnAllConfigLoaded() override;
 	void Start(bool runtimeCreated) override;
+	void Stop(bool runtimeRemoved) override;
 
 private:
-	static void TimerProc();
+	static void ScheduleHandler(const ScheduledDowntime::Ptr& sd);
 
 	std::pair<double, double> FindRunningSegment(double minEnd = 0);
 	std::pair<double, double> FindNextSegment();
 	void CreateNextDowntime();
+	double GetNextDowntimeStart(double fallback);
 	void RemoveObsoleteDowntimes();
 
 	static std::atomic<bool> m_AllConfigLoaded;
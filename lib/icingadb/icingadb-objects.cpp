@@ -192,9 +192,19 @@ void IcingaDB::UpdateAllConfigObjects()
 	m_Rcon->SuppressQueryKind(Prio::CheckResult);
 	m_Rcon->SuppressQueryKind(Prio::RuntimeStateSync);
 
+	for (auto& con : m_StateRcons) {
+		con->SuppressQueryKind(Prio::CheckResult);
+		con->SuppressQueryKind(Prio::RuntimeStateSync);
+	}
+
 	Defer unSuppress ([this]() {
 		m_Rcon->UnsuppressQueryKind(Prio::RuntimeStateSync);
 		m_Rcon->UnsuppressQueryKind(Prio::CheckResult);
+
+		for (auto& con : m_StateRcons) {
+			con->UnsuppressQueryKind(Prio::RuntimeStateSync);
+			con->UnsuppressQueryKind(Prio::CheckResult);
+		}
 	});
 
 	// Add a new type=* state=wip entry to the stream and remove all previous entries (MAXLEN 1).
@@ -1124,6 +1134,7 @@ void IcingaDB::UpdateState(const Checkable::Ptr& checkable, StateUpdate mode)
 
 	String objectType = GetLowerCaseTypeNameDB(checkable);
 	String objectKey = GetObjectIdentifier(checkable);
+	auto& rcon (GetStateConnection(objectKey));
 
 	Dictionary::Ptr stateAttrs = SerializeState(checkable);
 
@@ -1131,11 +1142,13 @@ void IcingaDB::UpdateState(const Checkable::Ptr& checkable, StateUpdate mode)
 	String redisChecksumKey = m_PrefixConfigCheckSum + objectType + ":state";
 	String checksum = HashValue(stateAttrs);
 
+	RedisConnection::Queries volatileUpdate, runtimeUpdate;
+
 	if (mode & StateUpdate::Volatile) {
-		m_Rcon->FireAndForgetQueries({
+		volatileUpdate = {
 			{"HSET", redisStateKey, objectKey, JsonEncode(stateAttrs)},
 			{"HSET", redisChecksumKey, objectKey, JsonEncode(new Dictionary({{"checksum", checksum}}))},
-		}, Prio::RuntimeStateSync);
+		};
 	}
 
 	if (mode & StateUpdate::RuntimeOnly) {
@@ -1153,8 +1166,53 @@ void IcingaDB::UpdateState(const Checkable::Ptr& checkable, StateUpdate mode)
 			streamadd.emplace_back(IcingaToStreamValue(kv.second));
 		}
 
-		m_Rcon->FireAndForgetQuery(std::move(streamadd), Prio::RuntimeStateStream, {0, 1});
+		runtimeUpdate.emplace_back(std::move(streamadd));
+	}
+
+	/* While the config dump is running, the volatile state is held back (RuntimeStateSync is suppressed),
+	 * but the runtime updates are not. The main connection always sends them like that, it has to
+	 * prioritize them against the history and config updates it sends as well. */
+	if (!m_ConfigDumpDone || rcon == m_Rcon) {
+		if (!volatileUpdate.empty()) {
+			rcon->FireAndForgetQueries(std::move(volatileUpdate), Prio::RuntimeStateSync);
+		}
+
+		if (!runtimeUpdate.empty()) {
+			rcon->FireAndForgetQueries(std::move(runtimeUpdate), Prio::RuntimeStateStream, {0, 1});
+		}
+
+		return;
 	}
+
+	/* Afterwards a dedicated connection sends all of them with the same priority, i.e. in order, and both parts
+	 * of a full update as one transaction. */
+	RedisConnection::Queries queries (std::move(volatileUpdate));
+	size_t affectsState = runtimeUpdate.size();
+
+	for (auto& query : runtimeUpdate) {
+		queries.emplace_back(std::move(query));
+	}
+
+	if (queries.size() > 1) {
+		queries.insert(queries.begin(), RedisConnection::Query{"MULTI"});
+		queries.push_back({"EXEC"});
+	}
+
+	rcon->FireAndForgetQueries(std::move(queries), Prio::RuntimeStateSync, {0, affectsState});
+}
+
+/**
+ * Returns the connection which runtime state updates of an object are sent over.
+ *
+ * @param objectKey The object's identifier
+ */
+const RedisConnection::Ptr& IcingaDB::GetStateConnection(const String& objectKey)
+{
+	if (m_StateRcons.empty()) {
+		return m_Rcon;
+	}
+
+	return m_StateRcons[std::hash<String>()(objectKey) % m_StateRcons.size()];
 }
 
 // Used to update a single object, used for runtime updates
@@ -1580,7 +1638,8 @@ void IcingaDB::SendConfigDelete(const ConfigObject::Ptr& object)
 			GetObjectIdentifier(checkable)
 		}, Prio::CheckResult);
 
-		m_Rcon->FireAndForgetQueries({
+		/* Over the same connection as the state updates, so that a pending update can't recreate the state. */
+		GetStateConnection(objectKey)->FireAndForgetQueries({
 			{"HDEL", m_PrefixConfigObject + typeName + ":state", objectKey},
 			{"HDEL", m_PrefixConfigCheckSum + typeName + ":state", objectKey}
 		}, Prio::RuntimeStateSync);
@@ -106,12 +106,29 @@ void IcingaDB::Start(bool runtimeCreated)
 
 	m_PendingRcons = m_Rcons.size();
 
+	m_StateRcons.clear();
+
+	for (int i = 0; i < GetRuntimeConnections(); i++) {
+		RedisConnection::Ptr con = new RedisConnection(GetHost(), GetPort(), GetPath(), GetPassword(), GetDbIndex(),
+			GetEnableTls(), GetInsecureNoverify(), GetCertPath(), GetKeyPath(), GetCaPath(), GetCrlPath(),
+			GetTlsProtocolmin(), GetCipherList(), GetConnectTimeout(), GetDebugInfo(), m_Rcon);
+
+		con->SuppressQueryKind(Prio::CheckResult);
+		con->SuppressQueryKind(Prio::RuntimeStateSync);
+
+		m_StateRcons.emplace_back(std::move(con));
+	}
+
 	m_Rcon->SetConnectedCallback([this](boost::asio::yield_context& yc) {
 		m_Rcon->SetConnectedCallback(nullptr);
 
 		for (auto& kv : m_Rcons) {
 			kv.second->Start();
 		}
+
+		for (auto& con : m_StateRcons) {
+			con->Start();
+		}
 	});
 	m_Rcon->Start();
 
@@ -223,6 +240,15 @@ void IcingaDB::ValidateConnectTimeout(const Lazy<double>& lvalue, const Validati
 	}
 }
 
+void IcingaDB::ValidateRuntimeConnections(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<IcingaDB>::ValidateRuntimeConnections(lvalue, utils);
+
+	if (lvalue() < 0) {
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "runtime_connections" }, "Value must not be negative."));
+	}
+}
+
 void IcingaDB::AssertOnWorkQueue()
 {
 	ASSERT(m_WorkQueue.IsWorkerThread());
@@ -23,6 +23,7 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 namespace icinga
 {
@@ -70,6 +71,7 @@ public:
 protected:
 	void ValidateTlsProtocolmin(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
 	void ValidateConnectTimeout(const Lazy<double>& lvalue, const ValidationUtils& utils) override;
+	void ValidateRuntimeConnections(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
 
 private:
 	class DumpedGlobals
@@ -104,6 +106,7 @@ private:
 	void InsertObjectDependencies(const ConfigObject::Ptr& object, const String typeName, std::map<String, std::vector<String>>& hMSets,
 			std::vector<Dictionary::Ptr>& runtimeUpdates, bool runtimeUpdate);
 	void UpdateState(const Checkable::Ptr& checkable, StateUpdate mode);
+	const RedisConnection::Ptr& GetStateConnection(const String& objectKey);
 	void SendConfigUpdate(const ConfigObject::Ptr& object, bool runtimeUpdate);
 	void CreateConfigUpdate(const ConfigObject::Ptr& object, const String type, std::map<String, std::vector<String>>& hMSets,
 			std::vector<Dictionary::Ptr>& runtimeUpdates, bool runtimeUpdate);
@@ -214,7 +217,7 @@ private:
 	String m_PrefixConfigCheckSum;
 
 	bool m_ConfigDumpInProgress;
-	bool m_ConfigDumpDone;
+	std::atomic<bool> m_ConfigDumpDone;
 
 	RedisConnection::Ptr m_Rcon;
 	// m_RconLocked containes a copy of the value in m_Rcon where all accesses are guarded by a mutex to allow safe
@@ -223,6 +226,9 @@ private:
 	Locked<RedisConnection::Ptr> m_RconLocked;
 	std::unordered_map<ConfigType*, RedisConnection::Ptr> m_Rcons;
 	std::atomic_size_t m_PendingRcons;
+	// Runtime state updates are spread across these connections by object, so that all updates of an object keep
+	// their order. If there are none, m_Rcon is used.
+	std::vector<RedisConnection::Ptr> m_StateRcons;
 
 	struct {
 		DumpedGlobals CustomVar, ActionUrl, NotesUrl, IconImage;
@@ -10,6 +10,7 @@
 #include "base/perfdatavalue.hpp"
 #include "base/convert.hpp"
 #include <utility>
+#include <vector>
 
 using namespace icinga;
 
@@ -386,11 +387,13 @@ void IcingadbCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckR
 	}
 
 	{
-		Array::Ptr values = PluginUtility::SplitPerfdata(perfdataFromRedis);
-		ObjectLock lock (values);
+		std::vector<PerfdataValueView> values;
+
+		if (PluginUtility::ParsePerfdata(perfdataFromRedis.GetData(), values))
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid performance data: " + perfdataFromRedis));
 
 		for (auto& v : values) {
-			perfdata->Add(PerfdataValue::Parse(v));
+			perfdata->Add(new PerfdataValue(v));
 		}
 	}
 
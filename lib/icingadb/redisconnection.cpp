@@ -586,8 +586,9 @@ void RedisConnection::WriteItem(boost::asio::yield_context& yc, RedisConnection:
 		DecreasePendingQueries(item.size());
 
 		try {
+			/* Pipeline the queries, i.e. flush only once after the last one. */
 			for (auto& query : item) {
-				WriteOne(query, yc);
+				WriteOne(query, yc, i + 1u == item.size());
 				++i;
 			}
 		} catch (const boost::coroutines::detail::forced_unwind&) {
@@ -645,8 +646,8 @@ void RedisConnection::WriteItem(boost::asio::yield_context& yc, RedisConnection:
 		DecreasePendingQueries(item.first.size());
 
 		try {
-			for (auto& query : item.first) {
-				WriteOne(query, yc);
+			for (size_t i = 0; i < item.first.size(); ++i) {
+				WriteOne(item.first[i], yc, i + 1u == item.first.size());
 			}
 		} catch (const boost::coroutines::detail::forced_unwind&) {
 			throw;
@@ -691,17 +692,18 @@ RedisConnection::Reply RedisConnection::ReadOne(boost::asio::yield_context& yc)
  * Send query
  *
  * @param query Redis query
+ * @param flush Whether to flush the connection, i.e. whether this isn't followed by further queries
  */
-void RedisConnection::WriteOne(RedisConnection::Query& query, asio::yield_context& yc)
+void RedisConnection::WriteOne(RedisConnection::Query& query, asio::yield_context& yc, bool flush)
 {
 	if (m_Path.IsEmpty()) {
 		if (m_TLSContext) {
-			WriteOne(m_TlsConn, query, yc);
+			WriteOne(m_TlsConn, query, yc, flush);
 		} else {
-			WriteOne(m_TcpConn, query, yc);
+			WriteOne(m_TcpConn, query, yc, flush);
 		}
 	} else {
-		WriteOne(m_UnixConn, query, yc);
+		WriteOne(m_UnixConn, query, yc, flush);
 	}
 }
 
@@ -206,13 +206,13 @@ namespace icinga
 		void LogStats(boost::asio::yield_context& yc);
 		void WriteItem(boost::asio::yield_context& yc, WriteQueueItem item);
 		Reply ReadOne(boost::asio::yield_context& yc);
-		void WriteOne(Query& query, boost::asio::yield_context& yc);
+		void WriteOne(Query& query, boost::asio::yield_context& yc, bool flush = true);
 
 		template<class StreamPtr>
 		Reply ReadOne(StreamPtr& stream, boost::asio::yield_context& yc);
 
 		template<class StreamPtr>
-		void WriteOne(StreamPtr& stream, Query& query, boost::asio::yield_context& yc);
+		void WriteOne(StreamPtr& stream, Query& query, boost::asio::yield_context& yc, bool flush);
 
 		void IncreasePendingQueries(int count);
 		void DecreasePendingQueries(int count);
@@ -411,9 +411,10 @@ RedisConnection::Reply RedisConnection::ReadOne(StreamPtr& stream, boost::asio::
  *
  * @param stream Redis server connection
  * @param query Redis query
+ * @param flush Whether to flush the stream, i.e. whether this isn't followed by further queries
  */
 template<class StreamPtr>
-void RedisConnection::WriteOne(StreamPtr& stream, RedisConnection::Query& query, boost::asio::yield_context& yc)
+void RedisConnection::WriteOne(StreamPtr& stream, RedisConnection::Query& query, boost::asio::yield_context& yc, bool flush)
 {
 	namespace asio = boost::asio;
 
@@ -425,7 +426,10 @@ void RedisConnection::WriteOne(StreamPtr& stream, RedisConnection::Query& query,
 
 	try {
 		WriteRESP(*strm, query, yc);
-		strm->async_flush(yc);
+
+		if (flush) {
+			strm->async_flush(yc);
+		}
 	} catch (const boost::coroutines::detail::forced_unwind&) {
 		throw;
 	} catch (...) {
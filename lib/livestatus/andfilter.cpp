@@ -13,3 +13,13 @@ bool AndFilter::Apply(const Table::Ptr& table, const Value& row)
 
 	return true;
 }
+
+bool AndFilter::GetRequiredOperand(const Table::Ptr& table, const String& column, const String& op, String *operand) const
+{
+	for (const Filter::Ptr& filter : m_Filters) {
+		if (filter->GetRequiredOperand(table, column, op, operand))
+			return true;
+	}
+
+	return false;
+}
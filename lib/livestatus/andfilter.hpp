@@ -19,6 +19,7 @@ public:
 	DECLARE_PTR_TYPEDEFS(AndFilter);
 
 	bool Apply(const Table::Ptr& table, const Value& row) override;
+	bool GetRequiredOperand(const Table::Ptr& table, const String& column, const String& op, String *operand) const override;
 };
 
 }
@@ -14,11 +14,52 @@ AttributeFilter::AttributeFilter(String column, String op, String operand)
 	: m_Column(std::move(column)), m_Operator(std::move(op)), m_Operand(std::move(operand))
 { }
 
+double AttributeFilter::GetNumericOperand()
+{
+	if (!m_HasNumericOperand) {
+		m_NumericOperand = Convert::ToDouble(m_Operand);
+		m_HasNumericOperand = true;
+	}
+
+	return m_NumericOperand;
+}
+
+const boost::regex *AttributeFilter::GetRegex(const Value& value)
+{
+	if (!m_Regex && !m_RegexInvalid) {
+		try {
+			m_Regex.reset(new boost::regex(m_Operand.GetData(), m_Operator == "~~" ? boost::regex::icase : boost::regex::normal));
+		} catch (boost::exception&) {
+			Log(LogWarning, "AttributeFilter")
+				<< "Regex '" << m_Operand << " " << m_Operator << " " << value << "' error.";
+			m_RegexInvalid = true;
+		}
+	}
+
+	return m_Regex.get();
+}
+
+/**
+ * Avoids copying string values for comparisons.
+ */
+static const String& GetStringValue(const Value& value, String& buffer)
+{
+	if (value.IsString())
+		return value.Get<String>();
+
+	buffer = value;
+	return buffer;
+}
+
 bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
 {
-	Column column = table->GetColumn(m_Column);
+	if (table != m_Table) {
+		m_ColumnAccessor.reset(new Column(table->GetColumn(m_Column)));
+		m_Table = table;
+	}
 
-	Value value = column.ExtractValue(row);
+	Value value = m_ColumnAccessor->ExtractValue(row);
+	String buffer;
 
 	if (value.IsObjectType<Array>()) {
 		Array::Ptr array = value;
@@ -27,8 +68,8 @@ bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
 			bool negate = (m_Operator == "<");
 
 			ObjectLock olock(array);
-			for (const String& item : array) {
-				if (item == m_Operand)
+			for (const Value& item : array) {
+				if (GetStringValue(item, buffer) == m_Operand)
 					return !negate; /* Item found in list. */
 			}
 
@@ -41,21 +82,17 @@ bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
 	} else {
 		if (m_Operator == "=") {
 			if (value.GetType() == ValueNumber || value.GetType() == ValueBoolean)
-				return (static_cast<double>(value) == Convert::ToDouble(m_Operand));
+				return (static_cast<double>(value) == GetNumericOperand());
 			else
-				return (static_cast<String>(value) == m_Operand);
-		} else if (m_Operator == "~") {
-			bool ret;
-			try {
-				boost::regex expr(m_Operand.GetData());
-				String operand = value;
-				boost::smatch what;
-				ret = boost::regex_search(operand.GetData(), what, expr);
-			} catch (boost::exception&) {
-				Log(LogWarning, "AttributeFilter")
-					<< "Regex '" << m_Operand << " " << m_Operator << " " << value << "' error.";
-				ret = false;
-			}
+				return (GetStringValue(value, buffer) == m_Operand);
+		} else if (m_Operator == "~" || m_Operator == "~~") {
+			const boost::regex *expr = GetRegex(value);
+
+			if (!expr)
+				return false;
+
+			boost::smatch what;
+			bool ret = boost::regex_search(GetStringValue(value, buffer).GetData(), what, *expr);
 
 			//Log(LogDebug, "LivestatusListener/AttributeFilter")
 			//    << "Attribute filter '" << m_Operand + " " << m_Operator << " "
@@ -65,53 +102,34 @@ bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
 		} else if (m_Operator == "=~") {
 			bool ret;
 			try {
-				String operand = value;
-				ret = boost::iequals(operand, m_Operand.GetData());
+				ret = boost::iequals(GetStringValue(value, buffer).GetData(), m_Operand.GetData());
 			} catch (boost::exception&) {
 				Log(LogWarning, "AttributeFilter")
 					<< "Case-insensitive equality '" << m_Operand << " " << m_Operator << " " << value << "' error.";
 				ret = false;
 			}
 
-			return ret;
-		} else if (m_Operator == "~~") {
-			bool ret;
-			try {
-				boost::regex expr(m_Operand.GetData(), boost::regex::icase);
-				String operand = value;
-				boost::smatch what;
-				ret = boost::regex_search(operand.GetData(), what, expr);
-			} catch (boost::exception&) {
-				Log(LogWarning, "AttributeFilter")
-					<< "Regex '" << m_Operand << " " << m_Operator << " " << value << "' error.";
-				ret = false;
-			}
-
-			//Log(LogDebug, "LivestatusListener/AttributeFilter")
-			//    << "Attribute filter '" << m_Operand << " " << m_Operator << " "
-			//    << value << "' " << (ret ? "matches" : "doesn't match") << ".";
-
 			return ret;
 		} else if (m_Operator == "<") {
 			if (value.GetType() == ValueNumber)
-				return (static_cast<double>(value) < Convert::ToDouble(m_Operand));
+				return (static_cast<double>(value) < GetNumericOperand());
 			else
-				return (static_cast<String>(value) < m_Operand);
+				return (GetStringValue(value, buffer) < m_Operand);
 		} else if (m_Operator == ">") {
 			if (value.GetType() == ValueNumber)
-				return (static_cast<double>(value) > Convert::ToDouble(m_Operand));
+				return (static_cast<double>(value) > GetNumericOperand());
 			else
-				return (static_cast<String>(value) > m_Operand);
+				return (GetStringValue(value, buffer) > m_Operand);
 		} else if (m_Operator == "<=") {
 			if (value.GetType() == ValueNumber)
-				return (static_cast<double>(value) <= Convert::ToDouble(m_Operand));
+				return (static_cast<double>(value) <= GetNumericOperand());
 			else
-				return (static_cast<String>(value) <= m_Operand);
+				return (GetStringValue(value, buffer) <= m_Operand);
 		} else if (m_Operator == ">=") {
 			if (value.GetType() == ValueNumber)
-				return (static_cast<double>(value) >= Convert::ToDouble(m_Operand));
+				return (static_cast<double>(value) >= GetNumericOperand());
 			else
-				return (static_cast<String>(value) >= m_Operand);
+				return (GetStringValue(value, buffer) >= m_Operand);
 		} else {
 			BOOST_THROW_EXCEPTION(std::invalid_argument("Unknown operator for column '" + m_Column + "': " + m_Operator));
 		}
@@ -119,3 +137,22 @@ bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
 
 	return false;
 }
+
+bool AttributeFilter::GetRequiredOperand(const Table::Ptr& table, const String& column, const String& op, String *operand) const
+{
+	if (m_Operator != op)
+		return false;
+
+	/* same as Table::GetColumn() */
+	String name = m_Column;
+	String prefix = table->GetPrefix() + "_";
+
+	if (name.Find(prefix) == 0)
+		name = name.SubStr(prefix.GetLength());
+
+	if (name != column)
+		return false;
+
+	*operand = m_Operand;
+	return true;
+}
@@ -4,6 +4,8 @@
 #define ATTRIBUTEFILTER_H
 
 #include "livestatus/filter.hpp"
+#include <boost/regex.hpp>
+#include <memory>
 
 using namespace icinga;
 
@@ -21,11 +23,24 @@ public:
 	AttributeFilter(String column, String op, String operand);
 
 	bool Apply(const Table::Ptr& table, const Value& row) override;
+	bool GetRequiredOperand(const Table::Ptr& table, const String& column, const String& op, String *operand) const override;
 
 protected:
 	String m_Column;
 	String m_Operator;
 	String m_Operand;
+
+private:
+	/* Everything which doesn't depend on the row is only determined once. */
+	Table::Ptr m_Table;
+	std::unique_ptr<Column> m_ColumnAccessor;
+	bool m_HasNumericOperand{false};
+	double m_NumericOperand{0};
+	std::unique_ptr<boost::regex> m_Regex;
+	bool m_RegexInvalid{false};
+
+	double GetNumericOperand();
+	const boost::regex *GetRegex(const Value& value);
 };
 
 }
@@ -19,6 +19,22 @@ public:
 
 	virtual bool Apply(const Table::Ptr& table, const Value& row) = 0;
 
+	/**
+	 * Checks whether the filter only matches rows for which the column's value
+	 * is compared with the specified operator and operand, e.g. 'host_name = foo'.
+	 * Tables can use this to only fetch a subset of their rows.
+	 *
+	 * @param table The table
+	 * @param column The column's name
+	 * @param op The operator
+	 * @param operand Receives the operand
+	 * @return Whether there is such a condition
+	 */
+	virtual bool GetRequiredOperand(const Table::Ptr& table, const String& column, const String& op, String *operand) const
+	{
+		return false;
+	}
+
 protected:
 	Filter() = default;
 };
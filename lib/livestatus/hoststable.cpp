@@ -186,6 +186,32 @@ void HostsTable::FetchRows(const AddRowFunction& addRowFn)
 	}
 }
 
+void HostsTable::FetchMatchingRows(const AddRowFunction& addRowFn, const Filter::Ptr& filter)
+{
+	String operand;
+
+	if (!filter || GetGroupByType() != LivestatusGroupByNone) {
+		FetchRows(addRowFn);
+	} else if (filter->GetRequiredOperand(this, "name", "=", &operand)) {
+		Host::Ptr host = Host::GetByName(operand);
+
+		if (host)
+			addRowFn(host, LivestatusGroupByNone, Empty);
+	} else if (filter->GetRequiredOperand(this, "groups", ">=", &operand)) {
+		HostGroup::Ptr hg = HostGroup::GetByName(operand);
+
+		if (!hg)
+			return;
+
+		for (const Host::Ptr& host : hg->GetMembers()) {
+			if (!addRowFn(host, LivestatusGroupByNone, Empty))
+				return;
+		}
+	} else {
+		FetchRows(addRowFn);
+	}
+}
+
 Object::Ptr HostsTable::HostGroupAccessor(const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject)
 {
 	/* return the current group by value set from within FetchRows()
@@ -8,13 +8,20 @@
 #include "base/configtype.hpp"
 #include "base/logger.hpp"
 #include "base/exception.hpp"
-#include "base/tcpsocket.hpp"
-#include "base/unixsocket.hpp"
-#include "base/networkstream.hpp"
+#include "base/defer.hpp"
+#include "base/fifo.hpp"
 #include "base/application.hpp"
 #include "base/function.hpp"
 #include "base/statsfunction.hpp"
 #include "base/convert.hpp"
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/asio/buffers_iterator.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
+#include <climits>
+#include <istream>
 
 using namespace icinga;
 
@@ -46,36 +53,75 @@ void LivestatusListener::StatsFunc(const Dictionary::Ptr& status, const Array::P
  */
 void LivestatusListener::Start(bool runtimeCreated)
 {
+	namespace asio = boost::asio;
+	using asio::ip::tcp;
+
 	ObjectImpl<LivestatusListener>::Start(runtimeCreated);
 
 	Log(LogInformation, "LivestatusListener")
 		<< "'" << GetName() << "' started.";
 
+	auto& io (IoEngine::Get().GetIoContext());
+
+	m_ListenerStrand = Shared<asio::io_context::strand>::Make(io);
+
 	if (GetSocketType() == "tcp") {
-		TcpSocket::Ptr socket = new TcpSocket();
+		auto acceptor (Shared<tcp::acceptor>::Make(io));
 
 		try {
-			socket->Bind(GetBindHost(), GetBindPort(), AF_UNSPEC);
-		} catch (std::exception&) {
+			tcp::resolver resolver (io);
+			tcp::resolver::query query (GetBindHost(), GetBindPort(), tcp::resolver::query::passive);
+
+			auto result (resolver.resolve(query));
+			auto current (result.begin());
+
+			for (;;) {
+				try {
+					acceptor->open(current->endpoint().protocol());
+					acceptor->set_option(tcp::acceptor::reuse_address(true));
+					acceptor->bind(current->endpoint());
+
+					break;
+				} catch (const std::exception&) {
+					if (++current == result.end()) {
+						throw;
+					}
+
+					if (acceptor->is_open()) {
+						acceptor->close();
+					}
+				}
+			}
+
+			acceptor->listen(INT_MAX);
+		} catch (const std::exception&) {
 			Log(LogCritical, "LivestatusListener")
 				<< "Cannot bind TCP socket on host '" << GetBindHost() << "' port '" << GetBindPort() << "'.";
 			return;
 		}
 
-		m_Listener = socket;
+		m_TcpListener = acceptor;
 
-		m_Thread = std::thread([this]() { ServerThreadProc(); });
+		IoEngine::SpawnCoroutine(*m_ListenerStrand, [this, acceptor](asio::yield_context yc) {
+			ListenerCoroutineProc<tcp::acceptor>(yc, acceptor);
+		});
 
 		Log(LogInformation, "LivestatusListener")
 			<< "Created TCP socket listening on host '" << GetBindHost() << "' port '" << GetBindPort() << "'.";
 	}
 	else if (GetSocketType() == "unix") {
 #ifndef _WIN32
-		UnixSocket::Ptr socket = new UnixSocket();
+		using asio::local::stream_protocol;
+
+		auto acceptor (Shared<stream_protocol::acceptor>::Make(io));
 
 		try {
-			socket->Bind(GetSocketPath());
-		} catch (std::exception&) {
+			unlink(GetSocketPath().CStr());
+
+			acceptor->open();
+			acceptor->bind(stream_protocol::endpoint(GetSocketPath().GetData()));
+			acceptor->listen(SOMAXCONN);
+		} catch (const std::exception&) {
 			Log(LogCritical, "LivestatusListener")
 				<< "Cannot bind UNIX socket to '" << GetSocketPath() << "'.";
 			return;
@@ -90,9 +136,11 @@ void LivestatusListener::Start(bool runtimeCreated)
 			return;
 		}
 
-		m_Listener = socket;
+		m_UnixListener = acceptor;
 
-		m_Thread = std::thread([this]() { ServerThreadProc(); });
+		IoEngine::SpawnCoroutine(*m_ListenerStrand, [this, acceptor](asio::yield_context yc) {
+			ListenerCoroutineProc<stream_protocol::acceptor>(yc, acceptor);
+		});
 
 		Log(LogInformation, "LivestatusListener")
 			<< "Created UNIX socket in '" << GetSocketPath() << "'.";
@@ -111,10 +159,21 @@ void LivestatusListener::Stop(bool runtimeRemoved)
 	Log(LogInformation, "LivestatusListener")
 		<< "'" << GetName() << "' stopped.";
 
-	m_Listener->Close();
+	if (!m_ListenerStrand)
+		return;
+
+	/* The acceptors may only be used from within the listener's strand. */
+	boost::asio::post(*m_ListenerStrand, [this, keepAlive = LivestatusListener::Ptr(this)]() {
+		boost::system::error_code ec;
 
-	if (m_Thread.joinable())
-		m_Thread.join();
+		if (m_TcpListener)
+			m_TcpListener->close(ec);
+
+#ifndef _WIN32
+		if (m_UnixListener)
+			m_UnixListener->close(ec);
+#endif /* _WIN32 */
+	});
 }
 
 int LivestatusListener::GetClientsConnected()
@@ -131,76 +190,129 @@ int LivestatusListener::GetConnections()
 	return l_Connections;
 }
 
-void LivestatusListener::ServerThreadProc()
+template<class Acceptor>
+void LivestatusListener::ListenerCoroutineProc(boost::asio::yield_context yc, const typename Shared<Acceptor>::Ptr& server)
 {
-	m_Listener->Listen();
+	namespace asio = boost::asio;
+	typedef typename Acceptor::protocol_type::socket Socket;
 
-	try {
-		for (;;) {
-			timeval tv = { 0, 500000 };
+	auto& io (IoEngine::Get().GetIoContext());
 
-			if (m_Listener->Poll(true, false, &tv)) {
-				Socket::Ptr client = m_Listener->Accept();
-				Log(LogNotice, "LivestatusListener", "Client connected");
-				Utility::QueueAsyncCallback([this, client]() { ClientHandler(client); }, LowLatencyScheduler);
-			}
+	/* Stop() closes the acceptor. */
+	while (server->is_open()) {
+		try {
+			auto client (Shared<Socket>::Make(io));
+
+			server->async_accept(*client, yc);
 
-			if (!IsActive())
+			Log(LogNotice, "LivestatusListener", "Client connected");
+
+			auto strand (Shared<asio::io_context::strand>::Make(io));
+
+			IoEngine::SpawnCoroutine(*strand, [this, keepAlive = LivestatusListener::Ptr(this), strand, client](asio::yield_context yc) {
+				ClientHandler<Socket>(yc, client);
+			});
+		} catch (const std::exception& ex) {
+			if (!server->is_open())
 				break;
+
+			Log(LogCritical, "LivestatusListener")
+				<< "Cannot accept new connection: " << ex.what();
 		}
-	} catch (std::exception&) {
-		Log(LogCritical, "LivestatusListener", "Cannot accept new connection.");
 	}
-
-	m_Listener->Close();
 }
 
-void LivestatusListener::ClientHandler(const Socket::Ptr& client)
+/**
+ * Handles the queries of a client connection.
+ *
+ * Waiting for queries doesn't occupy any threads, only the execution of each query
+ * does (as CPU-bound work), so queries of different connections run concurrently.
+ */
+template<class Socket>
+void LivestatusListener::ClientHandler(boost::asio::yield_context yc, const typename Shared<Socket>::Ptr& client)
 {
+	namespace asio = boost::asio;
+
 	{
 		std::unique_lock<std::mutex> lock(l_ComponentMutex);
 		l_ClientsConnected++;
 		l_Connections++;
 	}
 
-	Stream::Ptr stream = new NetworkStream(client);
+	Defer disconnected ([]() {
+		std::unique_lock<std::mutex> lock(l_ComponentMutex);
+		l_ClientsConnected--;
+	});
 
-	StreamReadContext context;
+	try {
+		asio::streambuf buf;
+		bool eof = false;
 
-	for (;;) {
-		String line;
+		while (!eof) {
+			std::vector<String> lines;
 
-		std::vector<String> lines;
+			for (;;) {
+				boost::system::error_code ec;
 
-		for (;;) {
-			StreamReadStatus srs = stream->ReadLine(&line, context);
+				asio::async_read_until(*client, buf, '\n', yc[ec]);
 
-			if (srs == StatusEof)
-				break;
+				std::string line;
+
+				if (ec) {
+					if (ec != asio::error::eof)
+						throw boost::system::system_error(ec);
+
+					eof = true;
+
+					/* an incomplete last line */
+					line.assign(asio::buffers_begin(buf.data()), asio::buffers_end(buf.data()));
+				} else {
+					std::istream is (&buf);
+					std::getline(is, line);
+				}
 
-			if (srs != StatusNewItem)
-				continue;
+				/* Clients may terminate lines with CRLF. */
+				boost::algorithm::trim_right(line);
 
-			if (line.GetLength() > 0)
-				lines.push_back(line);
-			else
+				if (line.empty())
+					break;
+
+				lines.emplace_back(std::move(line));
+
+				if (eof)
+					break;
+			}
+
+			if (lines.empty())
 				break;
-		}
 
-		if (lines.empty())
-			break;
+			FIFO::Ptr response = new FIFO();
+			bool keepAlive;
 
-		LivestatusQuery::Ptr query = new LivestatusQuery(lines, GetCompatLogPath());
-		if (!query->Execute(stream))
-			break;
-	}
+			{
+				CpuBoundWork executingQuery (yc);
 
-	{
-		std::unique_lock<std::mutex> lock(l_ComponentMutex);
-		l_ClientsConnected--;
+				LivestatusQuery::Ptr query = new LivestatusQuery(lines, GetCompatLogPath());
+				keepAlive = query->Execute(response);
+			}
+
+			std::string data (response->GetAvailableBytes(), '\0');
+			response->Read(&data[0], data.size(), true);
+
+			asio::async_write(*client, asio::buffer(data), yc);
+
+			if (!keepAlive)
+				break;
+		}
+	} catch (const std::exception& ex) {
+		Log(LogNotice, "LivestatusListener")
+			<< "Error while processing Livestatus connection: " << ex.what();
 	}
-}
 
+	boost::system::error_code ec;
+	client->shutdown(Socket::shutdown_both, ec);
+	client->close(ec);
+}
 
 void LivestatusListener::ValidateSocketType(const Lazy<String>& lvalue, const ValidationUtils& utils)
 {
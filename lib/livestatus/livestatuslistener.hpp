@@ -6,8 +6,15 @@
 #include "livestatus/i2-livestatus.hpp"
 #include "livestatus/livestatuslistener-ti.hpp"
 #include "livestatus/livestatusquery.hpp"
-#include "base/socket.hpp"
-#include <thread>
+#include "base/io-engine.hpp"
+#include "base/shared.hpp"
+#include <boost/asio/io_context_strand.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/spawn.hpp>
+
+#ifndef _WIN32
+#	include <boost/asio/local/stream_protocol.hpp>
+#endif /* _WIN32 */
 
 using namespace icinga;
 
@@ -35,11 +42,18 @@ protected:
 	void Stop(bool runtimeRemoved) override;
 
 private:
-	void ServerThreadProc();
-	void ClientHandler(const Socket::Ptr& client);
+	template<class Acceptor>
+	void ListenerCoroutineProc(boost::asio::yield_context yc, const typename Shared<Acceptor>::Ptr& server);
+
+	template<class Socket>
+	void ClientHandler(boost::asio::yield_context yc, const typename Shared<Socket>::Ptr& client);
+
+	Shared<boost::asio::io_context::strand>::Ptr m_ListenerStrand;
+	Shared<boost::asio::ip::tcp::acceptor>::Ptr m_TcpListener;
 
-	Socket::Ptr m_Listener;
-	std::thread m_Thread;
+#ifndef _WIN32
+	Shared<boost::asio::local::stream_protocol::acceptor>::Ptr m_UnixListener;
+#endif /* _WIN32 */
 };
 
 }
@@ -0,0 +1,433 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "livestatus/livestatuslogindex.hpp"
+#include "livestatus/livestatuslogutility.hpp"
+#include "base/atomic-file.hpp"
+#include "base/configuration.hpp"
+#include "base/convert.hpp"
+#include "base/exception.hpp"
+#include "base/logger.hpp"
+#include "base/tlsutility.hpp"
+#include "base/utility.hpp"
+#include <boost/filesystem/operations.hpp>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+using namespace icinga;
+
+std::mutex LivestatusLogIndex::m_IndexesMutex;
+std::map<String, LivestatusLogIndex::Ptr> LivestatusLogIndex::m_Indexes;
+
+/* Bump this whenever the on-disk format changes. */
+static const char * const l_LogIndexHeader = "icinga2-livestatus-log-index-v1";
+
+LivestatusLogIndex::LivestatusLogIndex(String path, bool persistent)
+	: m_Path(std::move(path)), m_Persistent(persistent)
+{ }
+
+/**
+ * Returns the up-to-date index of a log file.
+ *
+ * @param path The log file's path
+ * @param persistent Whether the log file is archived, i.e. its index may be stored on disk
+ */
+LivestatusLogIndex::Ptr LivestatusLogIndex::GetByPath(const String& path, bool persistent)
+{
+	LivestatusLogIndex::Ptr index;
+
+	{
+		std::unique_lock<std::mutex> lock (m_IndexesMutex);
+
+		auto it (m_Indexes.find(path));
+
+		if (it == m_Indexes.end())
+			it = m_Indexes.emplace(path, new LivestatusLogIndex(path, persistent)).first;
+
+		index = it->second;
+	}
+
+	index->Update();
+
+	return index;
+}
+
+/**
+ * Drops the indexes of log files which don't exist anymore, e.g. because old
+ * archives have been deleted, including the copies stored on disk.
+ */
+void LivestatusLogIndex::RemoveMissing()
+{
+	std::vector<LivestatusLogIndex::Ptr> removed;
+
+	{
+		std::unique_lock<std::mutex> lock (m_IndexesMutex);
+
+		for (auto it (m_Indexes.begin()); it != m_Indexes.end();) {
+			if (Utility::PathExists(it->first)) {
+				++it;
+			} else {
+				removed.emplace_back(std::move(it->second));
+				it = m_Indexes.erase(it);
+			}
+		}
+	}
+
+	for (const LivestatusLogIndex::Ptr& index : removed) {
+		Log(LogDebug, "LivestatusLogIndex")
+			<< "Removing index of deleted log file '" << index->m_Path << "'.";
+
+		if (index->m_Persistent) {
+			String indexPath = index->GetIndexPath();
+			boost::system::error_code ec;
+
+			boost::filesystem::remove(boost::filesystem::path(indexPath.Begin(), indexPath.End()), ec);
+		}
+	}
+}
+
+size_t LivestatusLogIndex::GetLineCount() const
+{
+	std::shared_lock<std::shared_timed_mutex> lock (m_Mutex);
+
+	return m_Lines.size();
+}
+
+time_t LivestatusLogIndex::GetStartTime() const
+{
+	std::shared_lock<std::shared_timed_mutex> lock (m_Mutex);
+
+	return m_Lines.empty() ? 0 : m_Lines.front().Time;
+}
+
+time_t LivestatusLogIndex::GetEndTime() const
+{
+	std::shared_lock<std::shared_timed_mutex> lock (m_Mutex);
+
+	return m_Lines.empty() ? 0 : m_Lines.back().MaxTime;
+}
+
+/**
+ * Finds the first line which might have been logged at or after the specified time.
+ * All lines before it are older.
+ *
+ * @param time The timestamp
+ * @return The line number, GetLineCount() if there are no such lines
+ */
+size_t LivestatusLogIndex::FindLine(time_t time) const
+{
+	std::shared_lock<std::shared_timed_mutex> lock (m_Mutex);
+
+	auto it (std::lower_bound(m_Lines.begin(), m_Lines.end(), time, [](const Line& line, time_t time) {
+		return line.MaxTime < time;
+	}));
+
+	return it - m_Lines.begin();
+}
+
+/**
+ * Returns the numbers of the lines which refer to a host or a service.
+ *
+ * @param hostName The host's name
+ * @param serviceDescription The service's name, empty for the host and all of its services
+ */
+std::vector<size_t> LivestatusLogIndex::GetLinesByObject(const String& hostName, const String& serviceDescription) const
+{
+	String key = hostName;
+
+	if (!serviceDescription.IsEmpty())
+		key += "!" + serviceDescription;
+
+	std::shared_lock<std::shared_timed_mutex> lock (m_Mutex);
+
+	auto it (m_ObjectLines.find(key));
+
+	if (it == m_ObjectLines.end())
+		return std::vector<size_t>();
+
+	return it->second;
+}
+
+/**
+ * Reads the lines [begin, end) from the log file.
+ */
+void LivestatusLogIndex::ReadLines(size_t begin, size_t end, const LineCallback& callback) const
+{
+	std::vector<size_t> linenos;
+
+	{
+		std::shared_lock<std::shared_timed_mutex> lock (m_Mutex);
+
+		end = std::min(end, m_Lines.size());
+
+		for (size_t lineno = begin; lineno < end; lineno++)
+			linenos.push_back(lineno);
+	}
+
+	ReadLines(linenos, callback);
+}
+
+/**
+ * Reads the specified lines from the log file.
+ *
+ * @param linenos The line numbers in ascending order
+ * @param callback Called for each line
+ */
+void LivestatusLogIndex::ReadLines(const std::vector<size_t>& linenos, const LineCallback& callback) const
+{
+	if (linenos.empty())
+		return;
+
+	std::shared_lock<std::shared_timed_mutex> lock (m_Mutex);
+
+	std::ifstream fp;
+	fp.exceptions(std::ifstream::badbit);
+	fp.open(m_Path.CStr(), std::ifstream::in);
+
+	if (!fp)
+		return;
+
+	/* Only seek if there are lines in between, seeking discards the stream's buffer. */
+	uint64_t position = 0;
+
+	for (size_t lineno : linenos) {
+		if (lineno >= m_Lines.size())
+			break;
+
+		uint64_t offset = m_Lines[lineno].Offset;
+
+		if (offset != position)
+			fp.seekg(offset);
+
+		std::string line;
+
+		if (!std::getline(fp, line))
+			break;
+
+		position = offset + line.size() + 1;
+
+		callback(lineno, line);
+	}
+}
+
+void LivestatusLogIndex::Update()
+{
+	namespace fs = boost::filesystem;
+
+	fs::path path (m_Path.Begin(), m_Path.End());
+	boost::system::error_code ec;
+
+	uint64_t size = fs::file_size(path, ec);
+	time_t modifiedTime = ec ? 0 : fs::last_write_time(path, ec);
+
+	std::unique_lock<std::shared_timed_mutex> lock (m_Mutex);
+
+	if (ec) {
+		Clear();
+		return;
+	}
+
+	if (size == m_FileSize && modifiedTime == m_ModifiedTime)
+		return;
+
+	if (m_Persistent && m_Lines.empty() && Load(size, modifiedTime))
+		return;
+
+	if (size < m_Size)
+		Clear();
+
+	std::ifstream fp;
+	fp.exceptions(std::ifstream::badbit);
+	fp.open(m_Path.CStr(), std::ifstream::in);
+
+	if (!fp) {
+		Clear();
+		return;
+	}
+
+	/* The log file has been truncated or replaced (e.g. after a rotation). */
+	if (!m_Lines.empty()) {
+		char buffer[12] = {};
+		fp.read(buffer, sizeof(buffer) - 1);
+
+		if (buffer[0] != '[' || atoi(buffer + 1) != m_Lines.front().Time)
+			Clear();
+
+		fp.clear();
+	}
+
+	size_t count = m_Lines.size();
+	uint64_t offset = m_Size;
+
+	fp.seekg(offset);
+
+	for (;;) {
+		std::string line;
+		std::getline(fp, line);
+
+		/* Incomplete lines are indexed once they've been written completely. */
+		if (fp.eof())
+			break;
+
+		uint64_t next = offset + line.size() + 1;
+
+		if (!line.empty()) {
+			try {
+				Dictionary::Ptr attrs = LivestatusLogUtility::GetAttributes(line);
+
+				AddLine(offset, Convert::ToLong(attrs->Get("time")), attrs->Get("host_name"), attrs->Get("service_description"));
+			} catch (const std::exception& ex) {
+				Log(LogDebug, "LivestatusLogIndex")
+					<< "Skipping invalid log line: '" << line << "': " << DiagnosticInformation(ex, false);
+			}
+		}
+
+		offset = next;
+	}
+
+	m_Size = offset;
+	m_FileSize = size;
+	m_ModifiedTime = modifiedTime;
+
+	Log(LogDebug, "LivestatusLogIndex")
+		<< "Indexed " << (m_Lines.size() - count) << " lines of log file '" << m_Path << "'.";
+
+	if (m_Persistent) {
+		try {
+			Save();
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "LivestatusLogIndex")
+				<< "Could not save index of log file '" << m_Path << "': " << DiagnosticInformation(ex, false);
+		}
+	}
+}
+
+void LivestatusLogIndex::Clear()
+{
+	m_Size = 0;
+	m_FileSize = 0;
+	m_ModifiedTime = 0;
+	m_Lines.clear();
+	m_ObjectLines.clear();
+}
+
+void LivestatusLogIndex::AddLine(uint64_t offset, time_t time, const String& hostName, const String& serviceDescription)
+{
+	size_t lineno = m_Lines.size();
+
+	m_Lines.push_back({ offset, time, m_Lines.empty() ? time : std::max(time, m_Lines.back().MaxTime) });
+
+	if (hostName.IsEmpty())
+		return;
+
+	m_ObjectLines[hostName].push_back(lineno);
+
+	if (!serviceDescription.IsEmpty())
+		m_ObjectLines[hostName + "!" + serviceDescription].push_back(lineno);
+}
+
+/**
+ * Loads the index from disk.
+ *
+ * The file contains a header, the offset and timestamp of each line
+ * and one line per host/service with the numbers of its log lines.
+ *
+ * @param size The log file's current size
+ * @param modifiedTime The log file's current modification time
+ * @return Whether the index was loaded
+ */
+bool LivestatusLogIndex::Load(uint64_t size, time_t modifiedTime)
+{
+	std::ifstream fp;
+	fp.open(GetIndexPath().CStr(), std::ifstream::in);
+
+	if (!fp)
+		return false;
+
+	std::string header;
+	uint64_t indexedSize, indexedFileSize;
+	time_t indexedModifiedTime;
+	size_t lineCount, objectCount;
+
+	if (!(fp >> header >> indexedFileSize >> indexedModifiedTime >> indexedSize >> lineCount >> objectCount)
+		|| header != l_LogIndexHeader || indexedFileSize != size || indexedModifiedTime != modifiedTime)
+		return false;
+
+	m_Lines.reserve(lineCount);
+
+	for (size_t i = 0; i < lineCount; i++) {
+		uint64_t offset;
+		time_t time;
+
+		if (!(fp >> offset >> time)) {
+			Clear();
+			return false;
+		}
+
+		m_Lines.push_back({ offset, time, m_Lines.empty() ? time : std::max(time, m_Lines.back().MaxTime) });
+	}
+
+	fp.ignore(1);
+
+	for (size_t i = 0; i < objectCount; i++) {
+		std::string key, linenos;
+
+		if (!std::getline(fp, key, '\t') || !std::getline(fp, linenos)) {
+			Clear();
+			return false;
+		}
+
+		std::vector<size_t>& lines = m_ObjectLines[key];
+		std::istringstream linenoStream (linenos);
+		size_t lineno;
+
+		while (linenoStream >> lineno)
+			lines.push_back(lineno);
+	}
+
+	m_Size = indexedSize;
+	m_FileSize = size;
+	m_ModifiedTime = modifiedTime;
+
+	Log(LogDebug, "LivestatusLogIndex")
+		<< "Loaded index of log file '" << m_Path << "' from '" << GetIndexPath() << "'.";
+
+	return true;
+}
+
+void LivestatusLogIndex::Save() const
+{
+	for (auto& kv : m_ObjectLines) {
+		/* Can't be stored in our format. */
+		if (kv.first.FindFirstOf("\t\n") != String::NPos)
+			return;
+	}
+
+	String indexPath = GetIndexPath();
+
+	Utility::MkDirP(Utility::DirName(indexPath), 0750);
+
+	AtomicFile fp (indexPath, 0640);
+
+	fp << l_LogIndexHeader << " " << m_FileSize << " " << m_ModifiedTime << " " << m_Size
+		<< " " << m_Lines.size() << " " << m_ObjectLines.size() << "\n";
+
+	for (const Line& line : m_Lines)
+		fp << line.Offset << " " << line.Time << "\n";
+
+	for (auto& kv : m_ObjectLines) {
+		fp << kv.first << "\t";
+
+		for (size_t lineno : kv.second)
+			fp << lineno << " ";
+
+		fp << "\n";
+	}
+
+	fp.Commit();
+}
+
+String LivestatusLogIndex::GetIndexPath() const
+{
+	return Configuration::DataDir + "/livestatus/log-index/" + SHA256(m_Path) + ".idx";
+}
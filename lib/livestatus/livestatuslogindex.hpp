@@ -0,0 +1,83 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef LIVESTATUSLOGINDEX_H
+#define LIVESTATUSLOGINDEX_H
+
+#include "livestatus/i2-livestatus.hpp"
+#include "base/object.hpp"
+#include "base/string.hpp"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * An index of the lines of a compat log file: their byte offsets and timestamps
+ * as well as the lines which belong to each host and service.
+ *
+ * Indexes of archived log files don't change anymore, so they are written to disk
+ * and only built once. The index of the current log file is extended with the
+ * lines which have been appended since it was last used.
+ *
+ * @ingroup livestatus
+ */
+class LivestatusLogIndex final : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(LivestatusLogIndex);
+
+	typedef std::function<void (size_t lineno, const String& line)> LineCallback;
+
+	static LivestatusLogIndex::Ptr GetByPath(const String& path, bool persistent);
+	static void RemoveMissing();
+
+	size_t GetLineCount() const;
+	time_t GetStartTime() const;
+	time_t GetEndTime() const;
+
+	size_t FindLine(time_t time) const;
+	std::vector<size_t> GetLinesByObject(const String& hostName, const String& serviceDescription = String()) const;
+
+	void ReadLines(size_t begin, size_t end, const LineCallback& callback) const;
+	void ReadLines(const std::vector<size_t>& linenos, const LineCallback& callback) const;
+
+private:
+	struct Line
+	{
+		uint64_t Offset;
+		time_t Time;
+		time_t MaxTime; /**< The greatest timestamp of this and all previous lines. */
+	};
+
+	String m_Path;
+	bool m_Persistent;
+
+	mutable std::shared_timed_mutex m_Mutex;
+	uint64_t m_Size{0}; /**< The number of bytes which have been indexed. */
+	uint64_t m_FileSize{0};
+	time_t m_ModifiedTime{0};
+	std::vector<Line> m_Lines;
+	std::unordered_map<String, std::vector<size_t> > m_ObjectLines;
+
+	static std::mutex m_IndexesMutex;
+	static std::map<String, LivestatusLogIndex::Ptr> m_Indexes;
+
+	LivestatusLogIndex(String path, bool persistent);
+
+	void Update();
+	void Clear();
+	void AddLine(uint64_t offset, time_t time, const String& hostName, const String& serviceDescription);
+	bool Load(uint64_t size, time_t modifiedTime);
+	void Save() const;
+	String GetIndexPath() const;
+};
+
+}
+
+#endif /* LIVESTATUSLOGINDEX_H */
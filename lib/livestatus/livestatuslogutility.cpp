@@ -1,6 +1,7 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "livestatus/livestatuslogutility.hpp"
+#include "livestatus/livestatuslogindex.hpp"
 #include "icinga/service.hpp"
 #include "icinga/host.hpp"
 #include "icinga/user.hpp"
@@ -13,7 +14,10 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/predicate.hpp>
+#include <algorithm>
+#include <cstdint>
 #include <fstream>
+#include <iterator>
 
 using namespace icinga;
 
@@ -21,6 +25,8 @@ void LivestatusLogUtility::CreateLogIndex(const String& path, std::map<time_t, S
 {
 	Utility::Glob(path + "/icinga.log", [&index](const String& newPath) { CreateLogIndexFileHandler(newPath, index); }, GlobFile);
 	Utility::Glob(path + "/archives/*.log", [&index](const String& newPath) { CreateLogIndexFileHandler(newPath, index); }, GlobFile);
+
+	LivestatusLogIndex::RemoveMissing();
 }
 
 void LivestatusLogUtility::CreateLogIndexFileHandler(const String& path, std::map<time_t, String>& index)
@@ -53,53 +59,94 @@ void LivestatusLogUtility::CreateLogIndexFileHandler(const String& path, std::ma
 	index[ts_start] = path;
 }
 
+/**
+ * Passes the log entries of the log files in the specified time range to the table.
+ *
+ * @param skipLinesOutOfRange Whether to also skip the individual lines which are not in the time range
+ * @param hostName Only pass the entries which refer to this host (and its services) if not empty
+ * @param serviceDescription Only pass the entries which refer to this service of the host if not empty
+ */
 void LivestatusLogUtility::CreateLogCache(std::map<time_t, String> index, HistoryTable *table,
-	time_t from, time_t until, const AddRowFunction& addRowFn)
+	time_t from, time_t until, const AddRowFunction& addRowFn, bool skipLinesOutOfRange,
+	const String& hostName, const String& serviceDescription)
 {
 	ASSERT(table);
 
 	/* m_LogFileIndex map tells which log files are involved ordered by their start timestamp */
 	unsigned long line_count = 0;
-	for (const auto& kv : index) {
-		unsigned int ts = kv.first;
+	for (auto it = index.begin(); it != index.end(); it++) {
+		time_t ts = it->first;
 
 		/* skip log files not in range (performance optimization) */
-		if (ts < from || ts > until)
+		if (ts > until)
 			continue;
 
-		String log_file = index[ts];
-		int lineno = 0;
+		if (ts < from) {
+			if (!skipLinesOutOfRange)
+				continue;
+
+			/* the log file might still contain lines which were logged after 'from' */
+			auto next = std::next(it);
 
-		std::ifstream fp;
-		fp.exceptions(std::ifstream::badbit);
-		fp.open(log_file.CStr(), std::ifstream::in);
+			if (next != index.end() && next->first <= from)
+				continue;
+		}
 
-		while (fp.good()) {
-			std::string line;
-			std::getline(fp, line);
+		const String& log_file = it->second;
 
-			if (line.empty())
-				continue; /* Ignore empty lines */
+		/* archived log files don't change anymore, so their index can be kept on disk */
+		bool archived = Utility::BaseName(Utility::DirName(log_file)) == "archives";
 
+		LivestatusLogIndex::Ptr logIndex = LivestatusLogIndex::GetByPath(log_file, archived);
+
+		size_t begin = skipLinesOutOfRange ? logIndex->FindLine(from) : 0;
+
+		auto addLine ([table, until, skipLinesOutOfRange, &line_count, &addRowFn](size_t lineno, const String& line) {
 			Dictionary::Ptr log_entry_attrs = LivestatusLogUtility::GetAttributes(line);
 
-			/* no attributes available - invalid log line */
-			if (!log_entry_attrs) {
-				Log(LogDebug, "LivestatusLogUtility")
-					<< "Skipping invalid log line: '" << line << "'.";
-				continue;
-			}
+			if (skipLinesOutOfRange && static_cast<time_t>(log_entry_attrs->Get("time")) > until)
+				return;
 
 			table->UpdateLogEntries(log_entry_attrs, line_count, lineno, addRowFn);
 
 			line_count++;
-			lineno++;
-		}
+		});
 
-		fp.close();
+		if (hostName.IsEmpty()) {
+			logIndex->ReadLines(begin, SIZE_MAX, addLine);
+		} else {
+			std::vector<size_t> linenos = logIndex->GetLinesByObject(hostName, serviceDescription);
+
+			linenos.erase(linenos.begin(), std::lower_bound(linenos.begin(), linenos.end(), begin));
+
+			logIndex->ReadLines(linenos, addLine);
+		}
 	}
 }
 
+/**
+ * Checks whether a history table's filter only matches log entries of a specific
+ * host or service, i.e. whether CreateLogCache() can skip all other log entries.
+ *
+ * @param table The table
+ * @param filter The table's filter
+ * @param hostName Receives the host's name
+ * @param serviceDescription Receives the service's name, empty for the host and all of its services
+ * @return Whether the filter requires a host
+ */
+bool LivestatusLogUtility::GetObjectFilter(const Table::Ptr& table, const Filter::Ptr& filter,
+	String *hostName, String *serviceDescription)
+{
+	/* Entries without a host would match 'host_name =' */
+	if (!filter || !filter->GetRequiredOperand(table, "host_name", "=", hostName) || hostName->IsEmpty())
+		return false;
+
+	if (!filter->GetRequiredOperand(table, "service_description", "=", serviceDescription))
+		*serviceDescription = String();
+
+	return true;
+}
+
 Dictionary::Ptr LivestatusLogUtility::GetAttributes(const String& text)
 {
 	Dictionary::Ptr bag = new Dictionary();
@@ -48,7 +48,9 @@ class LivestatusLogUtility
 public:
 	static void CreateLogIndex(const String& path, std::map<time_t, String>& index);
 	static void CreateLogIndexFileHandler(const String& path, std::map<time_t, String>& index);
-	static void CreateLogCache(std::map<time_t, String> index, HistoryTable *table, time_t from, time_t until, const AddRowFunction& addRowFn);
+	static void CreateLogCache(std::map<time_t, String> index, HistoryTable *table, time_t from, time_t until, const AddRowFunction& addRowFn,
+		bool skipLinesOutOfRange = false, const String& hostName = String(), const String& serviceDescription = String());
+	static bool GetObjectFilter(const Table::Ptr& table, const Filter::Ptr& filter, String *hostName, String *serviceDescription);
 	static Dictionary::Ptr GetAttributes(const String& text);
 
 private:
@@ -493,12 +493,17 @@ void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 	} else {
 		std::map<std::vector<Value>, std::vector<AggregatorState *> > allStats;
 
+		std::vector<Column> column_objs;
+		column_objs.reserve(m_Columns.size());
+
+		for (const String& columnName : m_Columns)
+			column_objs.emplace_back(table->GetColumn(columnName));
+
 		/* add aggregated stats */
 		for (const LivestatusRowValue& object : objects) {
 			std::vector<Value> statsKey;
 
-			for (const String& columnName : m_Columns) {
-				Column column = table->GetColumn(columnName);
+			for (const Column& column : column_objs) {
 				statsKey.emplace_back(column.ExtractValue(object.Row, object.GroupByType, object.GroupByObject));
 			}
 
@@ -80,6 +80,11 @@ String LogTable::GetPrefix() const
 }
 
 void LogTable::FetchRows(const AddRowFunction& addRowFn)
+{
+	FetchMatchingRows(addRowFn, nullptr);
+}
+
+void LogTable::FetchMatchingRows(const AddRowFunction& addRowFn, const Filter::Ptr& filter)
 {
 	Log(LogDebug, "LogTable")
 		<< "Pre-selecting log file from " << m_TimeFrom << " until " << m_TimeUntil;
@@ -87,8 +92,12 @@ void LogTable::FetchRows(const AddRowFunction& addRowFn)
 	/* create log file index */
 	LivestatusLogUtility::CreateLogIndex(m_CompatLogPath, m_LogFileIndex);
 
-	/* generate log cache */
-	LivestatusLogUtility::CreateLogCache(m_LogFileIndex, this, m_TimeFrom, m_TimeUntil, addRowFn);
+	/* only read the lines of the queried host/service */
+	String hostName, serviceDescription;
+	LivestatusLogUtility::GetObjectFilter(this, filter, &hostName, &serviceDescription);
+
+	/* generate log cache, rows outside of the time range would be filtered anyway */
+	LivestatusLogUtility::CreateLogCache(m_LogFileIndex, this, m_TimeFrom, m_TimeUntil, addRowFn, true, hostName, serviceDescription);
 }
 
 /* gets called in LivestatusLogUtility::CreateLogCache */
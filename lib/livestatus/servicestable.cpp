@@ -182,6 +182,37 @@ void ServicesTable::FetchRows(const AddRowFunction& addRowFn)
 	}
 }
 
+void ServicesTable::FetchMatchingRows(const AddRowFunction& addRowFn, const Filter::Ptr& filter)
+{
+	String operand;
+
+	if (!filter || GetGroupByType() != LivestatusGroupByNone) {
+		FetchRows(addRowFn);
+	} else if (filter->GetRequiredOperand(this, "host_name", "=", &operand)) {
+		Host::Ptr host = Host::GetByName(operand);
+
+		if (!host)
+			return;
+
+		for (const Service::Ptr& service : host->GetServices()) {
+			if (!addRowFn(service, LivestatusGroupByNone, Empty))
+				return;
+		}
+	} else if (filter->GetRequiredOperand(this, "groups", ">=", &operand)) {
+		ServiceGroup::Ptr sg = ServiceGroup::GetByName(operand);
+
+		if (!sg)
+			return;
+
+		for (const Service::Ptr& service : sg->GetMembers()) {
+			if (!addRowFn(service, LivestatusGroupByNone, Empty))
+				return;
+		}
+	} else {
+		FetchRows(addRowFn);
+	}
+}
+
 Object::Ptr ServicesTable::HostAccessor(const Value& row, const Column::ObjectAccessor& parentObjectAccessor)
 {
 	Value service;
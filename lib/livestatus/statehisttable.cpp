@@ -239,6 +239,11 @@ String StateHistTable::GetPrefix() const
 }
 
 void StateHistTable::FetchRows(const AddRowFunction& addRowFn)
+{
+	FetchMatchingRows(addRowFn, nullptr);
+}
+
+void StateHistTable::FetchMatchingRows(const AddRowFunction& addRowFn, const Filter::Ptr& filter)
 {
 	Log(LogDebug, "StateHistTable")
 		<< "Pre-selecting log file from " << m_TimeFrom << " until " << m_TimeUntil;
@@ -246,8 +251,12 @@ void StateHistTable::FetchRows(const AddRowFunction& addRowFn)
 	/* create log file index */
 	LivestatusLogUtility::CreateLogIndex(m_CompatLogPath, m_LogFileIndex);
 
+	/* the state history of an object only depends on its own log entries */
+	String hostName, serviceDescription;
+	LivestatusLogUtility::GetObjectFilter(this, filter, &hostName, &serviceDescription);
+
 	/* generate log cache */
-	LivestatusLogUtility::CreateLogCache(m_LogFileIndex, this, m_TimeFrom, m_TimeUntil, addRowFn);
+	LivestatusLogUtility::CreateLogCache(m_LogFileIndex, this, m_TimeFrom, m_TimeUntil, addRowFn, false, hostName, serviceDescription);
 
 	Checkable::Ptr checkable;
 
@@ -110,13 +110,23 @@ std::vector<LivestatusRowValue> Table::FilterRows(const Filter::Ptr& filter, int
 {
 	std::vector<LivestatusRowValue> rs;
 
-	FetchRows([this, filter, limit, &rs](const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject) {
+	FetchMatchingRows([this, filter, limit, &rs](const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject) {
 		return FilteredAddRow(rs, filter, limit, row, groupByType, groupByObject);
-	});
+	}, filter);
 
 	return rs;
 }
 
+/**
+ * Fetches the rows the filter might match. Tables can override this to skip
+ * rows based on Filter::GetRequiredOperand(), the filter is applied to all rows
+ * passed to addRowFn anyway.
+ */
+void Table::FetchMatchingRows(const AddRowFunction& addRowFn, const Filter::Ptr&)
+{
+	FetchRows(addRowFn);
+}
+
 bool Table::FilteredAddRow(std::vector<LivestatusRowValue>& rs, const Filter::Ptr& filter, int limit, const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject)
 {
 	if (limit != -1 && static_cast<int>(rs.size()) == limit)
@@ -50,6 +50,7 @@ protected:
 	Table(LivestatusGroupByType type = LivestatusGroupByNone);
 
 	virtual void FetchRows(const AddRowFunction& addRowFn) = 0;
+	virtual void FetchMatchingRows(const AddRowFunction& addRowFn, const intrusive_ptr<Filter>& filter);
 
 	static Value ZeroAccessor(const Value&);
 	static Value OneAccessor(const Value&);
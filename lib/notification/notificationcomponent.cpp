@@ -4,13 +4,16 @@
 #include "notification/notificationcomponent-ti.cpp"
 #include "icinga/service.hpp"
 #include "icinga/icingaapplication.hpp"
+#include "base/configuration.hpp"
 #include "base/configtype.hpp"
 #include "base/objectlock.hpp"
 #include "base/logger.hpp"
 #include "base/utility.hpp"
 #include "base/exception.hpp"
 #include "base/statsfunction.hpp"
+#include "base/workqueue.hpp"
 #include "remote/apilistener.hpp"
+#include <limits>
 
 using namespace icinga;
 
@@ -18,17 +21,60 @@ REGISTER_TYPE(NotificationComponent);
 
 REGISTER_STATSFUNCTION(NotificationComponent, &NotificationComponent::StatsFunc);
 
-void NotificationComponent::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
+/* Due notifications are processed in parallel if there are at least this many of them. */
+static const size_t l_NotificationParallelThreshold = 1000;
+
+void NotificationComponent::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	DictionaryData nodes;
 
 	for (const NotificationComponent::Ptr& notification_component : ConfigType::GetObjectsByType<NotificationComponent>()) {
-		nodes.emplace_back(notification_component->GetName(), 1); //add more stats
+		size_t scheduled, pending;
+
+		{
+			std::unique_lock<std::mutex> lock(notification_component->m_Mutex);
+			scheduled = notification_component->m_Notifications.size();
+			pending = notification_component->m_PendingNotifications.size();
+		}
+
+		nodes.emplace_back(notification_component->GetName(), new Dictionary({
+			{ "scheduled", scheduled },
+			{ "pending", pending }
+		}));
+
+		String perfdata_prefix = "notificationcomponent_" + notification_component->GetName() + "_";
+		perfdata->Add(new PerfdataValue(perfdata_prefix + "scheduled", Convert::ToDouble(scheduled)));
+		perfdata->Add(new PerfdataValue(perfdata_prefix + "pending", Convert::ToDouble(pending)));
 	}
 
 	status->Set("notificationcomponent", new Dictionary(std::move(nodes)));
 }
 
+void NotificationComponent::OnConfigLoaded()
+{
+	ConfigObject::OnActiveChanged.connect([this](const ConfigObject::Ptr& object, const Value&) {
+		ObjectHandler(object);
+	});
+
+	/* Notification::OnNextNotificationChanged is a different signal which isn't fired by SetNextNotification(). */
+	ObjectImpl<Notification>::OnNextNotificationChanged.connect([this](const Notification::Ptr& notification, const Value&) {
+		NextReminderChangedHandler(notification);
+	});
+	Notification::OnIntervalChanged.connect([this](const Notification::Ptr& notification, const Value&) {
+		NextReminderChangedHandler(notification);
+	});
+	Notification::OnNoMoreNotificationsChanged.connect([this](const Notification::Ptr& notification, const Value&) {
+		NextReminderChangedHandler(notification);
+	});
+
+	Notification::OnStashedNotificationsChanged.connect([this](const Notification::Ptr& notification, const Value&) {
+		PendingChangedHandler(notification);
+	});
+	Notification::OnSuppressedNotificationsChanged.connect([this](const Notification::Ptr& notification, const Value&) {
+		PendingChangedHandler(notification);
+	});
+}
+
 /**
  * Starts the component.
  */
@@ -123,9 +169,91 @@ void FireSuppressedNotifications(const Notification::Ptr& notification)
 	}
 }
 
+void NotificationComponent::ObjectHandler(const ConfigObject::Ptr& object)
+{
+	Notification::Ptr notification = dynamic_pointer_cast<Notification>(object);
+
+	if (!notification)
+		return;
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+
+	if (notification->IsActive()) {
+		m_Notifications.erase(notification);
+		m_Notifications.insert(GetNotificationScheduleInfo(notification));
+
+		if (HasPendingNotifications(notification))
+			m_PendingNotifications.insert(notification);
+	} else {
+		m_Notifications.erase(notification);
+		m_PendingNotifications.erase(notification);
+	}
+}
+
+/**
+ * Returns the time at which the notification may have to send a reminder.
+ */
+NotificationScheduleInfo NotificationComponent::GetNotificationScheduleInfo(const Notification::Ptr& notification)
+{
+	NotificationScheduleInfo nsi;
+	nsi.Object = notification;
+
+	if (notification->GetInterval() <= 0 && notification->GetNoMoreNotifications())
+		nsi.NextReminder = std::numeric_limits<double>::infinity();
+	else
+		nsi.NextReminder = notification->GetNextNotification();
+
+	return nsi;
+}
+
+/**
+ * Returns whether the notification has stashed or suppressed notifications
+ * which the timer has to (re-)try to send regardless of its reminder schedule.
+ */
+bool NotificationComponent::HasPendingNotifications(const Notification::Ptr& notification)
+{
+	if (notification->GetSuppressedNotifications())
+		return true;
+
+	auto stashedNotifications (notification->GetStashedNotifications());
+
+	return stashedNotifications && stashedNotifications->GetLength();
+}
+
+void NotificationComponent::NextReminderChangedHandler(const Notification::Ptr& notification)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+
+	/* remove and re-insert the object from the set in order to force an index update */
+	typedef boost::multi_index::nth_index<NotificationSet, 0>::type NotificationView;
+	NotificationView& idx = boost::get<0>(m_Notifications);
+
+	auto it = idx.find(notification);
+
+	if (it == idx.end())
+		return;
+
+	idx.erase(notification);
+	idx.insert(GetNotificationScheduleInfo(notification));
+}
+
+void NotificationComponent::PendingChangedHandler(const Notification::Ptr& notification)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+
+	if (!notification->IsActive())
+		return;
+
+	if (HasPendingNotifications(notification))
+		m_PendingNotifications.insert(notification);
+}
+
 /**
  * Periodically sends notifications.
  *
+ * Only notifications with a due reminder or with stashed/suppressed notifications are processed,
+ * all others wouldn't do anything anyway.
+ *
  * @param - Event arguments for the timer.
  */
 void NotificationComponent::NotificationTimerHandler()
@@ -135,129 +263,180 @@ void NotificationComponent::NotificationTimerHandler()
 	/* Function already checks whether 'api' feature is enabled. */
 	Endpoint::Ptr myEndpoint = Endpoint::GetLocalEndpoint();
 
-	for (const Notification::Ptr& notification : ConfigType::GetObjectsByType<Notification>()) {
-		if (!notification->IsActive())
-			continue;
+	std::vector<Notification::Ptr> notifications;
 
-		String notificationName = notification->GetName();
-		bool updatedObjectAuthority = ApiListener::UpdatedObjectAuthority();
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
 
-		/* Skip notification if paused, in a cluster setup & HA feature is enabled. */
-		if (notification->IsPaused()) {
-			if (updatedObjectAuthority) {
-				auto stashedNotifications (notification->GetStashedNotifications());
-				ObjectLock olock(stashedNotifications);
+		typedef boost::multi_index::nth_index<NotificationSet, 1>::type NotificationTimeView;
+		NotificationTimeView& idx = boost::get<1>(m_Notifications);
 
-				if (stashedNotifications->GetLength()) {
-					Log(LogNotice, "NotificationComponent")
-						<< "Notification '" << notificationName << "': HA cluster active, this endpoint does not have the authority. Dropping all stashed notifications.";
+		std::set<Notification::Ptr> pending (m_PendingNotifications);
 
-					stashedNotifications->Clear();
-				}
-			}
+		for (auto it = idx.begin(); it != idx.end() && it->NextReminder <= now; it++) {
+			if (pending.find(it->Object) == pending.end())
+				notifications.push_back(it->Object);
+		}
+
+		notifications.insert(notifications.end(), pending.begin(), pending.end());
+	}
+
+	if (notifications.size() < l_NotificationParallelThreshold) {
+		for (const Notification::Ptr& notification : notifications)
+			ProcessNotification(notification, now, myEndpoint);
+	} else {
+		WorkQueue upq(25000, Configuration::Concurrency);
+		upq.SetName("NotificationComponent");
+
+		upq.ParallelFor(notifications, [this, now, &myEndpoint](const Notification::Ptr& notification) {
+			ProcessNotification(notification, now, myEndpoint);
+		});
+
+		upq.Join();
 
-			if (myEndpoint && GetEnableHA()) {
+		if (upq.HasExceptions())
+			upq.ReportExceptions("NotificationComponent");
+	}
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+
+	/* Checked under the lock, so that a concurrent PendingChangedHandler() can't get lost. */
+	for (const Notification::Ptr& notification : notifications) {
+		if (!HasPendingNotifications(notification))
+			m_PendingNotifications.erase(notification);
+	}
+}
+
+/**
+ * Sends the stashed, suppressed and reminder notifications of a notification.
+ *
+ * @param notification The notification
+ * @param now The time the current timer run started at
+ * @param myEndpoint The local endpoint, if any
+ */
+void NotificationComponent::ProcessNotification(const Notification::Ptr& notification, double now, const Endpoint::Ptr& myEndpoint)
+{
+	if (!notification->IsActive())
+		return;
+
+	String notificationName = notification->GetName();
+	bool updatedObjectAuthority = ApiListener::UpdatedObjectAuthority();
+
+	/* Skip notification if paused, in a cluster setup & HA feature is enabled. */
+	if (notification->IsPaused()) {
+		if (updatedObjectAuthority) {
+			auto stashedNotifications (notification->GetStashedNotifications());
+			ObjectLock olock(stashedNotifications);
+
+			if (stashedNotifications->GetLength()) {
 				Log(LogNotice, "NotificationComponent")
-					<< "Reminder notification '" << notificationName << "': HA cluster active, this endpoint does not have the authority (paused=true). Skipping.";
-				continue;
+					<< "Notification '" << notificationName << "': HA cluster active, this endpoint does not have the authority. Dropping all stashed notifications.";
+
+				stashedNotifications->Clear();
 			}
 		}
 
-		Checkable::Ptr checkable = notification->GetCheckable();
+		if (myEndpoint && GetEnableHA()) {
+			Log(LogNotice, "NotificationComponent")
+				<< "Reminder notification '" << notificationName << "': HA cluster active, this endpoint does not have the authority (paused=true). Skipping.";
+			return;
+		}
+	}
+
+	Checkable::Ptr checkable = notification->GetCheckable();
+
+	if (!IcingaApplication::GetInstance()->GetEnableNotifications() || !checkable->GetEnableNotifications())
+		return;
 
-		if (!IcingaApplication::GetInstance()->GetEnableNotifications() || !checkable->GetEnableNotifications())
-			continue;
+	bool reachable = checkable->IsReachable(DependencyNotification);
 
-		bool reachable = checkable->IsReachable(DependencyNotification);
+	if (reachable) {
+		{
+			Array::Ptr unstashedNotifications = new Array();
 
-		if (reachable) {
 			{
-				Array::Ptr unstashedNotifications = new Array();
+				auto stashedNotifications (notification->GetStashedNotifications());
+				ObjectLock olock(stashedNotifications);
+
+				stashedNotifications->CopyTo(unstashedNotifications);
+				stashedNotifications->Clear();
+			}
 
-				{
-					auto stashedNotifications (notification->GetStashedNotifications());
-					ObjectLock olock(stashedNotifications);
+			ObjectLock olock(unstashedNotifications);
 
-					stashedNotifications->CopyTo(unstashedNotifications);
-					stashedNotifications->Clear();
-				}
+			for (Dictionary::Ptr unstashedNotification : unstashedNotifications) {
+				if (!unstashedNotification)
+					continue;
 
-				ObjectLock olock(unstashedNotifications);
-
-				for (Dictionary::Ptr unstashedNotification : unstashedNotifications) {
-					if (!unstashedNotification)
-						continue;
-
-					try {
-						Log(LogNotice, "NotificationComponent")
-							<< "Attempting to send stashed notification '" << notificationName << "'.";
-
-						notification->BeginExecuteNotification(
-							(NotificationType)(int)unstashedNotification->Get("notification_type"),
-							(CheckResult::Ptr)unstashedNotification->Get("cr"),
-							(bool)unstashedNotification->Get("force"),
-							(bool)unstashedNotification->Get("reminder"),
-							(String)unstashedNotification->Get("author"),
-							(String)unstashedNotification->Get("text")
-						);
-					} catch (const std::exception& ex) {
-						Log(LogWarning, "NotificationComponent")
-							<< "Exception occurred during notification for object '"
-							<< notificationName << "': " << DiagnosticInformation(ex, false);
-					}
+				try {
+					Log(LogNotice, "NotificationComponent")
+						<< "Attempting to send stashed notification '" << notificationName << "'.";
+
+					notification->BeginExecuteNotification(
+						(NotificationType)(int)unstashedNotification->Get("notification_type"),
+						(CheckResult::Ptr)unstashedNotification->Get("cr"),
+						(bool)unstashedNotification->Get("force"),
+						(bool)unstashedNotification->Get("reminder"),
+						(String)unstashedNotification->Get("author"),
+						(String)unstashedNotification->Get("text")
+					);
+				} catch (const std::exception& ex) {
+					Log(LogWarning, "NotificationComponent")
+						<< "Exception occurred during notification for object '"
+						<< notificationName << "': " << DiagnosticInformation(ex, false);
 				}
 			}
-
-			FireSuppressedNotifications(notification);
 		}
 
-		if (notification->GetInterval() <= 0 && notification->GetNoMoreNotifications()) {
-			Log(LogNotice, "NotificationComponent")
-				<< "Reminder notification '" << notificationName << "': Notification was sent out once and interval=0 disables reminder notifications.";
-			continue;
-		}
+		FireSuppressedNotifications(notification);
+	}
 
-		if (notification->GetNextNotification() > now)
-			continue;
+	if (notification->GetInterval() <= 0 && notification->GetNoMoreNotifications()) {
+		Log(LogNotice, "NotificationComponent")
+			<< "Reminder notification '" << notificationName << "': Notification was sent out once and interval=0 disables reminder notifications.";
+		return;
+	}
 
-		{
-			ObjectLock olock(notification);
-			notification->SetNextNotification(Utility::GetTime() + notification->GetInterval());
-		}
+	if (notification->GetNextNotification() > now)
+		return;
 
-		{
-			Host::Ptr host;
-			Service::Ptr service;
-			tie(host, service) = GetHostService(checkable);
+	{
+		ObjectLock olock(notification);
+		notification->SetNextNotification(Utility::GetTime() + notification->GetInterval());
+	}
 
-			ObjectLock olock(checkable);
+	{
+		Host::Ptr host;
+		Service::Ptr service;
+		tie(host, service) = GetHostService(checkable);
 
-			if (checkable->GetStateType() == StateTypeSoft)
-				continue;
+		ObjectLock olock(checkable);
 
-			/* Don't send reminder notifications for OK/Up states. */
-			if ((service && service->GetState() == ServiceOK) || (!service && host->GetState() == HostUp))
-				continue;
+		if (checkable->GetStateType() == StateTypeSoft)
+			return;
 
-			/* Don't send reminder notifications before initial ones. */
-			if (checkable->GetSuppressedNotifications() & NotificationProblem || notification->GetSuppressedNotifications() & NotificationProblem)
-				continue;
+		/* Don't send reminder notifications for OK/Up states. */
+		if ((service && service->GetState() == ServiceOK) || (!service && host->GetState() == HostUp))
+			return;
 
-			/* Skip in runtime filters. */
-			if (!reachable || checkable->IsInDowntime() || checkable->IsAcknowledged() || checkable->IsFlapping())
-				continue;
-		}
+		/* Don't send reminder notifications before initial ones. */
+		if (checkable->GetSuppressedNotifications() & NotificationProblem || notification->GetSuppressedNotifications() & NotificationProblem)
+			return;
 
-		try {
-			Log(LogNotice, "NotificationComponent")
-				<< "Attempting to send reminder notification '" << notificationName << "'.";
+		/* Skip in runtime filters. */
+		if (!reachable || checkable->IsInDowntime() || checkable->IsAcknowledged() || checkable->IsFlapping())
+			return;
+	}
 
-			notification->BeginExecuteNotification(NotificationProblem, checkable->GetLastCheckResult(), false, true);
-		} catch (const std::exception& ex) {
-			Log(LogWarning, "NotificationComponent")
-				<< "Exception occurred during notification for object '"
-				<< notificationName << "': " << DiagnosticInformation(ex, false);
-		}
+	try {
+		Log(LogNotice, "NotificationComponent")
+			<< "Attempting to send reminder notification '" << notificationName << "'.";
+
+		notification->BeginExecuteNotification(NotificationProblem, checkable->GetLastCheckResult(), false, true);
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "NotificationComponent")
+			<< "Exception occurred during notification for object '"
+			<< notificationName << "': " << DiagnosticInformation(ex, false);
 	}
 }
 
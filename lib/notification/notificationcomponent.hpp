@@ -4,13 +4,45 @@
 #define NOTIFICATIONCOMPONENT_H
 
 #include "notification/notificationcomponent-ti.hpp"
+#include "icinga/notification.hpp"
 #include "icinga/service.hpp"
 #include "base/configobject.hpp"
 #include "base/timer.hpp"
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/key_extractors.hpp>
+#include <mutex>
+#include <set>
+#include <vector>
 
 namespace icinga
 {
 
+/**
+ * @ingroup notification
+ */
+struct NotificationScheduleInfo
+{
+	Notification::Ptr Object;
+	double NextReminder;
+};
+
+/**
+ * @ingroup notification
+ */
+struct NotificationNextReminderExtractor
+{
+	typedef double result_type;
+
+	/**
+	 * @threadsafety Always.
+	 */
+	double operator()(const NotificationScheduleInfo& nsi)
+	{
+		return nsi.NextReminder;
+	}
+};
+
 /**
  * @ingroup notification
  */
@@ -20,15 +52,38 @@ public:
 	DECLARE_OBJECT(NotificationComponent);
 	DECLARE_OBJECTNAME(NotificationComponent);
 
+	typedef boost::multi_index_container<
+		NotificationScheduleInfo,
+		boost::multi_index::indexed_by<
+			boost::multi_index::ordered_unique<boost::multi_index::member<NotificationScheduleInfo, Notification::Ptr, &NotificationScheduleInfo::Object> >,
+			boost::multi_index::ordered_non_unique<NotificationNextReminderExtractor>
+		>
+	> NotificationSet;
+
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 
+	void OnConfigLoaded() override;
 	void Start(bool runtimeCreated) override;
 	void Stop(bool runtimeRemoved) override;
 
 private:
 	Timer::Ptr m_NotificationTimer;
 
+	std::mutex m_Mutex;
+	NotificationSet m_Notifications;
+
+	/* Notifications with stashed or suppressed notifications, i.e. with work in every timer tick */
+	std::set<Notification::Ptr> m_PendingNotifications;
+
 	void NotificationTimerHandler();
+	void ProcessNotification(const Notification::Ptr& notification, double now, const Endpoint::Ptr& myEndpoint);
+
+	void ObjectHandler(const ConfigObject::Ptr& object);
+	void NextReminderChangedHandler(const Notification::Ptr& notification);
+	void PendingChangedHandler(const Notification::Ptr& notification);
+
+	static NotificationScheduleInfo GetNotificationScheduleInfo(const Notification::Ptr& notification);
+	static bool HasPendingNotifications(const Notification::Ptr& notification);
 	void SendNotificationsHandler(const Checkable::Ptr& checkable, NotificationType type,
 		const CheckResult::Ptr& cr, const String& author, const String& text);
 };
@@ -7,8 +7,6 @@
 #include "icinga/service.hpp"
 #include "icinga/checkcommand.hpp"
 #include "base/application.hpp"
-#include "base/defer.hpp"
-#include "base/io-engine.hpp"
 #include "base/tcpsocket.hpp"
 #include "base/stream.hpp"
 #include "base/base64.hpp"
@@ -18,18 +16,18 @@
 #include "base/perfdatavalue.hpp"
 #include "base/exception.hpp"
 #include "base/statsfunction.hpp"
+#include "base/objectlock.hpp"
 #include <boost/algorithm/string.hpp>
-#include <boost/asio/ssl/context.hpp>
-#include <boost/beast/core/flat_buffer.hpp>
 #include <boost/beast/http/field.hpp>
 #include <boost/beast/http/message.hpp>
-#include <boost/beast/http/parser.hpp>
-#include <boost/beast/http/read.hpp>
 #include <boost/beast/http/status.hpp>
 #include <boost/beast/http/string_body.hpp>
 #include <boost/beast/http/verb.hpp>
-#include <boost/beast/http/write.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
 #include <boost/scoped_array.hpp>
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <utility>
@@ -40,12 +38,18 @@ REGISTER_TYPE(ElasticsearchWriter);
 
 REGISTER_STATSFUNCTION(ElasticsearchWriter, &ElasticsearchWriter::StatsFunc);
 
+/* Bulk requests which may wait for a free connection before Enqueue() blocks. */
+static const size_t l_ElasticsearchMaxPendingRequests = 16;
+
 void ElasticsearchWriter::OnConfigLoaded()
 {
 	ObjectImpl<ElasticsearchWriter>::OnConfigLoaded();
 
 	m_WorkQueue.SetName("ElasticsearchWriter, " + GetName());
 
+	m_SendWorkQueue = std::make_unique<WorkQueue>(l_ElasticsearchMaxPendingRequests, std::max(GetMaxConcurrentRequests(), 1));
+	m_SendWorkQueue->SetName("ElasticsearchWriter, " + GetName() + ", bulk requests");
+
 	if (!GetEnableHa()) {
 		Log(LogDebug, "ElasticsearchWriter")
 			<< "HA functionality disabled. Won't pause connection: " << GetName();
@@ -62,15 +66,32 @@ void ElasticsearchWriter::StatsFunc(const Dictionary::Ptr& status, const Array::
 
 	for (const ElasticsearchWriter::Ptr& elasticsearchwriter : ConfigType::GetObjectsByType<ElasticsearchWriter>()) {
 		size_t workQueueItems = elasticsearchwriter->m_WorkQueue.GetLength();
+		/* The send queue is sized by the config, it doesn't exist before OnConfigLoaded(). */
+		size_t sendQueueItems = elasticsearchwriter->m_SendWorkQueue ? elasticsearchwriter->m_SendWorkQueue->GetLength() : 0;
 		double workQueueItemRate = elasticsearchwriter->m_WorkQueue.GetTaskCount(60) / 60.0;
+		PerfdataSpool::Ptr spool;
+
+		{
+			ObjectLock olock(elasticsearchwriter);
+			spool = elasticsearchwriter->m_Spool;
+		}
+
+		size_t spoolItems = spool ? spool->GetRecordCount() : 0;
+		double spoolAge = spool ? spool->GetAge() : 0;
 
 		nodes.emplace_back(elasticsearchwriter->GetName(), new Dictionary({
 			{ "work_queue_items", workQueueItems },
-			{ "work_queue_item_rate", workQueueItemRate }
+			{ "work_queue_item_rate", workQueueItemRate },
+			{ "send_queue_items", sendQueueItems },
+			{ "spool_items", spoolItems },
+			{ "spool_age", spoolAge }
 		}));
 
 		perfdata->Add(new PerfdataValue("elasticsearchwriter_" + elasticsearchwriter->GetName() + "_work_queue_items", workQueueItems));
 		perfdata->Add(new PerfdataValue("elasticsearchwriter_" + elasticsearchwriter->GetName() + "_work_queue_item_rate", workQueueItemRate));
+		perfdata->Add(new PerfdataValue("elasticsearchwriter_" + elasticsearchwriter->GetName() + "_send_queue_items", sendQueueItems));
+		perfdata->Add(new PerfdataValue("elasticsearchwriter_" + elasticsearchwriter->GetName() + "_spool_items", spoolItems));
+		perfdata->Add(new PerfdataValue("elasticsearchwriter_" + elasticsearchwriter->GetName() + "_spool_age", spoolAge, false, "seconds"));
 	}
 
 	status->Set("elasticsearchwriter", new Dictionary(std::move(nodes)));
@@ -86,6 +107,20 @@ void ElasticsearchWriter::Resume()
 		<< "'" << GetName() << "' resumed.";
 
 	m_WorkQueue.SetExceptionCallback([this](boost::exception_ptr exp) { ExceptionHandler(std::move(exp)); });
+	m_SendWorkQueue->SetExceptionCallback([this](boost::exception_ptr exp) { ExceptionHandler(std::move(exp)); });
+
+	{
+		/* StatsFunc() reads the spool from another thread. */
+		ObjectLock olock(this);
+
+		if (GetEnableSpool() && !m_Spool)
+			m_Spool = PerfdataSpool::Create(this, GetSpoolMaxSize(), GetSpoolReplayRate());
+	}
+
+	m_HttpClient = new HttpClient(GetHost(), GetPort(), std::max(GetMaxConcurrentRequests(), 1));
+
+	if (GetEnableTls())
+		m_HttpClient->EnableTls(GetCertPath(), GetKeyPath(), GetCaPath(), GetInsecureNoverify());
 
 	/* Setup timer for periodically flushing m_DataBuffer */
 	m_FlushTimer = Timer::Create();
@@ -119,9 +154,11 @@ void ElasticsearchWriter::Pause()
 
 	m_FlushTimer->Stop(true);
 
-	Flush();
 	m_WorkQueue.Join();
 	Flush();
+	m_SendWorkQueue->Join();
+
+	m_HttpClient->CloseIdleConnections();
 
 	Log(LogInformation, "ElasticsearchWriter")
 		<< "'" << GetName() << "' paused.";
@@ -153,51 +190,42 @@ void ElasticsearchWriter::AddCheckResult(const Dictionary::Ptr& fields, const Ch
 	if (!GetEnableSendPerfdata())
 		return;
 
-	Array::Ptr perfdata = cr->GetPerformanceData();
+	auto perfdata (cr->GetParsedPerformanceData());
 
 	CheckCommand::Ptr checkCommand = checkable->GetCheckCommand();
 
-	if (perfdata) {
-		ObjectLock olock(perfdata);
-		for (const Value& val : perfdata) {
-			PerfdataValue::Ptr pdv;
-
-			if (val.IsObjectType<PerfdataValue>())
-				pdv = val;
-			else {
-				try {
-					pdv = PerfdataValue::Parse(val);
-				} catch (const std::exception&) {
-					Log(LogWarning, "ElasticsearchWriter")
-						<< "Ignoring invalid perfdata for checkable '"
-						<< checkable->GetName() << "' and command '"
-						<< checkCommand->GetName() << "' with value: " << val;
-					continue;
-				}
-			}
+	for (const ParsedPerfdataValue& val : *perfdata) {
+		const PerfdataValue::Ptr& pdv = val.Parsed;
+
+		if (!pdv) {
+			Log(LogWarning, "ElasticsearchWriter")
+				<< "Ignoring invalid perfdata for checkable '"
+				<< checkable->GetName() << "' and command '"
+				<< checkCommand->GetName() << "' with value: " << val.Raw;
+			continue;
+		}
 
-			String escapedKey = pdv->GetLabel();
-			boost::replace_all(escapedKey, " ", "_");
-			boost::replace_all(escapedKey, ".", "_");
-			boost::replace_all(escapedKey, "\\", "_");
-			boost::algorithm::replace_all(escapedKey, "::", ".");
+		String escapedKey = pdv->GetLabel();
+		boost::replace_all(escapedKey, " ", "_");
+		boost::replace_all(escapedKey, ".", "_");
+		boost::replace_all(escapedKey, "\\", "_");
+		boost::algorithm::replace_all(escapedKey, "::", ".");
 
-			String perfdataPrefix = prefix + "perfdata." + escapedKey;
+		String perfdataPrefix = prefix + "perfdata." + escapedKey;
 
-			fields->Set(perfdataPrefix + ".value", pdv->GetValue());
+		fields->Set(perfdataPrefix + ".value", pdv->GetValue());
 
-			if (!pdv->GetMin().IsEmpty())
-				fields->Set(perfdataPrefix + ".min", pdv->GetMin());
-			if (!pdv->GetMax().IsEmpty())
-				fields->Set(perfdataPrefix + ".max", pdv->GetMax());
-			if (!pdv->GetWarn().IsEmpty())
-				fields->Set(perfdataPrefix + ".warn", pdv->GetWarn());
-			if (!pdv->GetCrit().IsEmpty())
-				fields->Set(perfdataPrefix + ".crit", pdv->GetCrit());
+		if (!pdv->GetMin().IsEmpty())
+			fields->Set(perfdataPrefix + ".min", pdv->GetMin());
+		if (!pdv->GetMax().IsEmpty())
+			fields->Set(perfdataPrefix + ".max", pdv->GetMax());
+		if (!pdv->GetWarn().IsEmpty())
+			fields->Set(perfdataPrefix + ".warn", pdv->GetWarn());
+		if (!pdv->GetCrit().IsEmpty())
+			fields->Set(perfdataPrefix + ".crit", pdv->GetCrit());
 
-			if (!pdv->GetUnit().IsEmpty())
-				fields->Set(perfdataPrefix + ".unit", pdv->GetUnit());
-		}
+		if (!pdv->GetUnit().IsEmpty())
+			fields->Set(perfdataPrefix + ".unit", pdv->GetUnit());
 	}
 }
 
@@ -381,9 +409,6 @@ void ElasticsearchWriter::NotificationSentToAllUsersHandlerInternal(const Notifi
 void ElasticsearchWriter::Enqueue(const Checkable::Ptr& checkable, const String& type,
 	const Dictionary::Ptr& fields, double ts)
 {
-	/* Atomically buffer the data point. */
-	std::unique_lock<std::mutex> lock(m_DataBufferMutex);
-
 	/* Format the timestamps to dynamically select the date datatype inside the index. */
 	fields->Set("@timestamp", FormatTimestamp(ts));
 	fields->Set("timestamp", FormatTimestamp(ts));
@@ -400,55 +425,129 @@ void ElasticsearchWriter::Enqueue(const Checkable::Ptr& checkable, const String&
 	Log(LogDebug, "ElasticsearchWriter")
 		<< "Checkable '" << checkable->GetName() << "' adds to metric list: '" << fieldsBody << "'.";
 
-	m_DataBuffer.emplace_back(indexBody + fieldsBody);
+	size_t buffered;
+
+	{
+		/* Atomically buffer the data point. */
+		std::unique_lock<std::mutex> lock(m_DataBufferMutex);
+
+		m_DataBuffer.emplace_back(indexBody + fieldsBody);
+		buffered = m_DataBuffer.size();
+	}
 
 	/* Flush if we've buffered too much to prevent excessive memory use. */
-	if (static_cast<int>(m_DataBuffer.size()) >= GetFlushThreshold()) {
+	if (static_cast<int>(buffered) >= GetFlushThreshold()) {
 		Log(LogDebug, "ElasticsearchWriter")
-			<< "Data buffer overflow writing " << m_DataBuffer.size() << " data points";
+			<< "Data buffer overflow writing " << buffered << " data points";
 		Flush();
 	}
 }
 
 void ElasticsearchWriter::FlushTimeout()
 {
-	/* Prevent new data points from being added to the array, there is a
-	 * race condition where they could disappear.
-	 */
-	std::unique_lock<std::mutex> lock(m_DataBufferMutex);
-
-	/* Flush if there are any data available. */
-	if (m_DataBuffer.size() > 0) {
-		Log(LogDebug, "ElasticsearchWriter")
-			<< "Timer expired writing " << m_DataBuffer.size() << " data points";
-		Flush();
-	}
+	Flush();
 }
 
+/**
+ * Hands the buffered documents over to the send queue. Only swapping the
+ * buffer happens under m_DataBufferMutex, the bulk requests are sent by
+ * up to max_concurrent_requests threads without blocking the producers.
+ */
 void ElasticsearchWriter::Flush()
 {
 	/* Flush can be called from 1) Timeout 2) Threshold 3) on shutdown/reload. */
-	if (m_DataBuffer.empty())
+	std::vector<String> dataBuffer;
+
+	{
+		std::unique_lock<std::mutex> lock(m_DataBufferMutex);
+		std::swap(dataBuffer, m_DataBuffer);
+	}
+
+	if (dataBuffer.empty()) {
+		if (m_Spool && !m_Spool->IsEmpty())
+			m_SendWorkQueue->Enqueue([this]() { ReplaySpool(); }, PriorityLow);
+
 		return;
+	}
 
-	/* Ensure you hold a lock against m_DataBuffer so that things
-	 * don't go missing after creating the body and clearing the buffer.
-	 */
-	String body = boost::algorithm::join(m_DataBuffer, "\n");
-	m_DataBuffer.clear();
+	Log(LogDebug, "ElasticsearchWriter")
+		<< "Flushing " << dataBuffer.size() << " data points";
+
+	m_SendWorkQueue->Enqueue([this, dataBuffer = std::move(dataBuffer)]() { SendDocuments(dataBuffer); });
+}
+
+/**
+ * Sends documents in a single bulk request, spools them if that fails.
+ *
+ * Called inside the send WQ.
+ *
+ * @param documents The documents, each with its index line
+ */
+void ElasticsearchWriter::SendDocuments(const std::vector<String>& documents)
+{
+	String body = boost::algorithm::join(documents, "\n");
 
 	/* Elasticsearch 6.x requires a new line. This is compatible to 5.x.
 	 * Tested with 6.0.0 and 5.6.4.
 	 */
 	body += "\n";
 
-	SendRequest(body);
+	try {
+		if (!SendRequest(body)) {
+			Spool(documents);
+			return;
+		}
+	} catch (const std::exception&) {
+		Spool(documents);
+		throw;
+	}
+
+	ReplaySpool();
+}
+
+/**
+ * Stores documents which couldn't be sent in the spool, if enabled.
+ */
+void ElasticsearchWriter::Spool(const std::vector<String>& documents)
+{
+	if (!m_Spool)
+		return;
+
+	m_Spool->Append(documents);
+
+	Log(LogNotice, "ElasticsearchWriter")
+		<< "Spooled " << documents.size() << " documents, " << m_Spool->GetRecordCount() << " are waiting to be sent.";
+}
+
+/**
+ * Sends spooled documents, limited by spool_replay_rate.
+ */
+void ElasticsearchWriter::ReplaySpool()
+{
+	if (!m_Spool || m_Spool->IsEmpty())
+		return;
+
+	size_t replayed = m_Spool->Replay(GetFlushThreshold(), [this](const std::vector<String>& documents) {
+		if (!SendRequest(boost::algorithm::join(documents, "\n") + "\n"))
+			BOOST_THROW_EXCEPTION(std::runtime_error("Elasticsearch isn't reachable."));
+	});
+
+	if (replayed) {
+		Log(LogInformation, "ElasticsearchWriter")
+			<< "Replayed " << replayed << " spooled documents, " << m_Spool->GetRecordCount() << " are left.";
+	}
 }
 
-void ElasticsearchWriter::SendRequest(const String& body)
+/**
+ * Sends documents to the bulk API.
+ *
+ * @param body The documents in the bulk format
+ *
+ * @return false if Elasticsearch isn't reachable
+ */
+bool ElasticsearchWriter::SendRequest(const String& body)
 {
-	namespace beast = boost::beast;
-	namespace http = beast::http;
+	namespace http = boost::beast::http;
 
 	Url::Ptr url = new Url();
 
@@ -473,23 +572,7 @@ void ElasticsearchWriter::SendRequest(const String& body)
 
 	url->SetPath(path);
 
-	OptionalTlsStream stream;
-
-	try {
-		stream = Connect();
-	} catch (const std::exception& ex) {
-		Log(LogWarning, "ElasticsearchWriter")
-			<< "Flush failed, cannot connect to Elasticsearch: " << DiagnosticInformation(ex, false);
-		return;
-	}
-
-	Defer s ([&stream]() {
-		if (stream.first) {
-			stream.first->next_layer().shutdown();
-		}
-	});
-
-	http::request<http::string_body> request (http::verb::post, std::string(url->Format(true)), 10);
+	http::request<http::string_body> request (http::verb::post, std::string(url->Format(true)), 11);
 
 	request.set(http::field::user_agent, "Icinga/" + Application::GetAppVersion());
 	request.set(http::field::host, url->GetHost() + ":" + url->GetPort());
@@ -510,7 +593,20 @@ void ElasticsearchWriter::SendRequest(const String& body)
 	if (!username.IsEmpty() && !password.IsEmpty())
 		request.set(http::field::authorization, "Basic " + Base64::Encode(username + ":" + password));
 
-	request.body() = body;
+	if (GetEnableGzip()) {
+		namespace io = boost::iostreams;
+
+		io::filtering_ostream gzip;
+		gzip.push(io::gzip_compressor());
+		gzip.push(io::back_inserter(request.body()));
+		gzip.write(body.CStr(), body.GetLength());
+		io::close(gzip);
+
+		request.set(http::field::content_encoding, "gzip");
+	} else {
+		request.body() = body;
+	}
+
 	request.content_length(request.body().size());
 
 	/* Don't log the request body to debug log, this is already done above. */
@@ -518,36 +614,23 @@ void ElasticsearchWriter::SendRequest(const String& body)
 		<< "Sending " << request.method_string() << " request" << ((!username.IsEmpty() && !password.IsEmpty()) ? " with basic auth" : "" )
 		<< " to '" << url->Format() << "'.";
 
-	try {
-		if (stream.first) {
-			http::write(*stream.first, request);
-			stream.first->flush();
-		} else {
-			http::write(*stream.second, request);
-			stream.second->flush();
-		}
-	} catch (const std::exception&) {
-		Log(LogWarning, "ElasticsearchWriter")
-			<< "Cannot write to HTTP API on host '" << GetHost() << "' port '" << GetPort() << "'.";
-		throw;
-	}
-
-	http::parser<false, http::string_body> parser;
-	beast::flat_buffer buf;
+	HttpClient::Response response;
 
 	try {
-		if (stream.first) {
-			http::read(*stream.first, buf, parser);
-		} else {
-			http::read(*stream.second, buf, parser);
-		}
+		response = m_HttpClient->Send(request);
 	} catch (const std::exception& ex) {
 		Log(LogWarning, "ElasticsearchWriter")
-			<< "Failed to parse HTTP response from host '" << GetHost() << "' port '" << GetPort() << "': " << DiagnosticInformation(ex, false);
-		throw;
+			<< "Flush failed, cannot send documents to Elasticsearch: " << DiagnosticInformation(ex, false);
+
+		/* Don't try the next flush on another stale kept-alive connection. */
+		m_HttpClient->CloseIdleConnections();
+		return false;
 	}
 
-	auto& response (parser.get());
+	/* Server errors (e.g. 503 Service Unavailable) are retried from the spool,
+	 * client errors are not, the documents would be rejected again.
+	 */
+	bool delivered = response.result_int() < 500;
 
 	if (response.result_int() > 299) {
 		if (response.result() == http::status::unauthorized) {
@@ -561,7 +644,7 @@ void ElasticsearchWriter::SendRequest(const String& body)
 					<< "401 Unauthorized. The HTTP API requires authentication but no username/password has been configured.";
 			}
 
-			return;
+			return delivered;
 		}
 
 		std::ostringstream msgbuf;
@@ -586,7 +669,7 @@ void ElasticsearchWriter::SendRequest(const String& body)
 		} catch (...) {
 			Log(LogWarning, "ElasticsearchWriter")
 				<< "Unable to parse JSON response:\n" << body;
-			return;
+			return delivered;
 		}
 
 		String error = jsonResponse->Get("error");
@@ -594,66 +677,8 @@ void ElasticsearchWriter::SendRequest(const String& body)
 		Log(LogCritical, "ElasticsearchWriter")
 			<< "Error: '" << error << "'. " << msgbuf.str();
 	}
-}
-
-OptionalTlsStream ElasticsearchWriter::Connect()
-{
-	Log(LogNotice, "ElasticsearchWriter")
-		<< "Connecting to Elasticsearch on host '" << GetHost() << "' port '" << GetPort() << "'.";
-
-	OptionalTlsStream stream;
-	bool tls = GetEnableTls();
-
-	if (tls) {
-		Shared<boost::asio::ssl::context>::Ptr sslContext;
-
-		try {
-			sslContext = MakeAsioSslContext(GetCertPath(), GetKeyPath(), GetCaPath());
-		} catch (const std::exception&) {
-			Log(LogWarning, "ElasticsearchWriter")
-				<< "Unable to create SSL context.";
-			throw;
-		}
-
-		stream.first = Shared<AsioTlsStream>::Make(IoEngine::Get().GetIoContext(), *sslContext, GetHost());
-
-	} else {
-		stream.second = Shared<AsioTcpStream>::Make(IoEngine::Get().GetIoContext());
-	}
-
-	try {
-		icinga::Connect(tls ? stream.first->lowest_layer() : stream.second->lowest_layer(), GetHost(), GetPort());
-	} catch (const std::exception&) {
-		Log(LogWarning, "ElasticsearchWriter")
-			<< "Can't connect to Elasticsearch on host '" << GetHost() << "' port '" << GetPort() << "'.";
-		throw;
-	}
-
-	if (tls) {
-		auto& tlsStream (stream.first->next_layer());
-
-		try {
-			tlsStream.handshake(tlsStream.client);
-		} catch (const std::exception&) {
-			Log(LogWarning, "ElasticsearchWriter")
-				<< "TLS handshake with host '" << GetHost() << "' on port " << GetPort() << " failed.";
-			throw;
-		}
 
-		if (!GetInsecureNoverify()) {
-			if (!tlsStream.GetPeerCertificate()) {
-				BOOST_THROW_EXCEPTION(std::runtime_error("Elasticsearch didn't present any TLS certificate."));
-			}
-
-			if (!tlsStream.IsVerifyOK()) {
-				BOOST_THROW_EXCEPTION(std::runtime_error(
-					"TLS certificate validation failed: " + std::string(tlsStream.GetVerifyError())
-				));
-			}
-		}
-	}
-
-	return stream;
+	return delivered;
 }
 
 void ElasticsearchWriter::AssertOnWorkQueue()
@@ -667,6 +692,10 @@ void ElasticsearchWriter::ExceptionHandler(boost::exception_ptr exp)
 
 	Log(LogDebug, "ElasticsearchWriter")
 		<< "Exception during Elasticsearch operation: " << DiagnosticInformation(std::move(exp));
+
+	/* The failed connection is already gone, the kept-alive ones may be just as dead. */
+	if (m_HttpClient)
+		m_HttpClient->CloseIdleConnections();
 }
 
 String ElasticsearchWriter::FormatTimestamp(double ts)
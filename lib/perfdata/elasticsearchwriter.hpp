@@ -4,11 +4,16 @@
 #define ELASTICSEARCHWRITER_H
 
 #include "perfdata/elasticsearchwriter-ti.hpp"
+#include "perfdata/perfdataspool.hpp"
 #include "icinga/service.hpp"
 #include "base/configobject.hpp"
 #include "base/workqueue.hpp"
 #include "base/timer.hpp"
 #include "base/tlsstream.hpp"
+#include "remote/httpclient.hpp"
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace icinga
 {
@@ -31,10 +36,13 @@ protected:
 private:
 	String m_EventPrefix;
 	WorkQueue m_WorkQueue{10000000, 1};
+	std::unique_ptr<WorkQueue> m_SendWorkQueue;
 	boost::signals2::connection m_HandleCheckResults, m_HandleStateChanges, m_HandleNotifications;
 	Timer::Ptr m_FlushTimer;
 	std::vector<String> m_DataBuffer;
 	std::mutex m_DataBufferMutex;
+	PerfdataSpool::Ptr m_Spool;
+	HttpClient::Ptr m_HttpClient;
 
 	void AddCheckResult(const Dictionary::Ptr& fields, const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
 
@@ -52,12 +60,14 @@ private:
 	void Enqueue(const Checkable::Ptr& checkable, const String& type,
 		const Dictionary::Ptr& fields, double ts);
 
-	OptionalTlsStream Connect();
 	void AssertOnWorkQueue();
 	void ExceptionHandler(boost::exception_ptr exp);
 	void FlushTimeout();
 	void Flush();
-	void SendRequest(const String& body);
+	void SendDocuments(const std::vector<String>& documents);
+	bool SendRequest(const String& body);
+	void Spool(const std::vector<String>& documents);
+	void ReplaySpool();
 };
 
 }
@@ -323,47 +323,38 @@ void GelfWriter::CheckResultHandlerInternal(const Checkable::Ptr& checkable, con
 	}
 
 	if (cr && GetEnableSendPerfdata()) {
-		Array::Ptr perfdata = cr->GetPerformanceData();
-
-		if (perfdata) {
-			ObjectLock olock(perfdata);
-			for (const Value& val : perfdata) {
-				PerfdataValue::Ptr pdv;
-
-				if (val.IsObjectType<PerfdataValue>())
-					pdv = val;
-				else {
-					try {
-						pdv = PerfdataValue::Parse(val);
-					} catch (const std::exception&) {
-						Log(LogWarning, "GelfWriter")
-							<< "Ignoring invalid perfdata for checkable '"
-							<< checkable->GetName() << "' and command '"
-							<< checkCommand->GetName() << "' with value: " << val;
-						continue;
-					}
-				}
-
-				String escaped_key = pdv->GetLabel();
-				boost::replace_all(escaped_key, " ", "_");
-				boost::replace_all(escaped_key, ".", "_");
-				boost::replace_all(escaped_key, "\\", "_");
-				boost::algorithm::replace_all(escaped_key, "::", ".");
-
-				fields->Set("_" + escaped_key, pdv->GetValue());
-
-				if (!pdv->GetMin().IsEmpty())
-					fields->Set("_" + escaped_key + "_min", pdv->GetMin());
-				if (!pdv->GetMax().IsEmpty())
-					fields->Set("_" + escaped_key + "_max", pdv->GetMax());
-				if (!pdv->GetWarn().IsEmpty())
-					fields->Set("_" + escaped_key + "_warn", pdv->GetWarn());
-				if (!pdv->GetCrit().IsEmpty())
-					fields->Set("_" + escaped_key + "_crit", pdv->GetCrit());
-
-				if (!pdv->GetUnit().IsEmpty())
-					fields->Set("_" + escaped_key + "_unit", pdv->GetUnit());
+		auto perfdata (cr->GetParsedPerformanceData());
+
+		for (const ParsedPerfdataValue& val : *perfdata) {
+			const PerfdataValue::Ptr& pdv = val.Parsed;
+
+			if (!pdv) {
+				Log(LogWarning, "GelfWriter")
+					<< "Ignoring invalid perfdata for checkable '"
+					<< checkable->GetName() << "' and command '"
+					<< checkCommand->GetName() << "' with value: " << val.Raw;
+				continue;
 			}
+
+			String escaped_key = pdv->GetLabel();
+			boost::replace_all(escaped_key, " ", "_");
+			boost::replace_all(escaped_key, ".", "_");
+			boost::replace_all(escaped_key, "\\", "_");
+			boost::algorithm::replace_all(escaped_key, "::", ".");
+
+			fields->Set("_" + escaped_key, pdv->GetValue());
+
+			if (!pdv->GetMin().IsEmpty())
+				fields->Set("_" + escaped_key + "_min", pdv->GetMin());
+			if (!pdv->GetMax().IsEmpty())
+				fields->Set("_" + escaped_key + "_max", pdv->GetMax());
+			if (!pdv->GetWarn().IsEmpty())
+				fields->Set("_" + escaped_key + "_warn", pdv->GetWarn());
+			if (!pdv->GetCrit().IsEmpty())
+				fields->Set("_" + escaped_key + "_crit", pdv->GetCrit());
+
+			if (!pdv->GetUnit().IsEmpty())
+				fields->Set("_" + escaped_key + "_unit", pdv->GetUnit());
 		}
 	}
 
@@ -20,6 +20,9 @@
 #include "base/statsfunction.hpp"
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/write.hpp>
+#include <chrono>
 #include <utility>
 
 using namespace icinga;
@@ -28,6 +31,12 @@ REGISTER_TYPE(GraphiteWriter);
 
 REGISTER_STATSFUNCTION(GraphiteWriter, &GraphiteWriter::StatsFunc);
 
+/* Batches which may wait for a slow Graphite backend before being spooled (or dropped). */
+static const size_t l_GraphiteMaxPendingBatches = 64;
+
+/* Dropped metrics are logged as warnings at most this often (in seconds), otherwise as notices. */
+static const double l_GraphiteDropWarningInterval = 60;
+
 /*
  * Enable HA capabilities once the config object is loaded.
  */
@@ -60,15 +69,28 @@ void GraphiteWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&
 	for (const GraphiteWriter::Ptr& graphitewriter : ConfigType::GetObjectsByType<GraphiteWriter>()) {
 		size_t workQueueItems = graphitewriter->m_WorkQueue.GetLength();
 		double workQueueItemRate = graphitewriter->m_WorkQueue.GetTaskCount(60) / 60.0;
+		PerfdataSpool::Ptr spool;
+
+		{
+			ObjectLock olock(graphitewriter);
+			spool = graphitewriter->m_Spool;
+		}
+
+		size_t spoolItems = spool ? spool->GetRecordCount() : 0;
+		double spoolAge = spool ? spool->GetAge() : 0;
 
 		nodes.emplace_back(graphitewriter->GetName(), new Dictionary({
 			{ "work_queue_items", workQueueItems },
 			{ "work_queue_item_rate", workQueueItemRate },
-			{ "connected", graphitewriter->GetConnected() }
+			{ "connected", graphitewriter->GetConnected() },
+			{ "spool_items", spoolItems },
+			{ "spool_age", spoolAge }
 		}));
 
 		perfdata->Add(new PerfdataValue("graphitewriter_" + graphitewriter->GetName() + "_work_queue_items", workQueueItems));
 		perfdata->Add(new PerfdataValue("graphitewriter_" + graphitewriter->GetName() + "_work_queue_item_rate", workQueueItemRate));
+		perfdata->Add(new PerfdataValue("graphitewriter_" + graphitewriter->GetName() + "_spool_items", spoolItems));
+		perfdata->Add(new PerfdataValue("graphitewriter_" + graphitewriter->GetName() + "_spool_age", spoolAge, false, "seconds"));
 	}
 
 	status->Set("graphitewriter", new Dictionary(std::move(nodes)));
@@ -87,6 +109,17 @@ void GraphiteWriter::Resume()
 	/* Register exception handler for WQ tasks. */
 	m_WorkQueue.SetExceptionCallback([this](boost::exception_ptr exp) { ExceptionHandler(std::move(exp)); });
 
+	if (!m_Strand)
+		m_Strand = Shared<boost::asio::io_context::strand>::Make(IoEngine::Get().GetIoContext());
+
+	{
+		/* StatsFunc() reads the spool from another thread. */
+		ObjectLock olock(this);
+
+		if (GetEnableSpool() && !m_Spool)
+			m_Spool = PerfdataSpool::Create(this, GetSpoolMaxSize(), GetSpoolReplayRate());
+	}
+
 	/* Timer for reconnecting */
 	m_ReconnectTimer = Timer::Create();
 	m_ReconnectTimer->SetInterval(10);
@@ -94,6 +127,12 @@ void GraphiteWriter::Resume()
 	m_ReconnectTimer->Start();
 	m_ReconnectTimer->Reschedule(0);
 
+	/* Timer for flushing the data buffer */
+	m_FlushTimer = Timer::Create();
+	m_FlushTimer->SetInterval(GetFlushInterval());
+	m_FlushTimer->OnTimerExpired.connect([this](const Timer * const&) { FlushTimeout(); });
+	m_FlushTimer->Start();
+
 	/* Register event handlers. */
 	m_HandleCheckResults = Checkable::OnNewCheckResult.connect([this](const Checkable::Ptr& checkable,
 		const CheckResult::Ptr& cr, const MessageOrigin::Ptr&) {
@@ -108,22 +147,39 @@ void GraphiteWriter::Pause()
 {
 	m_HandleCheckResults.disconnect();
 	m_ReconnectTimer->Stop(true);
+	m_FlushTimer->Stop(true);
+
+	bool connected = true;
 
 	try {
 		ReconnectInternal();
 	} catch (const std::exception&) {
-		Log(LogInformation, "GraphiteWriter")
-			<< "'" << GetName() << "' paused. Unable to connect, not flushing buffers. Data may be lost on reload.";
-
-		ObjectImpl<GraphiteWriter>::Pause();
-		return;
+		connected = false;
 	}
 
+	/* Without a connection Flush() spools the data buffer. */
+	m_WorkQueue.Enqueue([this]() { Flush(); }, PriorityLow);
 	m_WorkQueue.Join();
+
+	{
+		std::unique_lock<std::mutex> lock(m_StreamMutex);
+
+		if (!m_SendingCV.wait_for(lock, std::chrono::seconds(10), [this]() { return !m_Sending; })) {
+			Log(LogWarning, "GraphiteWriter")
+				<< "'" << GetName() << "' timed out waiting for pending metrics to be sent.";
+		}
+	}
+
+	/* Cancels pending writes, if any. Their metrics are spooled. */
 	DisconnectInternal();
 
-	Log(LogInformation, "GraphiteWriter")
-		<< "'" << GetName() << "' paused.";
+	if (connected) {
+		Log(LogInformation, "GraphiteWriter")
+			<< "'" << GetName() << "' paused.";
+	} else {
+		Log(LogInformation, "GraphiteWriter")
+			<< "'" << GetName() << "' paused. Unable to connect, buffered metrics haven't been sent.";
+	}
 
 	ObjectImpl<GraphiteWriter>::Pause();
 }
@@ -150,11 +206,7 @@ void GraphiteWriter::ExceptionHandler(boost::exception_ptr exp)
 	Log(LogDebug, "GraphiteWriter")
 		<< "Exception during Graphite operation: " << DiagnosticInformation(std::move(exp));
 
-	if (GetConnected()) {
-		m_Stream->close();
-
-		SetConnected(false);
-	}
+	DisconnectInternal();
 }
 
 /**
@@ -172,6 +224,7 @@ void GraphiteWriter::Reconnect()
 	}
 
 	ReconnectInternal();
+	ReplaySpool();
 }
 
 /**
@@ -191,10 +244,15 @@ void GraphiteWriter::ReconnectInternal()
 	Log(LogNotice, "GraphiteWriter")
 		<< "Reconnecting to Graphite on host '" << GetHost() << "' port '" << GetPort() << "'.";
 
-	m_Stream = Shared<AsioTcpStream>::Make(IoEngine::Get().GetIoContext());
+	auto stream (Shared<AsioTcpStream>::Make(IoEngine::Get().GetIoContext()));
+
+	{
+		std::unique_lock<std::mutex> lock(m_StreamMutex);
+		m_Stream = stream;
+	}
 
 	try {
-		icinga::Connect(m_Stream->lowest_layer(), GetHost(), GetPort());
+		icinga::Connect(stream->lowest_layer(), GetHost(), GetPort());
 	} catch (const std::exception& ex) {
 		Log(LogWarning, "GraphiteWriter")
 			<< "Can't connect to Graphite on host '" << GetHost() << "' port '" << GetPort() << ".'";
@@ -210,6 +268,39 @@ void GraphiteWriter::ReconnectInternal()
 		<< "Finished reconnecting to Graphite in " << std::setw(2) << Utility::GetTime() - startTime << " second(s).";
 }
 
+/**
+ * Sends spooled metrics, limited by spool_replay_rate.
+ *
+ * Called inside the WQ.
+ */
+void GraphiteWriter::ReplaySpool()
+{
+	namespace asio = boost::asio;
+
+	AssertOnWorkQueue();
+
+	if (!m_Spool || m_Spool->IsEmpty())
+		return;
+
+	std::unique_lock<std::mutex> lock(m_StreamMutex);
+
+	/* Spooled metrics must not overtake the ones which are still being sent. */
+	if (!GetConnected() || m_Sending)
+		return;
+
+	size_t replayed = m_Spool->Replay(1024, [this](const std::vector<String>& metrics) {
+		String lines = boost::algorithm::join(metrics, "");
+
+		asio::write(*m_Stream, asio::buffer(lines.CStr(), lines.GetLength()));
+		m_Stream->flush();
+	});
+
+	if (replayed) {
+		Log(LogInformation, "GraphiteWriter")
+			<< "Replayed " << replayed << " spooled metrics, " << m_Spool->GetRecordCount() << " are left.";
+	}
+}
+
 /**
  * Reconnect handler called by the timer.
  *
@@ -245,7 +336,13 @@ void GraphiteWriter::DisconnectInternal()
 	if (!GetConnected())
 		return;
 
-	m_Stream->close();
+	auto stream (m_Stream);
+
+	/* The stream may be in use by SendBatches(). */
+	boost::asio::post(*m_Strand, [stream]() {
+		boost::system::error_code ec;
+		stream->lowest_layer().close(ec);
+	});
 
 	SetConnected(false);
 }
@@ -341,29 +438,22 @@ void GraphiteWriter::CheckResultHandlerInternal(const Checkable::Ptr& checkable,
  */
 void GraphiteWriter::SendPerfdata(const Checkable::Ptr& checkable, const String& prefix, const CheckResult::Ptr& cr, double ts)
 {
-	Array::Ptr perfdata = cr->GetPerformanceData();
+	auto perfdata (cr->GetParsedPerformanceData());
 
-	if (!perfdata)
+	if (perfdata->empty())
 		return;
 
 	CheckCommand::Ptr checkCommand = checkable->GetCheckCommand();
 
-	ObjectLock olock(perfdata);
-	for (const Value& val : perfdata) {
-		PerfdataValue::Ptr pdv;
-
-		if (val.IsObjectType<PerfdataValue>())
-			pdv = val;
-		else {
-			try {
-				pdv = PerfdataValue::Parse(val);
-			} catch (const std::exception&) {
-				Log(LogWarning, "GraphiteWriter")
-					<< "Ignoring invalid perfdata for checkable '"
-					<< checkable->GetName() << "' and command '"
-					<< checkCommand->GetName() << "' with value: " << val;
-				continue;
-			}
+	for (const ParsedPerfdataValue& val : *perfdata) {
+		const PerfdataValue::Ptr& pdv = val.Parsed;
+
+		if (!pdv) {
+			Log(LogWarning, "GraphiteWriter")
+				<< "Ignoring invalid perfdata for checkable '"
+				<< checkable->GetName() << "' and command '"
+				<< checkCommand->GetName() << "' with value: " << val.Raw;
+			continue;
 		}
 
 		String escapedKey = EscapeMetricLabel(pdv->GetLabel());
@@ -384,7 +474,9 @@ void GraphiteWriter::SendPerfdata(const Checkable::Ptr& checkable, const String&
 }
 
 /**
- * Computes metric data and sends to Graphite
+ * Computes metric data and adds it to the data buffer
+ *
+ * Called inside the WQ.
  *
  * @param checkable Host/service object
  * @param prefix Computed metric prefix string
@@ -394,8 +486,6 @@ void GraphiteWriter::SendPerfdata(const Checkable::Ptr& checkable, const String&
  */
 void GraphiteWriter::SendMetric(const Checkable::Ptr& checkable, const String& prefix, const String& name, double value, double ts)
 {
-	namespace asio = boost::asio;
-
 	std::ostringstream msgbuf;
 	msgbuf << prefix << "." << name << " " << Convert::ToString(value) << " " << static_cast<long>(ts);
 
@@ -405,20 +495,145 @@ void GraphiteWriter::SendMetric(const Checkable::Ptr& checkable, const String& p
 	// do not send \n to debug log
 	msgbuf << "\n";
 
+	m_DataBuffer.emplace_back(msgbuf.str());
+
+	if (static_cast<int>(m_DataBuffer.size()) >= GetFlushThreshold()) {
+		Log(LogDebug, "GraphiteWriter")
+			<< "Data buffer overflow writing " << m_DataBuffer.size() << " metrics";
+
+		Flush();
+	}
+}
+
+/**
+ * Flush timer handler, enqueues a flush into the WQ.
+ */
+void GraphiteWriter::FlushTimeout()
+{
+	m_WorkQueue.Enqueue([this]() { Flush(); }, PriorityHigh);
+}
+
+/**
+ * Hands the data buffer over to SendBatches() which writes it to the stream
+ * asynchronously, so that a slow Graphite backend doesn't block the WQ.
+ *
+ * Called inside the WQ.
+ */
+void GraphiteWriter::Flush()
+{
+	AssertOnWorkQueue();
+
+	if (m_DataBuffer.empty())
+		return;
+
+	std::vector<String> metrics;
+	std::swap(metrics, m_DataBuffer);
+
 	std::unique_lock<std::mutex> lock(m_StreamMutex);
 
-	if (!GetConnected())
+	if (!GetConnected() || m_SendQueue.size() >= l_GraphiteMaxPendingBatches) {
+		lock.unlock();
+
+		SpoolMetrics(metrics);
 		return;
+	}
 
-	try {
-		asio::write(*m_Stream, asio::buffer(msgbuf.str()));
-		m_Stream->flush();
-	} catch (const std::exception& ex) {
-		Log(LogCritical, "GraphiteWriter")
-			<< "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "'.";
+	m_SendQueue.emplace_back(std::move(metrics));
+
+	if (!m_Sending) {
+		m_Sending = true;
+
+		IoEngine::SpawnCoroutine(*m_Strand, [this, keepAlive = GraphiteWriter::Ptr(this)](boost::asio::yield_context yc) {
+			SendBatches(yc);
+		});
+	}
+}
+
+/**
+ * Writes the queued batches to the stream until the queue is empty.
+ *
+ * Runs on the I/O engine. If writing fails, the stream is closed and
+ * all pending metrics are spooled.
+ *
+ * @param yc Yield context
+ */
+void GraphiteWriter::SendBatches(boost::asio::yield_context yc)
+{
+	namespace asio = boost::asio;
+
+	for (;;) {
+		std::vector<String> metrics;
+		Shared<AsioTcpStream>::Ptr stream;
+
+		{
+			std::unique_lock<std::mutex> lock(m_StreamMutex);
+
+			if (m_SendQueue.empty()) {
+				m_Sending = false;
+				m_SendingCV.notify_all();
+				return;
+			}
+
+			metrics = std::move(m_SendQueue.front());
+			m_SendQueue.pop_front();
+			stream = m_Stream;
+		}
+
+		String lines = boost::algorithm::join(metrics, "");
+
+		try {
+			asio::async_write(*stream, asio::buffer(lines.CStr(), lines.GetLength()), yc);
+			stream->async_flush(yc);
+		} catch (const std::exception& ex) {
+			Log(LogCritical, "GraphiteWriter")
+				<< "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "'.";
+
+			Log(LogDebug, "GraphiteWriter")
+				<< "Exception during Graphite operation: " << DiagnosticInformation(ex);
+
+			boost::system::error_code ec;
+			stream->lowest_layer().close(ec);
+
+			SetConnected(false);
+
+			std::deque<std::vector<String>> pending;
 
-		throw ex;
+			{
+				std::unique_lock<std::mutex> lock(m_StreamMutex);
+
+				std::swap(pending, m_SendQueue);
+				m_Sending = false;
+				m_SendingCV.notify_all();
+			}
+
+			SpoolMetrics(metrics);
+
+			for (auto& batch : pending)
+				SpoolMetrics(batch);
+
+			return;
+		}
+	}
+}
+
+/**
+ * Keeps metrics which couldn't be sent in the spool, if enabled.
+ *
+ * @param metrics Metric lines
+ */
+void GraphiteWriter::SpoolMetrics(const std::vector<String>& metrics)
+{
+	if (m_Spool) {
+		m_Spool->Append(metrics);
+		return;
 	}
+
+	double now = Utility::GetTime();
+	double lastWarning = m_LastDropWarning;
+	bool warn = now - lastWarning >= l_GraphiteDropWarningInterval && m_LastDropWarning.compare_exchange_strong(lastWarning, now);
+
+	Log(warn ? LogWarning : LogNotice, "GraphiteWriter")
+		<< "Dropping " << metrics.size() << " metrics, Graphite on host '" << GetHost() << "' port '" << GetPort() << "' isn't available.";
 }
 
 /**
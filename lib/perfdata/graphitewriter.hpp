@@ -4,13 +4,21 @@
 #define GRAPHITEWRITER_H
 
 #include "perfdata/graphitewriter-ti.hpp"
+#include "perfdata/perfdataspool.hpp"
 #include "icinga/service.hpp"
 #include "base/configobject.hpp"
+#include "base/io-engine.hpp"
 #include "base/tcpsocket.hpp"
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
+#include <boost/asio/io_context_strand.hpp>
+#include <boost/asio/spawn.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
 #include <mutex>
+#include <vector>
 
 namespace icinga
 {
@@ -39,10 +47,19 @@ protected:
 private:
 	Shared<AsioTcpStream>::Ptr m_Stream;
 	std::mutex m_StreamMutex;
+	Shared<boost::asio::io_context::strand>::Ptr m_Strand;
 	WorkQueue m_WorkQueue{10000000, 1};
+	PerfdataSpool::Ptr m_Spool;
+
+	std::vector<String> m_DataBuffer;
+	std::deque<std::vector<String>> m_SendQueue;
+	bool m_Sending{false};
+	std::condition_variable m_SendingCV;
+	std::atomic<double> m_LastDropWarning{0};
 
 	boost::signals2::connection m_HandleCheckResults;
 	Timer::Ptr m_ReconnectTimer;
+	Timer::Ptr m_FlushTimer;
 
 	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
 	void CheckResultHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
@@ -58,6 +75,12 @@ private:
 	void DisconnectInternal();
 	void Reconnect();
 	void ReconnectInternal();
+	void ReplaySpool();
+
+	void FlushTimeout();
+	void Flush();
+	void SendBatches(boost::asio::yield_context yc);
+	void SpoolMetrics(const std::vector<String>& metrics);
 
 	void AssertOnWorkQueue();
 
@@ -8,8 +8,6 @@
 #include "icinga/icingaapplication.hpp"
 #include "icinga/checkcommand.hpp"
 #include "base/application.hpp"
-#include "base/defer.hpp"
-#include "base/io-engine.hpp"
 #include "base/tcpsocket.hpp"
 #include "base/configtype.hpp"
 #include "base/objectlock.hpp"
@@ -21,19 +19,13 @@
 #include "base/networkstream.hpp"
 #include "base/exception.hpp"
 #include "base/statsfunction.hpp"
-#include "base/tlsutility.hpp"
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/replace.hpp>
-#include <boost/asio/ssl/context.hpp>
-#include <boost/beast/core/flat_buffer.hpp>
 #include <boost/beast/http/field.hpp>
 #include <boost/beast/http/message.hpp>
-#include <boost/beast/http/parser.hpp>
-#include <boost/beast/http/read.hpp>
 #include <boost/beast/http/status.hpp>
 #include <boost/beast/http/string_body.hpp>
 #include <boost/beast/http/verb.hpp>
-#include <boost/beast/http/write.hpp>
 #include <boost/math/special_functions/fpclassify.hpp>
 #include <boost/regex.hpp>
 #include <boost/scoped_array.hpp>
@@ -90,6 +82,19 @@ void InfluxdbCommonWriter::Resume()
 	/* Register exception handler for WQ tasks. */
 	m_WorkQueue.SetExceptionCallback([this](boost::exception_ptr exp) { ExceptionHandler(std::move(exp)); });
 
+	{
+		/* StatsFunc() reads the spool from another thread. */
+		ObjectLock olock(this);
+
+		if (GetEnableSpool() && !m_Spool)
+			m_Spool = PerfdataSpool::Create(this, GetSpoolMaxSize(), GetSpoolReplayRate());
+	}
+
+	m_HttpClient = new HttpClient(GetHost(), GetPort());
+
+	if (GetSslEnable())
+		m_HttpClient->EnableTls(GetSslCert(), GetSslKey(), GetSslCaCert(), GetSslInsecureNoverify());
+
 	/* Setup timer for periodically flushing m_DataBuffer */
 	m_FlushTimer = Timer::Create();
 	m_FlushTimer->SetInterval(GetFlushInterval());
@@ -119,6 +124,8 @@ void InfluxdbCommonWriter::Pause()
 	/* Wait for the flush to complete, implicitly waits for all WQ tasks enqueued prior to pausing. */
 	m_WorkQueue.Join();
 
+	m_HttpClient->CloseIdleConnections();
+
 	Log(LogInformation, GetReflectionType()->GetName())
 		<< "'" << GetName() << "' paused.";
 
@@ -137,67 +144,9 @@ void InfluxdbCommonWriter::ExceptionHandler(boost::exception_ptr exp)
 	Log(LogDebug, GetReflectionType()->GetName())
 		<< "Exception during InfluxDB operation: " << DiagnosticInformation(std::move(exp));
 
-	//TODO: Close the connection, if we keep it open.
-}
-
-OptionalTlsStream InfluxdbCommonWriter::Connect()
-{
-	Log(LogNotice, GetReflectionType()->GetName())
-		<< "Reconnecting to InfluxDB on host '" << GetHost() << "' port '" << GetPort() << "'.";
-
-	OptionalTlsStream stream;
-	bool ssl = GetSslEnable();
-
-	if (ssl) {
-		Shared<boost::asio::ssl::context>::Ptr sslContext;
-
-		try {
-			sslContext = MakeAsioSslContext(GetSslCert(), GetSslKey(), GetSslCaCert());
-		} catch (const std::exception& ex) {
-			Log(LogWarning, GetReflectionType()->GetName())
-				<< "Unable to create SSL context.";
-			throw;
-		}
-
-		stream.first = Shared<AsioTlsStream>::Make(IoEngine::Get().GetIoContext(), *sslContext, GetHost());
-
-	} else {
-		stream.second = Shared<AsioTcpStream>::Make(IoEngine::Get().GetIoContext());
-	}
-
-	try {
-		icinga::Connect(ssl ? stream.first->lowest_layer() : stream.second->lowest_layer(), GetHost(), GetPort());
-	} catch (const std::exception& ex) {
-		Log(LogWarning, GetReflectionType()->GetName())
-			<< "Can't connect to InfluxDB on host '" << GetHost() << "' port '" << GetPort() << "'.";
-		throw;
-	}
-
-	if (ssl) {
-		auto& tlsStream (stream.first->next_layer());
-
-		try {
-			tlsStream.handshake(tlsStream.client);
-		} catch (const std::exception& ex) {
-			Log(LogWarning, GetReflectionType()->GetName())
-				<< "TLS handshake with host '" << GetHost() << "' failed.";
-			throw;
-		}
-
-		if (!GetSslInsecureNoverify()) {
-			if (!tlsStream.GetPeerCertificate()) {
-				BOOST_THROW_EXCEPTION(std::runtime_error("InfluxDB didn't present any TLS certificate."));
-			}
-
-			if (!tlsStream.IsVerifyOK()) {
-				BOOST_THROW_EXCEPTION(std::runtime_error(
-					"TLS certificate validation failed: " + std::string(tlsStream.GetVerifyError())
-				));
-			}
-		}
-	}
-
-	return stream;
+	/* The failed connection is already gone, the kept-alive ones may be just as dead. */
+	if (m_HttpClient)
+		m_HttpClient->CloseIdleConnections();
 }
 
 void InfluxdbCommonWriter::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
@@ -256,46 +205,37 @@ void InfluxdbCommonWriter::CheckResultHandlerWQ(const Checkable::Ptr& checkable,
 
 	CheckCommand::Ptr checkCommand = checkable->GetCheckCommand();
 
-	Array::Ptr perfdata = cr->GetPerformanceData();
-
-	if (perfdata) {
-		ObjectLock olock(perfdata);
-		for (const Value& val : perfdata) {
-			PerfdataValue::Ptr pdv;
-
-			if (val.IsObjectType<PerfdataValue>())
-				pdv = val;
-			else {
-				try {
-					pdv = PerfdataValue::Parse(val);
-				} catch (const std::exception&) {
-					Log(LogWarning, GetReflectionType()->GetName())
-						<< "Ignoring invalid perfdata for checkable '"
-						<< checkable->GetName() << "' and command '"
-						<< checkCommand->GetName() << "' with value: " << val;
-					continue;
-				}
-			}
+	auto perfdata (cr->GetParsedPerformanceData());
 
-			Dictionary::Ptr fields = new Dictionary();
-			fields->Set("value", pdv->GetValue());
-
-			if (GetEnableSendThresholds()) {
-				if (!pdv->GetCrit().IsEmpty())
-					fields->Set("crit", pdv->GetCrit());
-				if (!pdv->GetWarn().IsEmpty())
-					fields->Set("warn", pdv->GetWarn());
-				if (!pdv->GetMin().IsEmpty())
-					fields->Set("min", pdv->GetMin());
-				if (!pdv->GetMax().IsEmpty())
-					fields->Set("max", pdv->GetMax());
-			}
-			if (!pdv->GetUnit().IsEmpty()) {
-				fields->Set("unit", pdv->GetUnit());
-			}
+	for (const ParsedPerfdataValue& val : *perfdata) {
+		const PerfdataValue::Ptr& pdv = val.Parsed;
 
-			SendMetric(checkable, tmpl, pdv->GetLabel(), fields, ts);
+		if (!pdv) {
+			Log(LogWarning, GetReflectionType()->GetName())
+				<< "Ignoring invalid perfdata for checkable '"
+				<< checkable->GetName() << "' and command '"
+				<< checkCommand->GetName() << "' with value: " << val.Raw;
+			continue;
 		}
+
+		Dictionary::Ptr fields = new Dictionary();
+		fields->Set("value", pdv->GetValue());
+
+		if (GetEnableSendThresholds()) {
+			if (!pdv->GetCrit().IsEmpty())
+				fields->Set("crit", pdv->GetCrit());
+			if (!pdv->GetWarn().IsEmpty())
+				fields->Set("warn", pdv->GetWarn());
+			if (!pdv->GetMin().IsEmpty())
+				fields->Set("min", pdv->GetMin());
+			if (!pdv->GetMax().IsEmpty())
+				fields->Set("max", pdv->GetMax());
+		}
+		if (!pdv->GetUnit().IsEmpty()) {
+			fields->Set("unit", pdv->GetUnit());
+		}
+
+		SendMetric(checkable, tmpl, pdv->GetLabel(), fields, ts);
 	}
 
 	if (GetEnableSendMetadata()) {
@@ -440,68 +380,61 @@ void InfluxdbCommonWriter::FlushWQ()
 {
 	AssertOnWorkQueue();
 
-	namespace beast = boost::beast;
-	namespace http = beast::http;
-
 	/* Flush can be called from 1) Timeout 2) Threshold 3) on shutdown/reload. */
-	if (m_DataBuffer.empty())
+	if (m_DataBuffer.empty()) {
+		ReplaySpoolWQ();
 		return;
+	}
 
 	Log(LogDebug, GetReflectionType()->GetName())
 		<< "Flushing data buffer to InfluxDB.";
 
-	String body = boost::algorithm::join(m_DataBuffer, "\n");
-	m_DataBuffer.clear();
+	std::vector<String> dataBuffer;
+	std::swap(dataBuffer, m_DataBuffer);
 	m_DataBufferSize = 0;
 
-	OptionalTlsStream stream;
-
 	try {
-		stream = Connect();
-	} catch (const std::exception& ex) {
-		Log(LogWarning, GetReflectionType()->GetName())
-			<< "Flush failed, cannot connect to InfluxDB: " << DiagnosticInformation(ex, false);
-		return;
+		if (!SendWQ(boost::algorithm::join(dataBuffer, "\n"))) {
+			SpoolWQ(dataBuffer);
+			return;
+		}
+	} catch (const std::exception&) {
+		SpoolWQ(dataBuffer);
+		throw;
 	}
 
-	Defer s ([&stream]() {
-		if (stream.first) {
-			stream.first->next_layer().shutdown();
-		}
-	});
+	ReplaySpoolWQ();
+}
+
+/**
+ * Sends data points to InfluxDB.
+ *
+ * @param body The data points in the line protocol
+ *
+ * @return false if InfluxDB isn't reachable
+ */
+bool InfluxdbCommonWriter::SendWQ(String body)
+{
+	namespace http = boost::beast::http;
 
 	auto request (AssembleRequest(std::move(body)));
+	HttpClient::Response response;
 
 	try {
-		if (stream.first) {
-			http::write(*stream.first, request);
-			stream.first->flush();
-		} else {
-			http::write(*stream.second, request);
-			stream.second->flush();
-		}
+		response = m_HttpClient->Send(request);
 	} catch (const std::exception& ex) {
 		Log(LogWarning, GetReflectionType()->GetName())
-			<< "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "'.";
-		throw;
-	}
+			<< "Flush failed, cannot send data to InfluxDB: " << DiagnosticInformation(ex, false);
 
-	http::parser<false, http::string_body> parser;
-	beast::flat_buffer buf;
-
-	try {
-		if (stream.first) {
-			http::read(*stream.first, buf, parser);
-		} else {
-			http::read(*stream.second, buf, parser);
-		}
-	} catch (const std::exception& ex) {
-		Log(LogWarning, GetReflectionType()->GetName())
-			<< "Failed to parse HTTP response from host '" << GetHost() << "' port '" << GetPort() << "': " << DiagnosticInformation(ex);
-		throw;
+		/* Don't try the next flush on another stale kept-alive connection. */
+		m_HttpClient->CloseIdleConnections();
+		return false;
 	}
 
-	auto& response (parser.get());
+	/* Server errors (e.g. 503 Service Unavailable from a proxy) are retried from the spool,
+	 * client errors are not, the data points would be rejected again.
+	 */
+	bool delivered = response.result_int() < 500;
 
 	if (response.result() != http::status::no_content) {
 		Log(LogWarning, GetReflectionType()->GetName())
@@ -511,7 +444,7 @@ void InfluxdbCommonWriter::FlushWQ()
 		if (contentType != "application/json") {
 			Log(LogWarning, GetReflectionType()->GetName())
 				<< "Unexpected Content-Type: " << contentType;
-			return;
+			return delivered;
 		}
 
 		Dictionary::Ptr jsonResponse;
@@ -522,7 +455,7 @@ void InfluxdbCommonWriter::FlushWQ()
 		} catch (...) {
 			Log(LogWarning, GetReflectionType()->GetName())
 				<< "Unable to parse JSON response:\n" << body;
-			return;
+			return delivered;
 		}
 
 		String error = jsonResponse->Get("error");
@@ -530,6 +463,41 @@ void InfluxdbCommonWriter::FlushWQ()
 		Log(LogCritical, GetReflectionType()->GetName())
 			<< "InfluxDB error message:\n" << error;
 	}
+
+	return delivered;
+}
+
+/**
+ * Stores data points which couldn't be sent in the spool, if enabled.
+ */
+void InfluxdbCommonWriter::SpoolWQ(const std::vector<String>& dataPoints)
+{
+	if (!m_Spool)
+		return;
+
+	m_Spool->Append(dataPoints);
+
+	Log(LogNotice, GetReflectionType()->GetName())
+		<< "Spooled " << dataPoints.size() << " data points, " << m_Spool->GetRecordCount() << " are waiting to be sent.";
+}
+
+/**
+ * Sends spooled data points, limited by spool_replay_rate.
+ */
+void InfluxdbCommonWriter::ReplaySpoolWQ()
+{
+	if (!m_Spool || m_Spool->IsEmpty())
+		return;
+
+	size_t replayed = m_Spool->Replay(GetFlushThreshold(), [this](const std::vector<String>& dataPoints) {
+		if (!SendWQ(boost::algorithm::join(dataPoints, "\n")))
+			BOOST_THROW_EXCEPTION(std::runtime_error("InfluxDB isn't reachable."));
+	});
+
+	if (replayed) {
+		Log(LogInformation, GetReflectionType()->GetName())
+			<< "Replayed " << replayed << " spooled data points, " << m_Spool->GetRecordCount() << " are left.";
+	}
 }
 
 boost::beast::http::request<boost::beast::http::string_body> InfluxdbCommonWriter::AssembleBaseRequest(String body)
@@ -4,13 +4,16 @@
 #define INFLUXDBCOMMONWRITER_H
 
 #include "perfdata/influxdbcommonwriter-ti.hpp"
+#include "perfdata/perfdataspool.hpp"
 #include "icinga/service.hpp"
 #include "base/configobject.hpp"
+#include "base/objectlock.hpp"
 #include "base/perfdatavalue.hpp"
 #include "base/tcpsocket.hpp"
 #include "base/timer.hpp"
 #include "base/tlsstream.hpp"
 #include "base/workqueue.hpp"
+#include "remote/httpclient.hpp"
 #include "remote/url.hpp"
 #include <boost/beast/http/message.hpp>
 #include <boost/beast/http/string_body.hpp>
@@ -52,6 +55,8 @@ private:
 	WorkQueue m_WorkQueue{10000000, 1};
 	std::vector<String> m_DataBuffer;
 	std::atomic_size_t m_DataBufferSize{0};
+	PerfdataSpool::Ptr m_Spool;
+	HttpClient::Ptr m_HttpClient;
 
 	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
 	void CheckResultHandlerWQ(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
@@ -60,12 +65,13 @@ private:
 	void FlushTimeout();
 	void FlushTimeoutWQ();
 	void FlushWQ();
+	bool SendWQ(String body);
+	void SpoolWQ(const std::vector<String>& dataPoints);
+	void ReplaySpoolWQ();
 
 	static String EscapeKeyOrTagValue(const String& str);
 	static String EscapeValue(const Value& value);
 
-	OptionalTlsStream Connect();
-
 	void AssertOnWorkQueue();
 
 	void ExceptionHandler(boost::exception_ptr exp);
@@ -81,16 +87,29 @@ void InfluxdbCommonWriter::StatsFunc(const Dictionary::Ptr& status, const Array:
 		size_t workQueueItems = influxwriter->m_WorkQueue.GetLength();
 		double workQueueItemRate = influxwriter->m_WorkQueue.GetTaskCount(60) / 60.0;
 		size_t dataBufferItems = influxwriter->m_DataBufferSize;
+		PerfdataSpool::Ptr spool;
+
+		{
+			ObjectLock olock(influxwriter);
+			spool = influxwriter->m_Spool;
+		}
+
+		size_t spoolItems = spool ? spool->GetRecordCount() : 0;
+		double spoolAge = spool ? spool->GetAge() : 0;
 
 		nodes.emplace_back(influxwriter->GetName(), new Dictionary({
 			{ "work_queue_items", workQueueItems },
 			{ "work_queue_item_rate", workQueueItemRate },
-			{ "data_buffer_items", dataBufferItems }
+			{ "data_buffer_items", dataBufferItems },
+			{ "spool_items", spoolItems },
+			{ "spool_age", spoolAge }
 		}));
 
 		perfdata->Add(new PerfdataValue(typeName + "_" + influxwriter->GetName() + "_work_queue_items", workQueueItems));
 		perfdata->Add(new PerfdataValue(typeName + "_" + influxwriter->GetName() + "_work_queue_item_rate", workQueueItemRate));
 		perfdata->Add(new PerfdataValue(typeName + "_" + influxwriter->GetName() + "_data_queue_items", dataBufferItems));
+		perfdata->Add(new PerfdataValue(typeName + "_" + influxwriter->GetName() + "_spool_items", spoolItems));
+		perfdata->Add(new PerfdataValue(typeName + "_" + influxwriter->GetName() + "_spool_age", spoolAge, false, "seconds"));
 	}
 
 	status->Set(typeName, new Dictionary(std::move(nodes)));
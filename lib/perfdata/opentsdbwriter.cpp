@@ -21,6 +21,9 @@
 #include "base/statsfunction.hpp"
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/write.hpp>
+#include <chrono>
 
 using namespace icinga;
 
@@ -28,6 +31,12 @@ REGISTER_TYPE(OpenTsdbWriter);
 
 REGISTER_STATSFUNCTION(OpenTsdbWriter, &OpenTsdbWriter::StatsFunc);
 
+/* Batches which may wait for a slow OpenTSDB TSD before being dropped. */
+static const size_t l_OpenTsdbMaxPendingBatches = 64;
+
+/* Dropped metrics are logged as warnings at most this often (in seconds), otherwise as notices. */
+static const double l_OpenTsdbDropWarningInterval = 60;
+
 /*
  * Enable HA capabilities once the config object is loaded.
  */
@@ -75,12 +84,20 @@ void OpenTsdbWriter::Resume()
 
 	ReadConfigTemplate(m_ServiceConfigTemplate, m_HostConfigTemplate);
 
+	if (!m_Strand)
+		m_Strand = Shared<boost::asio::io_context::strand>::Make(IoEngine::Get().GetIoContext());
+
 	m_ReconnectTimer = Timer::Create();
 	m_ReconnectTimer->SetInterval(10);
 	m_ReconnectTimer->OnTimerExpired.connect([this](const Timer * const&) { ReconnectTimerHandler(); });
 	m_ReconnectTimer->Start();
 	m_ReconnectTimer->Reschedule(0);
 
+	m_FlushTimer = Timer::Create();
+	m_FlushTimer->SetInterval(GetFlushInterval());
+	m_FlushTimer->OnTimerExpired.connect([this](const Timer * const&) { FlushTimeout(); });
+	m_FlushTimer->Start();
+
 	m_HandleCheckResults = Service::OnNewCheckResult.connect([this](const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const MessageOrigin::Ptr&) {
 		CheckResultHandler(checkable, cr);
 	});
@@ -93,12 +110,32 @@ void OpenTsdbWriter::Pause()
 {
 	m_HandleCheckResults.disconnect();
 	m_ReconnectTimer->Stop(true);
+	m_FlushTimer->Stop(true);
+
+	{
+		std::unique_lock<std::mutex> lock(m_DataBufferMutex);
+
+		Flush(lock);
+
+		if (!m_SendingCV.wait_for(lock, std::chrono::seconds(10), [this]() { return !m_Sending; })) {
+			Log(LogWarning, "OpenTsdbWriter")
+				<< "'" << GetName() << "' timed out waiting for pending metrics to be sent.";
+		}
+
+		if (m_Stream) {
+			auto stream (m_Stream);
+
+			/* Cancels pending writes, if any. */
+			boost::asio::post(*m_Strand, [stream]() {
+				boost::system::error_code ec;
+				stream->lowest_layer().close(ec);
+			});
+		}
+	}
 
 	Log(LogInformation, "OpentsdbWriter")
 		<< "'" << GetName() << "' paused.";
 
-	m_Stream->close();
-
 	SetConnected(false);
 
 	ObjectImpl<OpenTsdbWriter>::Pause();
@@ -127,10 +164,10 @@ void OpenTsdbWriter::ReconnectTimerHandler()
 	 * We're using telnet as input method. Future PRs may change this into using the HTTP API.
 	 * http://opentsdb.net/docs/build/html/user_guide/writing/index.html#telnet
 	 */
-	m_Stream = Shared<AsioTcpStream>::Make(IoEngine::Get().GetIoContext());
+	auto stream (Shared<AsioTcpStream>::Make(IoEngine::Get().GetIoContext()));
 
 	try {
-		icinga::Connect(m_Stream->lowest_layer(), GetHost(), GetPort());
+		icinga::Connect(stream->lowest_layer(), GetHost(), GetPort());
 	} catch (const std::exception& ex) {
 		Log(LogWarning, "OpenTsdbWriter")
 			<< "Can't connect to OpenTSDB on host '" << GetHost() << "' port '" << GetPort() << "'.";
@@ -140,6 +177,11 @@ void OpenTsdbWriter::ReconnectTimerHandler()
 		return;
 	}
 
+	{
+		std::unique_lock<std::mutex> lock(m_DataBufferMutex);
+		m_Stream = stream;
+	}
+
 	SetConnected(true);
 
 	Log(LogInformation, "OpenTsdbWriter")
@@ -301,29 +343,22 @@ void OpenTsdbWriter::CheckResultHandler(const Checkable::Ptr& checkable, const C
 void OpenTsdbWriter::SendPerfdata(const Checkable::Ptr& checkable, const String& metric,
 	const std::map<String, String>& tags, const CheckResult::Ptr& cr, double ts)
 {
-	Array::Ptr perfdata = cr->GetPerformanceData();
+	auto perfdata (cr->GetParsedPerformanceData());
 
-	if (!perfdata)
+	if (perfdata->empty())
 		return;
 
 	CheckCommand::Ptr checkCommand = checkable->GetCheckCommand();
 
-	ObjectLock olock(perfdata);
-	for (const Value& val : perfdata) {
-		PerfdataValue::Ptr pdv;
-
-		if (val.IsObjectType<PerfdataValue>())
-			pdv = val;
-		else {
-			try {
-				pdv = PerfdataValue::Parse(val);
-			} catch (const std::exception&) {
-				Log(LogWarning, "OpenTsdbWriter")
-					<< "Ignoring invalid perfdata for checkable '"
-					<< checkable->GetName() << "' and command '"
-					<< checkCommand->GetName() << "' with value: " << val;
-				continue;
-			}
+	for (const ParsedPerfdataValue& val : *perfdata) {
+		const PerfdataValue::Ptr& pdv = val.Parsed;
+
+		if (!pdv) {
+			Log(LogWarning, "OpenTsdbWriter")
+				<< "Ignoring invalid perfdata for checkable '"
+				<< checkable->GetName() << "' and command '"
+				<< checkCommand->GetName() << "' with value: " << val.Raw;
+			continue;
 		}
 		
 		String metric_name;
@@ -355,7 +390,7 @@ void OpenTsdbWriter::SendPerfdata(const Checkable::Ptr& checkable, const String&
 }
 
 /**
- * Send given metric to OpenTSDB
+ * Adds the given metric to the data buffer
  *
  * @param checkable Host/service object
  * @param metric Full metric name
@@ -385,22 +420,120 @@ void OpenTsdbWriter::SendMetric(const Checkable::Ptr& checkable, const String& m
 
 	/* do not send \n to debug log */
 	msgbuf << "\n";
-	String put = msgbuf.str();
 
-	ObjectLock olock(this);
+	std::unique_lock<std::mutex> lock(m_DataBufferMutex);
 
-	if (!GetConnected())
-		return;
+	m_DataBuffer.emplace_back(msgbuf.str());
 
-	try {
+	if (static_cast<int>(m_DataBuffer.size()) >= GetFlushThreshold()) {
 		Log(LogDebug, "OpenTsdbWriter")
-			<< "Checkable '" << checkable->GetName() << "' sending message '" << put << "'.";
+			<< "Data buffer overflow writing " << m_DataBuffer.size() << " metrics";
 
-		boost::asio::write(*m_Stream, boost::asio::buffer(msgbuf.str()));
-		m_Stream->flush();
-	} catch (const std::exception& ex) {
-		Log(LogCritical, "OpenTsdbWriter")
-			<< "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "'.";
+		Flush(lock);
+	}
+}
+
+/**
+ * Flush timer handler.
+ */
+void OpenTsdbWriter::FlushTimeout()
+{
+	std::unique_lock<std::mutex> lock(m_DataBufferMutex);
+
+	Flush(lock);
+}
+
+/**
+ * Hands the data buffer over to SendBatches() which writes it to the stream
+ * asynchronously, so that a slow TSD doesn't block the check result handlers.
+ *
+ * @param lock Lock on m_DataBufferMutex
+ */
+void OpenTsdbWriter::Flush(std::unique_lock<std::mutex>& lock)
+{
+	ASSERT(lock.owns_lock());
+
+	if (m_DataBuffer.empty())
+		return;
+
+	std::vector<String> metrics;
+	std::swap(metrics, m_DataBuffer);
+
+	if (!GetConnected() || m_SendQueue.size() >= l_OpenTsdbMaxPendingBatches) {
+		double now = Utility::GetTime();
+		bool warn = now - m_LastDropWarning >= l_OpenTsdbDropWarningInterval;
+
+		if (warn)
+			m_LastDropWarning = now;
+
+		Log(warn ? LogWarning : LogNotice, "OpenTsdbWriter")
+			<< "Dropping " << metrics.size() << " metrics, OpenTSDB on host '" << GetHost() << "' port '" << GetPort() << "' isn't available.";
+		return;
+	}
+
+	m_SendQueue.emplace_back(std::move(metrics));
+
+	if (!m_Sending) {
+		m_Sending = true;
+
+		IoEngine::SpawnCoroutine(*m_Strand, [this, keepAlive = OpenTsdbWriter::Ptr(this)](boost::asio::yield_context yc) {
+			SendBatches(yc);
+		});
+	}
+}
+
+/**
+ * Writes the queued batches to the stream until the queue is empty.
+ *
+ * Runs on the I/O engine. If writing fails, the stream is closed and
+ * all pending metrics are dropped.
+ *
+ * @param yc Yield context
+ */
+void OpenTsdbWriter::SendBatches(boost::asio::yield_context yc)
+{
+	namespace asio = boost::asio;
+
+	for (;;) {
+		std::vector<String> metrics;
+		Shared<AsioTcpStream>::Ptr stream;
+
+		{
+			std::unique_lock<std::mutex> lock(m_DataBufferMutex);
+
+			if (m_SendQueue.empty()) {
+				m_Sending = false;
+				m_SendingCV.notify_all();
+				return;
+			}
+
+			metrics = std::move(m_SendQueue.front());
+			m_SendQueue.pop_front();
+			stream = m_Stream;
+		}
+
+		String lines = boost::algorithm::join(metrics, "");
+
+		try {
+			asio::async_write(*stream, asio::buffer(lines.CStr(), lines.GetLength()), yc);
+			stream->async_flush(yc);
+		} catch (const std::exception& ex) {
+			Log(LogCritical, "OpenTsdbWriter")
+				<< "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "'.";
+
+			boost::system::error_code ec;
+			stream->lowest_layer().close(ec);
+
+			SetConnected(false);
+
+			std::unique_lock<std::mutex> lock(m_DataBufferMutex);
+
+			m_SendQueue.clear();
+			m_Sending = false;
+			m_SendingCV.notify_all();
+
+			return;
+		}
 	}
 }
 
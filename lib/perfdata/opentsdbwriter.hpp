@@ -6,9 +6,16 @@
 #include "perfdata/opentsdbwriter-ti.hpp"
 #include "icinga/service.hpp"
 #include "base/configobject.hpp"
+#include "base/io-engine.hpp"
 #include "base/tcpsocket.hpp"
 #include "base/timer.hpp"
+#include <boost/asio/io_context_strand.hpp>
+#include <boost/asio/spawn.hpp>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
+#include <mutex>
+#include <vector>
 
 namespace icinga
 {
@@ -36,9 +43,18 @@ protected:
 
 private:
 	Shared<AsioTcpStream>::Ptr m_Stream;
+	Shared<boost::asio::io_context::strand>::Ptr m_Strand;
+
+	std::mutex m_DataBufferMutex;
+	std::vector<String> m_DataBuffer;
+	std::deque<std::vector<String>> m_SendQueue;
+	bool m_Sending{false};
+	std::condition_variable m_SendingCV;
+	double m_LastDropWarning{0};
 
 	boost::signals2::connection m_HandleCheckResults;
 	Timer::Ptr m_ReconnectTimer;
+	Timer::Ptr m_FlushTimer;
 
 	Dictionary::Ptr m_ServiceConfigTemplate;
 	Dictionary::Ptr m_HostConfigTemplate;
@@ -53,6 +69,10 @@ private:
 
 	void ReconnectTimerHandler();
 
+	void FlushTimeout();
+	void Flush(std::unique_lock<std::mutex>& lock);
+	void SendBatches(boost::asio::yield_context yc);
+
 	void ReadConfigTemplate(const Dictionary::Ptr& stemplate, 
 		const Dictionary::Ptr& htemplate);
 };
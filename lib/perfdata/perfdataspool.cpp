@@ -0,0 +1,482 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "perfdata/perfdataspool.hpp"
+#include "base/atomic-file.hpp"
+#include "base/configuration.hpp"
+#include "base/defer.hpp"
+#include "base/exception.hpp"
+#include "base/logger.hpp"
+#include "base/type.hpp"
+#include "base/utility.hpp"
+#include <boost/filesystem/operations.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <sstream>
+#include <string>
+
+using namespace icinga;
+
+/**
+ * @param path The directory the segments are stored in
+ * @param maxSize The maximum size of all segments in bytes
+ * @param replayRate How many records per second Replay() may return, unlimited if not positive
+ */
+PerfdataSpool::PerfdataSpool(String path, uint64_t maxSize, double replayRate)
+	: m_Path(std::move(path)), m_MaxSize(maxSize), m_MaxSegmentSize(std::max<uint64_t>(maxSize / 16, 64 * 1024)),
+	m_ReplayRate(replayRate), m_ReplayBudget(0), m_LastReplay(Utility::GetTime())
+{
+	Load();
+}
+
+/**
+ * Opens the spool of a perfdata writer.
+ *
+ * @param writer The writer
+ * @param maxSize The maximum size of the spool in bytes
+ * @param replayRate How many records per second may be replayed
+ *
+ * @return The spool or nullptr if it couldn't be opened
+ */
+PerfdataSpool::Ptr PerfdataSpool::Create(const ConfigObject::Ptr& writer, double maxSize, double replayRate)
+{
+	String type = writer->GetReflectionType()->GetName();
+	String path = Configuration::SpoolDir + "/perfdata-spool/" + type.ToLower() + "-" + writer->GetName();
+
+	try {
+		PerfdataSpool::Ptr spool = new PerfdataSpool(path, std::max(maxSize, 0.0), replayRate);
+
+		if (!spool->IsEmpty()) {
+			Log(LogInformation, type)
+				<< "'" << writer->GetName() << "' has " << spool->GetRecordCount() << " spooled records to replay.";
+		}
+
+		return spool;
+	} catch (const std::exception& ex) {
+		Log(LogCritical, type)
+			<< "Can't open spool '" << path << "' of '" << writer->GetName() << "': " << DiagnosticInformation(ex, false);
+
+		return nullptr;
+	}
+}
+
+/**
+ * Appends records to the spool.
+ *
+ * If the spool exceeds its maximum size the oldest segments are dropped.
+ *
+ * @param records The records
+ */
+void PerfdataSpool::Append(const std::vector<String>& records)
+{
+	if (records.empty())
+		return;
+
+	std::unique_lock<std::mutex> lock (m_Mutex);
+
+	bool wasEmpty = m_Records == 0;
+	double now = Utility::GetTime();
+	char header[64];
+
+	for (const String& record : records) {
+		if (!m_Writer.is_open() || m_Segments.back().Size >= m_MaxSegmentSize)
+			OpenWriter();
+
+		int headerLength = snprintf(header, sizeof(header), "%.3f %zu\n", now, record.GetLength());
+
+		m_Writer.write(header, headerLength);
+		m_Writer.write(record.CStr(), record.GetLength());
+		m_Writer.put('\n');
+
+		uint64_t length = headerLength + record.GetLength() + 1;
+
+		m_Segments.back().Size += length;
+		m_Segments.back().Records++;
+		m_Size += length;
+		m_Records++;
+	}
+
+	m_Writer.flush();
+
+	if (!m_Writer) {
+		Log(LogCritical, "PerfdataSpool")
+			<< "Can't write to spool '" << m_Path << "', data may be lost.";
+
+		/* Start a new segment. */
+		m_Writer.close();
+	}
+
+	if (wasEmpty)
+		m_OldestTimestamp = now;
+
+	size_t dropped = 0;
+
+	while (m_Size > m_MaxSize && m_Segments.size() > 1) {
+		dropped += m_Segments.front().Records;
+		RemoveFrontSegment();
+	}
+
+	if (dropped) {
+		Log(LogWarning, "PerfdataSpool")
+			<< "Spool '" << m_Path << "' exceeded its maximum size of " << m_MaxSize << " bytes, dropped the oldest " << dropped << " records.";
+
+		UpdateOldestTimestamp();
+	}
+}
+
+/**
+ * Replays the oldest records, at most as many as the replay rate allows since the last call.
+ *
+ * The callback is called without holding the spool's lock, so Append() doesn't wait for it.
+ * Records are only removed from the spool once they've been sent. If sending them fails,
+ * i.e. the callback throws, they stay in the spool and the exception is passed to the caller.
+ * While one thread replays, Replay() returns 0 in all other threads.
+ *
+ * @param batchSize The maximum number of records to send at once
+ * @param send Sends a batch of records
+ *
+ * @return The number of records which have been sent
+ */
+size_t PerfdataSpool::Replay(size_t batchSize, const SendCallback& send)
+{
+	std::unique_lock<std::mutex> lock (m_Mutex);
+
+	/* Otherwise the same records would be sent twice. */
+	if (m_Replaying)
+		return 0;
+
+	m_Replaying = true;
+
+	Defer stopReplaying ([this, &lock]() {
+		if (!lock.owns_lock())
+			lock.lock();
+
+		m_Replaying = false;
+	});
+
+	double now = Utility::GetTime();
+
+	if (m_ReplayRate > 0) {
+		/* Allow a burst of up to a minute, the writers replay once per flush interval. */
+		m_ReplayBudget = std::min(m_ReplayBudget + (now - m_LastReplay) * m_ReplayRate, m_ReplayRate * 60);
+	} else {
+		m_ReplayBudget = std::numeric_limits<double>::infinity();
+	}
+
+	m_LastReplay = now;
+
+	/* Records which are appended while sending are left for the next call. */
+	size_t pending = m_Records;
+	size_t replayed = 0;
+
+	while (!m_Segments.empty() && m_ReplayBudget >= 1 && replayed < pending) {
+		Segment& segment = m_Segments.front();
+
+		if (segment.Records == 0) {
+			RemoveFrontSegment();
+			continue;
+		}
+
+		size_t limit = std::max<size_t>(std::min<double>(std::min({ batchSize, segment.Records, pending - replayed }), m_ReplayBudget), 1);
+		std::vector<String> records;
+		uint64_t segmentId = segment.Id;
+		uint64_t offset = m_ReadOffset;
+
+		{
+			std::ifstream fp (GetSegmentPath(segment.Id).CStr(), std::ifstream::in | std::ifstream::binary);
+			fp.seekg(offset);
+
+			while (records.size() < limit) {
+				double ts;
+				uint64_t length;
+
+				/* A record can't be larger than what's left of its segment. */
+				if (!ReadRecordHeader(fp, ts, length, segment.Size - offset))
+					break;
+
+				std::string record (length, '\0');
+				fp.read(&record[0], length);
+
+				if (!fp || fp.get() != '\n')
+					break;
+
+				records.emplace_back(std::move(record));
+				offset = fp.tellg();
+			}
+		}
+
+		/* The next record is corrupt. Its length can't be trusted, so neither can anything behind it. */
+		if (records.empty()) {
+			Log(LogWarning, "PerfdataSpool")
+				<< "Discarding " << segment.Records << " records behind a corrupt record in '" << GetSegmentPath(segment.Id) << "'.";
+
+			m_Records -= segment.Records;
+			segment.Records = 0;
+			continue;
+		}
+
+		lock.unlock();
+		send(records);
+		lock.lock();
+
+		m_ReplayBudget -= records.size();
+		replayed += records.size();
+
+		/* Append() may have dropped the segment in the meantime. */
+		if (m_Segments.empty() || m_Segments.front().Id != segmentId)
+			continue;
+
+		Segment& sent = m_Segments.front();
+
+		m_ReadOffset = offset;
+		sent.Records -= records.size();
+		m_Records -= records.size();
+
+		if (sent.Records == 0)
+			RemoveFrontSegment();
+
+		SaveReadOffset();
+	}
+
+	if (replayed)
+		UpdateOldestTimestamp();
+
+	return replayed;
+}
+
+bool PerfdataSpool::IsEmpty() const
+{
+	return m_Records == 0;
+}
+
+size_t PerfdataSpool::GetRecordCount() const
+{
+	return m_Records;
+}
+
+uint64_t PerfdataSpool::GetSize() const
+{
+	return m_Size;
+}
+
+/**
+ * Returns how long the oldest record has been waiting, 0 if the spool is empty.
+ */
+double PerfdataSpool::GetAge() const
+{
+	double oldest = m_OldestTimestamp;
+
+	if (m_Records == 0 || oldest == 0)
+		return 0;
+
+	return std::max(Utility::GetTime() - oldest, 0.0);
+}
+
+void PerfdataSpool::Load()
+{
+	Utility::MkDirP(m_Path, 0750);
+
+	std::vector<uint64_t> ids;
+
+	Utility::Glob(m_Path + "/*.seg", [&ids](const String& path) {
+		String name = Utility::BaseName(path);
+
+		try {
+			ids.push_back(std::stoull(name.SubStr(0, name.GetLength() - 4)));
+		} catch (const std::exception&) {
+			/* Not one of ours. */
+		}
+	}, GlobFile);
+
+	std::sort(ids.begin(), ids.end());
+
+	uint64_t readId = 0, readOffset = 0;
+
+	{
+		std::ifstream fp (GetReadOffsetPath().CStr());
+
+		if (!(fp >> readId >> readOffset))
+			readId = readOffset = 0;
+	}
+
+	for (uint64_t id : ids) {
+		m_NextSegmentId = id + 1;
+
+		/* Has been replayed completely. */
+		if (id < readId) {
+			boost::system::error_code ec;
+			boost::filesystem::remove(GetSegmentPath(id).CStr(), ec);
+			continue;
+		}
+
+		Segment segment { id, 0, 0 };
+		bool last = id == ids.back();
+
+		ScanSegment(segment, id == readId ? readOffset : 0, last);
+
+		if (segment.Records == 0 && !last) {
+			boost::system::error_code ec;
+			boost::filesystem::remove(GetSegmentPath(id).CStr(), ec);
+			continue;
+		}
+
+		if (m_Segments.empty() && id == readId)
+			m_ReadOffset = readOffset;
+
+		m_Segments.push_back(segment);
+		m_Size += segment.Size;
+		m_Records += segment.Records;
+	}
+
+	m_NextSegmentId = std::max(m_NextSegmentId, readId);
+
+	UpdateOldestTimestamp();
+}
+
+/**
+ * Counts the records of a segment.
+ *
+ * @param segment The segment
+ * @param offset Only records after this offset are counted
+ * @param truncate Whether to cut off an incompletely written record at the end
+ */
+void PerfdataSpool::ScanSegment(Segment& segment, uint64_t offset, bool truncate)
+{
+	String path = GetSegmentPath(segment.Id);
+	uint64_t position = 0;
+
+	{
+		std::ifstream fp (path.CStr(), std::ifstream::in | std::ifstream::binary);
+
+		for (;;) {
+			double ts;
+			uint64_t length;
+
+			if (!ReadRecordHeader(fp, ts, length, std::numeric_limits<uint64_t>::max()))
+				break;
+
+			fp.seekg(length, std::ifstream::cur);
+
+			if (!fp || fp.get() != '\n')
+				break;
+
+			position = fp.tellg();
+
+			if (position > offset)
+				segment.Records++;
+		}
+	}
+
+	segment.Size = position;
+
+	if (truncate) {
+		boost::system::error_code ec;
+		uint64_t size = boost::filesystem::file_size(path.CStr(), ec);
+
+		if (!ec && size > position) {
+			Log(LogWarning, "PerfdataSpool")
+				<< "Truncating incomplete record at the end of '" << path << "'.";
+
+			boost::filesystem::resize_file(path.CStr(), position);
+		}
+	}
+}
+
+void PerfdataSpool::OpenWriter()
+{
+	m_Writer.close();
+
+	if (m_Segments.empty() || m_Segments.back().Size >= m_MaxSegmentSize)
+		m_Segments.push_back({ m_NextSegmentId++, 0, 0 });
+
+	m_Writer.clear();
+	m_Writer.open(GetSegmentPath(m_Segments.back().Id).CStr(), std::ofstream::out | std::ofstream::app | std::ofstream::binary);
+}
+
+void PerfdataSpool::RemoveFrontSegment()
+{
+	Segment& segment = m_Segments.front();
+
+	if (m_Segments.size() == 1)
+		m_Writer.close();
+
+	boost::system::error_code ec;
+	boost::filesystem::remove(GetSegmentPath(segment.Id).CStr(), ec);
+
+	m_Size -= segment.Size;
+	m_Records -= segment.Records;
+	m_Segments.pop_front();
+	m_ReadOffset = 0;
+}
+
+void PerfdataSpool::SaveReadOffset()
+{
+	std::ostringstream msgbuf;
+
+	if (m_Segments.empty())
+		msgbuf << m_NextSegmentId << " 0\n";
+	else
+		msgbuf << m_Segments.front().Id << " " << m_ReadOffset << "\n";
+
+	try {
+		AtomicFile::Write(GetReadOffsetPath(), 0640, msgbuf.str());
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "PerfdataSpool")
+			<< "Can't save replay position of spool '" << m_Path << "': " << DiagnosticInformation(ex, false);
+	}
+}
+
+void PerfdataSpool::UpdateOldestTimestamp()
+{
+	for (auto& segment : m_Segments) {
+		if (segment.Records == 0)
+			continue;
+
+		std::ifstream fp (GetSegmentPath(segment.Id).CStr(), std::ifstream::in | std::ifstream::binary);
+
+		if (&segment == &m_Segments.front())
+			fp.seekg(m_ReadOffset);
+
+		double ts;
+		uint64_t length;
+
+		if (ReadRecordHeader(fp, ts, length, std::numeric_limits<uint64_t>::max())) {
+			m_OldestTimestamp = ts;
+			return;
+		}
+	}
+
+	m_OldestTimestamp = 0;
+}
+
+String PerfdataSpool::GetSegmentPath(uint64_t id) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llu.seg", static_cast<unsigned long long>(id));
+
+	return m_Path + "/" + name;
+}
+
+String PerfdataSpool::GetReadOffsetPath() const
+{
+	return m_Path + "/replay-position";
+}
+
+/**
+ * Reads the "<timestamp> <length>" line which precedes each record.
+ *
+ * @param maxLength Records longer than this are treated as corrupt
+ *
+ * @return Whether a valid header has been read
+ */
+bool PerfdataSpool::ReadRecordHeader(std::istream& fp, double& ts, uint64_t& length, uint64_t maxLength)
+{
+	std::string line;
+
+	if (!std::getline(fp, line) || fp.eof())
+		return false;
+
+	std::istringstream header (line);
+
+	return (header >> ts >> length) && length <= maxLength;
+}
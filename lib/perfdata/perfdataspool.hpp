@@ -0,0 +1,90 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef PERFDATASPOOL_H
+#define PERFDATASPOOL_H
+
+#include "base/configobject.hpp"
+#include "base/object.hpp"
+#include "base/string.hpp"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * An append-only on-disk queue which keeps the data of a perfdata writer
+ * while its backend is unavailable.
+ *
+ * Records are appended to numbered segment files. Segments are deleted once
+ * they've been replayed, or, if the spool exceeds its maximum size, dropped
+ * starting with the oldest one.
+ *
+ * @ingroup perfdata
+ */
+class PerfdataSpool final : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(PerfdataSpool);
+
+	typedef std::function<void(const std::vector<String>& records)> SendCallback;
+
+	PerfdataSpool(String path, uint64_t maxSize, double replayRate);
+
+	static PerfdataSpool::Ptr Create(const ConfigObject::Ptr& writer, double maxSize, double replayRate);
+
+	void Append(const std::vector<String>& records);
+	size_t Replay(size_t batchSize, const SendCallback& send);
+
+	bool IsEmpty() const;
+	size_t GetRecordCount() const;
+	uint64_t GetSize() const;
+	double GetAge() const;
+
+private:
+	struct Segment
+	{
+		uint64_t Id;
+		uint64_t Size;
+		size_t Records; /* not yet replayed */
+	};
+
+	std::mutex m_Mutex;
+	String m_Path;
+	uint64_t m_MaxSize;
+	uint64_t m_MaxSegmentSize;
+	double m_ReplayRate;
+	double m_ReplayBudget;
+	double m_LastReplay;
+
+	std::deque<Segment> m_Segments;
+	std::ofstream m_Writer;
+	uint64_t m_ReadOffset{0}; /* in m_Segments.front() */
+	uint64_t m_NextSegmentId{0};
+	bool m_Replaying{false};
+
+	std::atomic<uint64_t> m_Size{0};
+	std::atomic<size_t> m_Records{0};
+	std::atomic<double> m_OldestTimestamp{0};
+
+	void Load();
+	void ScanSegment(Segment& segment, uint64_t offset, bool truncate);
+	void OpenWriter();
+	void RemoveFrontSegment();
+	void SaveReadOffset();
+	void UpdateOldestTimestamp();
+
+	String GetSegmentPath(uint64_t id) const;
+	String GetReadOffsetPath() const;
+
+	static bool ReadRecordHeader(std::istream& fp, double& ts, uint64_t& length, uint64_t maxLength);
+};
+
+}
+
+#endif /* PERFDATASPOOL_H */
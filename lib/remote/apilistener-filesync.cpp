@@ -9,159 +9,277 @@
 #include "base/logger.hpp"
 #include "base/convert.hpp"
 #include "base/application.hpp"
+#include "base/configuration.hpp"
 #include "base/exception.hpp"
 #include "base/shared.hpp"
 #include "base/utility.hpp"
+#include <boost/filesystem/operations.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <cmath>
 #include <fstream>
 #include <iomanip>
 #include <thread>
+#include <utf8.h>
 
 using namespace icinga;
 
 REGISTER_APIFUNCTION(Update, config, &ApiListener::ConfigUpdateHandler);
+REGISTER_APIFUNCTION(Checksums, config, &ApiListener::ConfigChecksumsHandler);
 
 std::mutex ApiListener::m_ConfigSyncStageLock;
 
+std::mutex ApiListener::m_ConfigChecksumCacheMutex;
+std::unordered_map<String, ApiListener::ConfigFileChecksum> ApiListener::m_ConfigChecksumCache;
+bool ApiListener::m_ConfigChecksumCacheDirty = false;
+
 /**
  * Entrypoint for updating all authoritative configs from /etc/zones.d, packages, etc.
  * into var/lib/icinga2/api/zones
  */
 void ApiListener::SyncLocalZoneDirs() const
 {
+	LoadConfigChecksumCache();
+
+	// The zones are synced one after another, their files in parallel.
+	WorkQueue upq (25000, Configuration::Concurrency, LogNotice);
+	upq.SetName("ApiListener, SyncLocalZoneDirs");
+
 	for (const Zone::Ptr& zone : ConfigType::GetObjectsByType<Zone>()) {
 		try {
-			SyncLocalZoneDir(zone);
+			SyncLocalZoneDir(zone, upq);
 		} catch (const std::exception&) {
 			continue;
 		}
 	}
+
+	SaveConfigChecksumCache();
+}
+
+/**
+ * Calls a function for each of the given config files and rethrows its first exception.
+ *
+ * @param upq Calls the function in parallel if given, otherwise one file after another.
+ * @param files Full file names.
+ * @param func The function.
+ */
+template<typename Func>
+static void ForEachConfigFile(WorkQueue *upq, const std::vector<String>& files, const Func& func)
+{
+	if (!upq) {
+		for (const String& file : files)
+			func(file);
+
+		return;
+	}
+
+	// The queue may be shared with previous calls, their exceptions have already been handled.
+	size_t handledExceptions = upq->GetExceptions().size();
+
+	upq->ParallelFor(files, func);
+	upq->Join();
+
+	auto exceptions (upq->GetExceptions());
+
+	for (size_t i = handledExceptions; i < exceptions.size(); i++) {
+		if (exceptions[i])
+			boost::rethrow_exception(exceptions[i]);
+	}
+}
+
+/**
+ * Reads a whole file via mmap(2) which is way faster than via a std::ifstream.
+ *
+ * @param file Full file name.
+ * @param content The file's content.
+ * @returns Whether the file could be read.
+ */
+static bool ReadConfigFile(const String& file, String& content)
+{
+	namespace fs = boost::filesystem;
+
+	boost::system::error_code ec;
+	auto size (fs::file_size(fs::path(file.Begin(), file.End()), ec));
+
+	if (ec)
+		return false;
+
+	// Empty files can't be mapped.
+	if (!size) {
+		content = String();
+		return true;
+	}
+
+	try {
+		boost::iostreams::mapped_file_source mapping (file.GetData());
+
+		content = String(mapping.data(), mapping.data() + mapping.size());
+	} catch (const std::exception&) {
+		return false;
+	}
+
+	return true;
 }
 
 /**
  * Sync a zone directory where we have an authoritative copy (zones.d, packages, etc.)
  *
  * This function collects the registered zone config dirs from
- * the config compiler and reads the file content into the config
- * information structure.
+ * the config compiler and compares their files' checksums with
+ * the ones of the production directory. Only changed files are
+ * read and copied, removed files are deleted.
  *
  * Returns early when there are no updates.
  *
  * @param zone Pointer to the zone object being synced.
+ * @param upq Reads and copies the files in parallel.
  */
-void ApiListener::SyncLocalZoneDir(const Zone::Ptr& zone) const
+void ApiListener::SyncLocalZoneDir(const Zone::Ptr& zone, WorkQueue& upq) const
 {
 	if (!zone)
 		return;
 
-	ConfigDirInformation newConfigInfo;
-	newConfigInfo.UpdateV1 = new Dictionary();
-	newConfigInfo.UpdateV2 = new Dictionary();
-	newConfigInfo.Checksums = new Dictionary();
+	Dictionary::Ptr newChecksums = new Dictionary();
+	std::map<String, String> sourceFiles;
 
 	String zoneName = zone->GetName();
 
 	// Load registered zone paths, e.g. '_etc', '_api' and user packages.
 	for (const ZoneFragment& zf : ConfigCompiler::GetZoneDirs(zoneName)) {
-		ConfigDirInformation newConfigPart = LoadConfigDir(zf.Path);
-
-		// Config files '*.conf'.
-		{
-			ObjectLock olock(newConfigPart.UpdateV1);
-			for (const Dictionary::Pair& kv : newConfigPart.UpdateV1) {
-				String path = "/" + zf.Tag + kv.first;
-
-				newConfigInfo.UpdateV1->Set(path, kv.second);
-				newConfigInfo.Checksums->Set(path, GetChecksum(kv.second));
-			}
-		}
+		Dictionary::Ptr checksums = LoadConfigDirChecksums(zf.Path, &upq);
 
-		// Meta files.
-		{
-			ObjectLock olock(newConfigPart.UpdateV2);
-			for (const Dictionary::Pair& kv : newConfigPart.UpdateV2) {
-				String path = "/" + zf.Tag + kv.first;
+		ObjectLock olock(checksums);
+		for (const Dictionary::Pair& kv : checksums) {
+			String path = "/" + zf.Tag + kv.first;
 
-				newConfigInfo.UpdateV2->Set(path, kv.second);
-				newConfigInfo.Checksums->Set(path, GetChecksum(kv.second));
-			}
+			newChecksums->Set(path, kv.second);
+			sourceFiles[path] = zf.Path + kv.first;
 		}
 	}
 
-	size_t sumUpdates = newConfigInfo.UpdateV1->GetLength() + newConfigInfo.UpdateV2->GetLength();
-
 	// Return early if there are no updates.
-	if (sumUpdates == 0)
+	if (sourceFiles.empty())
 		return;
 
 	String productionZonesDir = GetApiZonesDir() + zoneName;
+	String tsPath = productionZonesDir + "/.timestamp";
+	String authPath = productionZonesDir + "/.authoritative";
+	String checksumsPath = productionZonesDir + "/.checksums";
+
+	// The checksums of what we've copied the last time.
+	Dictionary::Ptr oldChecksums;
+
+	try {
+		if (Utility::PathExists(checksumsPath))
+			oldChecksums = Utility::LoadJsonFile(checksumsPath);
+	} catch (const std::exception&) {
+	}
+
+	// Without them we don't know what to delete, so we start from scratch.
+	bool purge = !oldChecksums;
+
+	if (purge)
+		oldChecksums = new Dictionary();
+
+	std::vector<String> changedFiles, removedFiles;
+
+	for (auto& kv : sourceFiles) {
+		if (oldChecksums->Get(kv.first) != newChecksums->Get(kv.first) || !Utility::PathExists(productionZonesDir + kv.first))
+			changedFiles.emplace_back(kv.first);
+	}
+
+	{
+		ObjectLock olock(oldChecksums);
+		for (const Dictionary::Pair& kv : oldChecksums) {
+			if (!newChecksums->Contains(kv.first) && !Utility::Match("/.*", kv.first))
+				removedFiles.emplace_back(kv.first);
+		}
+	}
+
+	if (!purge && changedFiles.empty() && removedFiles.empty() && Utility::PathExists(tsPath) && Utility::PathExists(authPath)) {
+		Log(LogInformation, "ApiListener")
+			<< "Zone configuration files for zone '" << zoneName << "' in '" << productionZonesDir << "' are up to date.";
+		return;
+	}
 
 	Log(LogInformation, "ApiListener")
-		<< "Copying " << sumUpdates << " zone configuration files for zone '" << zoneName << "' to '" << productionZonesDir << "'.";
+		<< "Copying " << changedFiles.size() << " and removing " << removedFiles.size()
+		<< " zone configuration files for zone '" << zoneName << "' to '" << productionZonesDir << "'.";
 
-	// Purge files to allow deletion via zones.d.
-	if (Utility::PathExists(productionZonesDir))
+	if (purge && Utility::PathExists(productionZonesDir))
 		Utility::RemoveDirRecursive(productionZonesDir);
 
 	Utility::MkDirP(productionZonesDir, 0700);
 
-	// Copy content and add additional meta data.
-	size_t numBytes = 0;
+	// Allow deletion via zones.d.
+	for (const String& path : removedFiles) {
+		String dst = productionZonesDir + path;
+
+		Log(LogInformation, "ApiListener")
+			<< "Removing configuration file: " << dst;
+
+		if (Utility::PathExists(dst))
+			Utility::Remove(dst);
+	}
 
 	/* Note: We cannot simply copy directories here.
 	 *
-	 * Zone directories are registered from everywhere and we already
-	 * have read their content into memory with LoadConfigDir().
+	 * Zone directories are registered from everywhere, so we copy file by file.
 	 */
-	Dictionary::Ptr newConfig = MergeConfigUpdate(newConfigInfo);
+	ForEachConfigFile(&upq, changedFiles, [&sourceFiles, &newChecksums, &productionZonesDir](const String& path) {
+		ConfigDirInformation config;
+		config.UpdateV1 = new Dictionary();
+		config.UpdateV2 = new Dictionary();
+		config.Checksums = new Dictionary();
 
-	{
-		ObjectLock olock(newConfig);
+		String src = sourceFiles.at(path);
+		ConfigGlobHandler(config, Utility::DirName(src), src, nullptr);
 
-		for (const Dictionary::Pair& kv : newConfig) {
-			String dst = productionZonesDir + "/" + kv.first;
+		String relativePath = "/" + Utility::BaseName(src);
+		Dictionary::Ptr update = MergeConfigUpdate(config);
 
-			Utility::MkDirP(Utility::DirName(dst), 0755);
+		// The file has been changed or removed since we've calculated its checksum.
+		if (!update->Contains(relativePath)) {
+			newChecksums->Remove(path);
+			return;
+		}
 
-			Log(LogInformation, "ApiListener")
-				<< "Updating configuration file: " << dst;
+		String content = update->Get(relativePath);
 
-			String content = kv.second;
+		newChecksums->Set(path, config.Checksums->Get(relativePath));
 
-			std::ofstream fp(dst.CStr(), std::ofstream::out | std::ostream::binary | std::ostream::trunc);
+		String dst = productionZonesDir + path;
 
-			fp << content;
-			fp.close();
+		Utility::MkDirP(Utility::DirName(dst), 0755);
 
-			numBytes += content.GetLength();
-		}
-	}
+		Log(LogInformation, "ApiListener")
+			<< "Updating configuration file: " << dst;
 
-	// Additional metadata.
-	String tsPath = productionZonesDir + "/.timestamp";
+		std::ofstream fp(dst.CStr(), std::ofstream::out | std::ostream::binary | std::ostream::trunc);
 
-	if (!Utility::PathExists(tsPath)) {
+		fp << content;
+		fp.close();
+	});
+
+	// Additional metadata. A new timestamp makes the clients compare the checksums.
+	{
 		std::ofstream fp(tsPath.CStr(), std::ofstream::out | std::ostream::trunc);
 
 		fp << std::fixed << Utility::GetTime();
 		fp.close();
 	}
 
-	String authPath = productionZonesDir + "/.authoritative";
-
 	if (!Utility::PathExists(authPath)) {
 		std::ofstream fp(authPath.CStr(), std::ofstream::out | std::ostream::trunc);
 		fp.close();
 	}
 
 	// Checksums.
-	String checksumsPath = productionZonesDir + "/.checksums";
-
 	if (Utility::PathExists(checksumsPath))
 		Utility::Remove(checksumsPath);
 
 	std::ofstream fp(checksumsPath.CStr(), std::ofstream::out | std::ostream::trunc);
 
-	fp << std::fixed << JsonEncode(newConfigInfo.Checksums);
+	fp << std::fixed << JsonEncode(newChecksums);
 	fp.close();
 
 	Log(LogNotice, "ApiListener")
@@ -175,9 +293,15 @@ void ApiListener::SyncLocalZoneDir(const Zone::Ptr& zone) const
  * Loads the zone config files where this client belongs to
  * and sends the 'config::Update' JSON-RPC message.
  *
+ * Files the client already has are left out, only their checksums are sent.
+ * The client takes their content from its production directory.
+ *
+ * This runs concurrently for all clients, so each one's files are read one after another.
+ *
  * @param aclient Connected JSON-RPC client.
+ * @param knownChecksums Checksums of the client's files by zone, see SendConfigChecksums().
  */
-void ApiListener::SendConfigUpdate(const JsonRpcConnection::Ptr& aclient)
+void ApiListener::SendConfigUpdate(const JsonRpcConnection::Ptr& aclient, const Dictionary::Ptr& knownChecksums)
 {
 	Endpoint::Ptr endpoint = aclient->GetEndpoint();
 	ASSERT(endpoint);
@@ -207,12 +331,18 @@ void ApiListener::SendConfigUpdate(const JsonRpcConnection::Ptr& aclient)
 		if (!Utility::PathExists(zoneDir))
 			continue;
 
+		Dictionary::Ptr zoneChecksums;
+
+		if (knownChecksums)
+			zoneChecksums = knownChecksums->Get(zoneName);
+
+		ConfigDirInformation config = LoadConfigDir(zoneDir, zoneChecksums);
+
 		Log(LogInformation, "ApiListener")
-			<< "Syncing configuration files for " << (zone->IsGlobal() ? "global " : "")
+			<< "Syncing " << (config.UpdateV1->GetLength() + config.UpdateV2->GetLength()) << " of "
+			<< config.Checksums->GetLength() << " configuration files for " << (zone->IsGlobal() ? "global " : "")
 			<< "zone '" << zoneName << "' to endpoint '" << endpoint->GetName() << "'.";
 
-		ConfigDirInformation config = LoadConfigDir(zoneDir);
-
 		configUpdateV1->Set(zoneName, config.UpdateV1);
 		configUpdateV2->Set(zoneName, config.UpdateV2);
 		configUpdateChecksums->Set(zoneName, config.Checksums); // new since 2.11
@@ -229,6 +359,104 @@ void ApiListener::SendConfigUpdate(const JsonRpcConnection::Ptr& aclient)
 	});
 
 	aclient->SendMessage(message);
+
+	SaveConfigChecksumCache();
+}
+
+/**
+ * Sends the checksums of our production zone config files to an endpoint which may send us config updates
+ * via the 'config::Checksums' JSON-RPC message. In response it sends a 'config::Update' with only the changed files.
+ * Like SendConfigUpdate(), this runs concurrently for all clients, so the files are hashed one after another.
+ *
+ * @param aclient Connected JSON-RPC client.
+ */
+void ApiListener::SendConfigChecksums(const JsonRpcConnection::Ptr& aclient)
+{
+	Dictionary::Ptr checksums = new Dictionary();
+	String zonesDir = GetApiZonesDir();
+
+	for (const Zone::Ptr& zone : ConfigType::GetObjectsByType<Zone>()) {
+		String zoneName = zone->GetName();
+		String zoneDir = zonesDir + zoneName;
+
+		if (ConfigCompiler::HasZoneConfigAuthority(zoneName) || !Utility::PathExists(zoneDir))
+			continue;
+
+		checksums->Set(zoneName, LoadConfigDirChecksums(zoneDir));
+	}
+
+	aclient->SendMessage(new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "config::Checksums" },
+		{ "params", new Dictionary({
+			{ "checksums", checksums }
+		}) }
+	}));
+
+	SaveConfigChecksumCache();
+}
+
+/**
+ * Asks an endpoint which has sent us a delta config update we couldn't complete
+ * for all zone config files via the 'config::Checksums' JSON-RPC message.
+ *
+ * @param aclient Connected JSON-RPC client.
+ */
+void ApiListener::RequestFullConfigUpdate(const JsonRpcConnection::Ptr& aclient)
+{
+	aclient->SendMessage(new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "config::Checksums" },
+		{ "params", new Dictionary({
+			{ "full_update", true }
+		}) }
+	}));
+}
+
+/**
+ * Registered handler when a new config::Checksums message is received.
+ *
+ * Sends the config files which differ from the endpoint's ones, unless all of them have already been sent.
+ * If the endpoint requests a full update, all files are sent once more.
+ *
+ * @param origin Where this message came from.
+ * @param params Message parameters including the checksums.
+ * @returns Empty, required by the interface.
+ */
+Value ApiListener::ConfigChecksumsHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	auto client (origin->FromClient);
+
+	if (!client || !client->GetEndpoint())
+		return Empty;
+
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	if (!listener) {
+		Log(LogCritical, "ApiListener", "No instance available.");
+		return Empty;
+	}
+
+	Dictionary::Ptr checksums;
+
+	if (params->Get("full_update").ToBool()) {
+		if (!client->MarkFullConfigUpdateSent())
+			return Empty;
+
+		Log(LogInformation, "ApiListener")
+			<< "Endpoint '" << client->GetEndpoint()->GetName() << "' requested a full config update.";
+	} else {
+		if (!client->MarkConfigUpdateSent())
+			return Empty;
+
+		checksums = params->Get("checksums");
+	}
+
+	Utility::QueueAsyncCallback([listener, client, checksums]() {
+		listener->SendConfigUpdate(client, checksums);
+	});
+
+	return Empty;
 }
 
 static bool CompareTimestampsConfigChange(const Dictionary::Ptr& productionConfig, const Dictionary::Ptr& receivedConfig,
@@ -370,6 +598,13 @@ void ApiListener::HandleConfigUpdate(const MessageOrigin::Ptr& origin, const Dic
 	// Analyse and process the update.
 	size_t count = 0;
 
+	// A delta update we can't complete can't be validated either, as the stage replaces all zones.
+	bool incomplete = false;
+
+	// The zones are loaded one after another, their files in parallel.
+	WorkQueue upq (25000, Configuration::Concurrency, LogNotice);
+	upq.SetName("ApiListener, HandleConfigUpdate");
+
 	ObjectLock olock(updateV1);
 
 	for (const Dictionary::Pair& kv : updateV1) {
@@ -415,7 +650,19 @@ void ApiListener::HandleConfigUpdate(const MessageOrigin::Ptr& origin, const Dic
 			newConfigInfo.Checksums = checksums->Get(kv.first);
 
 		// Load the current production config details.
-		ConfigDirInformation productionConfigInfo = LoadConfigDir(productionConfigZoneDir);
+		ConfigDirInformation productionConfigInfo = LoadConfigDir(productionConfigZoneDir, nullptr, &upq);
+
+		String mismatchedFile;
+
+		if (!CompleteConfigUpdate(newConfigInfo, productionConfigInfo, mismatchedFile)) {
+			Log(LogWarning, "ApiListener")
+				<< "Received no content for file '" << mismatchedFile << "' of zone '" << zoneName
+				<< "' from endpoint '" << fromEndpointName << "' and our copy doesn't match its checksum."
+				<< " Discarding the config update and requesting a full one.";
+
+			incomplete = true;
+			break;
+		}
 
 		// Merge updateV1 and updateV2
 		Dictionary::Ptr productionConfig = MergeConfigUpdate(productionConfigInfo);
@@ -531,6 +778,11 @@ void ApiListener::HandleConfigUpdate(const MessageOrigin::Ptr& origin, const Dic
 		count++;
 	}
 
+	if (incomplete) {
+		RequestFullConfigUpdate(origin->FromClient);
+		return;
+	}
+
 	/*
 	 * We have processed all configuration files and stored them in the staging directory.
 	 *
@@ -790,59 +1042,141 @@ bool ApiListener::CheckConfigChange(const ConfigDirInformation& oldConfig, const
  * Load the given config dir and read their file content into the config structure.
  *
  * @param dir Path to the config directory.
+ * @param knownChecksums Checksums of files which are only added to the checksums, if they still match.
+ * @param upq Reads the files in parallel if given, otherwise one after another.
  * @returns ConfigDirInformation structure.
  */
-ConfigDirInformation ApiListener::LoadConfigDir(const String& dir)
+ConfigDirInformation ApiListener::LoadConfigDir(const String& dir, const Dictionary::Ptr& knownChecksums, WorkQueue *upq)
 {
 	ConfigDirInformation config;
 	config.UpdateV1 = new Dictionary();
 	config.UpdateV2 = new Dictionary();
 	config.Checksums = new Dictionary();
 
-	Utility::GlobRecursive(dir, "*", [&config, dir](const String& file) { ConfigGlobHandler(config, dir, file); }, GlobFile);
+	std::vector<String> files;
+	Utility::GlobRecursive(dir, "*", [&files](const String& file) { files.emplace_back(file); }, GlobFile);
+
+	ForEachConfigFile(upq, files, [&config, &dir, &knownChecksums](const String& file) {
+		ConfigGlobHandler(config, dir, file, knownChecksums);
+	});
+
 	return config;
 }
 
+/**
+ * Calculate the checksums of the files in the given config dir which would be synced.
+ * Unchanged files aren't read, their checksums are cached.
+ *
+ * @param dir Path to the config directory.
+ * @param upq Hashes the files in parallel if given, otherwise one after another.
+ * @returns The checksums by relative file path.
+ */
+Dictionary::Ptr ApiListener::LoadConfigDirChecksums(const String& dir, WorkQueue *upq)
+{
+	Dictionary::Ptr checksums = new Dictionary();
+
+	std::vector<String> files;
+	Utility::GlobRecursive(dir, "*", [&files](const String& file) { files.emplace_back(file); }, GlobFile);
+
+	ForEachConfigFile(upq, files, [&checksums, &dir](const String& file) {
+		if (Utility::BaseName(file) == ".authoritative")
+			return;
+
+		String checksum;
+		bool validUtf8;
+
+		if (!GetCachedConfigFileChecksum(file, checksum, validUtf8)) {
+			double readStart = Utility::GetTime();
+			String content;
+
+			if (!ReadConfigFile(file, content))
+				return;
+
+			checksum = GetChecksum(content);
+			validUtf8 = utf8::is_valid(content.Begin(), content.End());
+
+			CacheConfigFileChecksum(file, checksum, validUtf8, readStart);
+		}
+
+		// See ConfigGlobHandler().
+		if (!validUtf8 && !Utility::Match("*.conf", file)) {
+			Log(LogCritical, "ApiListener")
+				<< "Ignoring file '" << file << "' for cluster config sync: Does not contain valid UTF8. Binary files are not supported.";
+			return;
+		}
+
+		checksums->Set(file.SubStr(dir.GetLength()), checksum);
+	});
+
+	return checksums;
+}
+
 /**
  * Read the given file and store it in the config information structure.
- * Callback function for Glob().
+ * Called for multiple files, possibly in parallel, by LoadConfigDir().
  *
  * @param config Reference to the config information object.
  * @param path File path.
  * @param file Full file name.
+ * @param knownChecksums Checksums of files which are only added to the checksums, if they still match.
  */
-void ApiListener::ConfigGlobHandler(ConfigDirInformation& config, const String& path, const String& file)
+void ApiListener::ConfigGlobHandler(ConfigDirInformation& config, const String& path, const String& file, const Dictionary::Ptr& knownChecksums)
 {
 	// Avoid loading the authoritative marker for syncs at all cost.
 	if (Utility::BaseName(file) == ".authoritative")
 		return;
 
+	String relativePath = file.SubStr(path.GetLength());
+
+	bool conf = Utility::Match("*.conf", file);
+	String checksum;
+	bool validUtf8;
+
+	// Internal files like .timestamp are small and always sent.
+	bool delta = knownChecksums && !Utility::Match("/.*", relativePath);
+
+	if (delta && GetCachedConfigFileChecksum(file, checksum, validUtf8) && (validUtf8 || conf) && knownChecksums->Get(relativePath) == checksum) {
+		config.Checksums->Set(relativePath, checksum);
+		return;
+	}
+
 	CONTEXT("Creating config update for file '" << file << "'");
 
 	Log(LogNotice, "ApiListener")
 		<< "Creating config update for file '" << file << "'.";
 
-	std::ifstream fp(file.CStr(), std::ifstream::binary);
-	if (!fp)
+	double readStart = Utility::GetTime();
+	String content;
+
+	if (!ReadConfigFile(file, content))
 		return;
 
-	String content((std::istreambuf_iterator<char>(fp)), std::istreambuf_iterator<char>());
+	// Unchanged files have already been hashed and validated.
+	if (!GetCachedConfigFileChecksum(file, checksum, validUtf8)) {
+		checksum = GetChecksum(content);
+		validUtf8 = utf8::is_valid(content.Begin(), content.End());
+
+		CacheConfigFileChecksum(file, checksum, validUtf8, readStart);
+
+		// Not cached yet (e.g. after a restart), but possibly still known to the endpoint.
+		if (delta && (validUtf8 || conf) && knownChecksums->Get(relativePath) == checksum) {
+			config.Checksums->Set(relativePath, checksum);
+			return;
+		}
+	}
 
 	Dictionary::Ptr update;
-	String relativePath = file.SubStr(path.GetLength());
 
 	/*
 	 * 'update' messages contain conf files. 'update_v2' syncs everything else (.timestamp).
 	 *
 	 * **Keep this intact to stay compatible with older clients.**
 	 */
-	String sanitizedContent = Utility::ValidateUTF8(content);
-
-	if (Utility::Match("*.conf", file)) {
+	if (conf) {
 		update = config.UpdateV1;
 
 		// Configuration files should be automatically sanitized with UTF8.
-		update->Set(relativePath, sanitizedContent);
+		update->Set(relativePath, validUtf8 ? content : Utility::ValidateUTF8(content));
 	} else {
 		update = config.UpdateV2;
 
@@ -851,7 +1185,7 @@ void ApiListener::ConfigGlobHandler(ConfigDirInformation& config, const String&
 		 * Binary files are not supported when wrapped into JSON encoded messages.
 		 * Rationale: https://github.com/Icinga/icinga2/issues/7382
 		 */
-		if (content != sanitizedContent) {
+		if (!validUtf8) {
 			Log(LogCritical, "ApiListener")
 				<< "Ignoring file '" << file << "' for cluster config sync: Does not contain valid UTF8. Binary files are not supported.";
 			return;
@@ -864,7 +1198,185 @@ void ApiListener::ConfigGlobHandler(ConfigDirInformation& config, const String&
 	 *
 	 * IMPORTANT: Ignore the .authoritative file above, this must not be synced.
 	 * */
-	config.Checksums->Set(relativePath, GetChecksum(content));
+	config.Checksums->Set(relativePath, checksum);
+}
+
+/**
+ * Look up the checksum of a config file calculated before.
+ * Matches only if the file's modification time and size haven't changed since then.
+ *
+ * @param file Full file name.
+ * @param checksum The checksum.
+ * @param validUtf8 Whether the file's content is valid UTF-8.
+ * @returns Whether the checksum has been found.
+ */
+bool ApiListener::GetCachedConfigFileChecksum(const String& file, String& checksum, bool& validUtf8)
+{
+	namespace fs = boost::filesystem;
+
+	boost::system::error_code ec;
+	fs::path path (file.Begin(), file.End());
+	double mtime = fs::last_write_time(path, ec);
+
+	if (ec)
+		return false;
+
+	double size = fs::file_size(path, ec);
+
+	if (ec)
+		return false;
+
+	std::unique_lock<std::mutex> lock (m_ConfigChecksumCacheMutex);
+	auto entry (m_ConfigChecksumCache.find(file));
+
+	if (entry == m_ConfigChecksumCache.end() || entry->second.MTime != mtime || entry->second.Size != size)
+		return false;
+
+	checksum = entry->second.Checksum;
+	validUtf8 = entry->second.ValidUTF8;
+	return true;
+}
+
+/**
+ * Remember the checksum of a config file.
+ *
+ * @param file Full file name.
+ * @param checksum The checksum of the file's content.
+ * @param validUtf8 Whether the file's content is valid UTF-8.
+ * @param readStart When the file was opened for calculating the checksum.
+ */
+void ApiListener::CacheConfigFileChecksum(const String& file, const String& checksum, bool validUtf8, double readStart)
+{
+	namespace fs = boost::filesystem;
+
+	boost::system::error_code ec;
+	fs::path path (file.Begin(), file.End());
+	double mtime = fs::last_write_time(path, ec);
+
+	if (ec)
+		return;
+
+	double size = fs::file_size(path, ec);
+
+	if (ec)
+		return;
+
+	/* The modification time has a resolution of one second.
+	 * The file may have been changed while it was read, so we can't tell whether the checksum is still valid.
+	 */
+	if (mtime >= std::floor(readStart))
+		return;
+
+	std::unique_lock<std::mutex> lock (m_ConfigChecksumCacheMutex);
+
+	m_ConfigChecksumCache[file] = ConfigFileChecksum{mtime, size, checksum, validUtf8};
+	m_ConfigChecksumCacheDirty = true;
+}
+
+/**
+ * Load the config file checksums cached by a previous process, so that a reload doesn't have to read all files again.
+ */
+void ApiListener::LoadConfigChecksumCache()
+{
+	String path = GetApiDir() + "config-checksums.json";
+
+	if (!Utility::PathExists(path))
+		return;
+
+	Dictionary::Ptr cache;
+
+	try {
+		cache = Utility::LoadJsonFile(path);
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "ApiListener")
+			<< "Ignoring invalid config checksum cache '" << path << "': " << DiagnosticInformation(ex, false);
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock (m_ConfigChecksumCacheMutex);
+
+	ObjectLock olock(cache);
+	for (const Dictionary::Pair& kv : cache) {
+		Array::Ptr entry = kv.second;
+
+		if (!entry || entry->GetLength() != 4)
+			continue;
+
+		m_ConfigChecksumCache.emplace(kv.first, ConfigFileChecksum{
+			static_cast<double>(entry->Get(0)), static_cast<double>(entry->Get(1)), entry->Get(2), entry->Get(3).ToBool()
+		});
+	}
+}
+
+/**
+ * Persist the config file checksums if there are new ones. Files which don't exist anymore are dropped.
+ */
+void ApiListener::SaveConfigChecksumCache()
+{
+	Dictionary::Ptr cache = new Dictionary();
+
+	{
+		std::unique_lock<std::mutex> lock (m_ConfigChecksumCacheMutex);
+
+		if (!m_ConfigChecksumCacheDirty)
+			return;
+
+		for (auto it (m_ConfigChecksumCache.begin()); it != m_ConfigChecksumCache.end();) {
+			if (!Utility::PathExists(it->first)) {
+				it = m_ConfigChecksumCache.erase(it);
+				continue;
+			}
+
+			cache->Set(it->first, new Array({ it->second.MTime, it->second.Size, it->second.Checksum, it->second.ValidUTF8 }));
+			++it;
+		}
+
+		m_ConfigChecksumCacheDirty = false;
+	}
+
+	try {
+		Utility::SaveJsonFile(GetApiDir() + "config-checksums.json", 0600, cache);
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "ApiListener")
+			<< "Can't save config checksum cache: " << DiagnosticInformation(ex, false);
+	}
+}
+
+/**
+ * Adds the files of a delta config update which are only listed in its checksums, see SendConfigUpdate().
+ * The receiver already has them, so their content is taken from its production copy.
+ *
+ * @param update The received config update of a zone.
+ * @param production The production copy of the zone.
+ * @param mismatchedFile The first file whose production copy doesn't match the received checksum.
+ * @returns Whether all files could be added. If not, the update has to be discarded.
+ */
+bool ApiListener::CompleteConfigUpdate(ConfigDirInformation& update, const ConfigDirInformation& production, String& mismatchedFile)
+{
+	if (!update.Checksums || !update.UpdateV1 || !update.UpdateV2)
+		return true;
+
+	update.UpdateV1 = update.UpdateV1->ShallowClone();
+	update.UpdateV2 = update.UpdateV2->ShallowClone();
+
+	ObjectLock olock(update.Checksums);
+
+	for (const Dictionary::Pair& kv : update.Checksums) {
+		if (update.UpdateV1->Contains(kv.first) || update.UpdateV2->Contains(kv.first))
+			continue;
+
+		if (production.Checksums->Get(kv.first) != kv.second) {
+			mismatchedFile = kv.first;
+			return false;
+		}
+
+		if (production.UpdateV1->Contains(kv.first))
+			update.UpdateV1->Set(kv.first, production.UpdateV1->Get(kv.first));
+		else
+			update.UpdateV2->Set(kv.first, production.UpdateV2->Get(kv.first));
+	}
+
+	return true;
 }
 
 /**
@@ -8,6 +8,7 @@
 #include "remote/apifunction.hpp"
 #include "remote/configpackageutility.hpp"
 #include "remote/configobjectutility.hpp"
+#include "remote/filterutility.hpp"
 #include "base/atomic-file.hpp"
 #include "base/convert.hpp"
 #include "base/defer.hpp"
@@ -612,7 +613,7 @@ static const auto l_AppVersionInt (([]() -> unsigned long {
 		+ boost::lexical_cast<unsigned long>(match[3].str());
 })());
 
-static const auto l_MyCapabilities (ApiCapabilities::ExecuteArbitraryCommand);
+static const auto l_MyCapabilities ((uint_fast64_t)ApiCapabilities::ExecuteArbitraryCommand | (uint_fast64_t)ApiCapabilities::ConfigSyncDelta);
 
 /**
  * Processes a new client connection.
@@ -872,18 +873,29 @@ void ApiListener::SyncClient(const JsonRpcConnection::Ptr& aclient, const Endpoi
 			}
 		}
 
-		/* Make sure that the config updates are synced
-		 * before the logs are replayed.
+		/* Tell the endpoint which zone config files we have, so that it only sends the changed ones. */
+		if (GetAcceptConfig() && myZone->IsChildOf(eZone))
+			SendConfigChecksums(aclient);
+
+		/* Endpoints which understand config sync deltas get their config update once their
+		 * checksums arrive, i.e. usually after the log below has been replayed. That's fine:
+		 * a zone config update only takes effect after the endpoint has reloaded, so the
+		 * replayed messages are processed against its current config either way.
 		 */
 
-		Log(LogInformation, "ApiListener")
-			<< "Sending config updates for endpoint '" << endpoint->GetName() << "' in zone '" << eZone->GetName() << "'.";
+		if (endpoint->GetCapabilities() & (uint_fast64_t)ApiCapabilities::ConfigSyncDelta) {
+			Log(LogInformation, "ApiListener")
+				<< "Waiting for the config checksums of endpoint '" << endpoint->GetName() << "' in zone '" << eZone->GetName() << "' before sending config updates.";
+		} else if (aclient->MarkConfigUpdateSent()) {
+			Log(LogInformation, "ApiListener")
+				<< "Sending config updates for endpoint '" << endpoint->GetName() << "' in zone '" << eZone->GetName() << "'.";
 
-		/* sync zone file config */
-		SendConfigUpdate(aclient);
+			/* sync zone file config */
+			SendConfigUpdate(aclient);
 
-		Log(LogInformation, "ApiListener")
-			<< "Finished sending config file updates for endpoint '" << endpoint->GetName() << "' in zone '" << eZone->GetName() << "'.";
+			Log(LogInformation, "ApiListener")
+				<< "Finished sending config file updates for endpoint '" << endpoint->GetName() << "' in zone '" << eZone->GetName() << "'.";
+		}
 
 		/* sync runtime config */
 		SendRuntimeConfigObjects(aclient);
@@ -1650,6 +1662,7 @@ std::pair<Dictionary::Ptr, Dictionary::Ptr> ApiListener::GetStatus()
 	double workQueueItemRate = JsonRpcConnection::GetWorkQueueRate();
 	double syncQueueItemRate = m_SyncQueue.GetTaskCount(60) / 60.0;
 	double relayQueueItemRate = m_RelayQueue.GetTaskCount(60) / 60.0;
+	Dictionary::Ptr filterCache = FilterUtility::GetFilterCacheStats();
 
 	Dictionary::Ptr status = new Dictionary({
 		{ "identity", GetIdentity() },
@@ -1672,7 +1685,9 @@ std::pair<Dictionary::Ptr, Dictionary::Ptr> ApiListener::GetStatus()
 
 		{ "http", new Dictionary({
 			{ "clients", httpClients }
-		}) }
+		}) },
+
+		{ "filter_cache", filterCache }
 	});
 
 	/* performance data */
@@ -1689,6 +1704,10 @@ std::pair<Dictionary::Ptr, Dictionary::Ptr> ApiListener::GetStatus()
 	perfdata->Set("num_json_rpc_sync_queue_item_rate", syncQueueItemRate);
 	perfdata->Set("num_json_rpc_relay_queue_item_rate", relayQueueItemRate);
 
+	perfdata->Set("num_filter_cache_entries", filterCache->Get("entries"));
+	perfdata->Set("num_filter_cache_hits", filterCache->Get("hits"));
+	perfdata->Set("num_filter_cache_misses", filterCache->Get("misses"));
+
 	return std::make_pair(status, perfdata);
 }
 
@@ -1763,6 +1782,17 @@ Value ApiListener::HelloAPIHandler(const MessageOrigin::Ptr& origin, const Dicti
 				endpoint->SetIcingaVersion(nodeVersion);
 				endpoint->SetCapabilities((double)params->Get("capabilities"));
 
+				/* SyncClient() may have expected config checksums based on outdated capabilities. */
+				if (!(endpoint->GetCapabilities() & (uint_fast64_t)ApiCapabilities::ConfigSyncDelta)) {
+					auto listener (ApiListener::GetInstance());
+
+					if (listener && client->MarkConfigUpdateSent()) {
+						Utility::QueueAsyncCallback([listener, client]() {
+							listener->SendConfigUpdate(client);
+						});
+					}
+				}
+
 				if (nodeVersion == 0u) {
 					nodeVersion = 21200;
 				}
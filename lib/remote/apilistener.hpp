@@ -25,6 +25,7 @@
 #include <cstdint>
 #include <mutex>
 #include <set>
+#include <unordered_map>
 
 namespace icinga
 {
@@ -67,7 +68,8 @@ struct ConfigDirInformation
  */
 enum class ApiCapabilities : uint_fast64_t
 {
-	ExecuteArbitraryCommand = 1u
+	ExecuteArbitraryCommand = 1u,
+	ConfigSyncDelta = 2u
 };
 
 /**
@@ -118,8 +120,15 @@ public:
 
 	/* filesync */
 	static Value ConfigUpdateHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
+	static Value ConfigChecksumsHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
 	void HandleConfigUpdate(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
 
+	static Dictionary::Ptr MergeConfigUpdate(const ConfigDirInformation& config);
+	static bool CompleteConfigUpdate(ConfigDirInformation& update, const ConfigDirInformation& production, String& mismatchedFile);
+
+	static ConfigDirInformation LoadConfigDir(const String& dir, const Dictionary::Ptr& knownChecksums = nullptr, WorkQueue *upq = nullptr);
+	static Dictionary::Ptr LoadConfigDirChecksums(const String& dir, WorkQueue *upq = nullptr);
+
 	/* configsync */
 	static void ConfigUpdateObjectHandler(const ConfigObject::Ptr& object, const Value& cookie);
 	static Value ConfigUpdateObjectAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
@@ -223,16 +232,32 @@ private:
 	/* filesync */
 	static std::mutex m_ConfigSyncStageLock;
 
+	struct ConfigFileChecksum
+	{
+		double MTime;
+		double Size;
+		String Checksum;
+		bool ValidUTF8;
+	};
+
+	static std::mutex m_ConfigChecksumCacheMutex;
+	static std::unordered_map<String, ConfigFileChecksum> m_ConfigChecksumCache;
+	static bool m_ConfigChecksumCacheDirty;
+
 	void SyncLocalZoneDirs() const;
-	void SyncLocalZoneDir(const Zone::Ptr& zone) const;
+	void SyncLocalZoneDir(const Zone::Ptr& zone, WorkQueue& upq) const;
 	void RenewOwnCert();
 
-	void SendConfigUpdate(const JsonRpcConnection::Ptr& aclient);
+	void SendConfigUpdate(const JsonRpcConnection::Ptr& aclient, const Dictionary::Ptr& knownChecksums = nullptr);
+	void SendConfigChecksums(const JsonRpcConnection::Ptr& aclient);
+	static void RequestFullConfigUpdate(const JsonRpcConnection::Ptr& aclient);
 
-	static Dictionary::Ptr MergeConfigUpdate(const ConfigDirInformation& config);
+	static void ConfigGlobHandler(ConfigDirInformation& config, const String& path, const String& file, const Dictionary::Ptr& knownChecksums);
 
-	static ConfigDirInformation LoadConfigDir(const String& dir);
-	static void ConfigGlobHandler(ConfigDirInformation& config, const String& path, const String& file);
+	static bool GetCachedConfigFileChecksum(const String& file, String& checksum, bool& validUtf8);
+	static void CacheConfigFileChecksum(const String& file, const String& checksum, bool validUtf8, double readStart);
+	static void LoadConfigChecksumCache();
+	static void SaveConfigChecksumCache();
 
 	static void TryActivateZonesStage(const std::vector<String>& relativePaths);
 
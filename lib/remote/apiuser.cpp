@@ -4,25 +4,135 @@
 #include "remote/apiuser-ti.cpp"
 #include "base/configtype.hpp"
 #include "base/base64.hpp"
+#include "base/initialize.hpp"
 #include "base/tlsutility.hpp"
 #include "base/utility.hpp"
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
 
 using namespace icinga;
 
 REGISTER_TYPE(ApiUser);
 
-ApiUser::Ptr ApiUser::GetByClientCN(const String& cn)
+static std::mutex l_ClientCNIndexMutex;
+static std::unordered_map<String, ApiUser::Ptr> l_ClientCNIndex;
+
+/* Successfully verified Authorization headers (by their SHA256 hash) and when they expire. */
+static std::mutex l_AuthCacheMutex;
+static std::unordered_map<String, std::pair<ApiUser::Ptr, double>> l_AuthCache;
+
+/* Incremented whenever the cache is cleared, so that a verification which raced with
+ * a password change doesn't put the old credentials back into the cache. */
+static uint_fast64_t l_AuthCacheGeneration = 0;
+
+static const double l_AuthCacheTtl = 60;
+static const size_t l_AuthCacheMaxEntries = 1024;
+
+INITIALIZE_ONCE(&ApiUser::StaticInitialize);
+
+void ApiUser::StaticInitialize()
+{
+	OnClientCNChanged.connect([](const ApiUser::Ptr& user, const Value&) {
+		user->UpdateClientCNIndex();
+	});
+
+	OnPasswordChanged.connect([](const ApiUser::Ptr&, const Value&) {
+		ClearAuthCache();
+	});
+}
+
+void ApiUser::OnAllConfigLoaded()
+{
+	ObjectImpl<ApiUser>::OnAllConfigLoaded();
+
+	UpdateClientCNIndex();
+}
+
+void ApiUser::Stop(bool runtimeRemoved)
+{
+	ObjectImpl<ApiUser>::Stop(runtimeRemoved);
+
+	UpdateClientCNIndex(true);
+	ClearAuthCache();
+}
+
+/**
+ * Moves this user to its current CN in the CN index.
+ *
+ * @param remove Whether to only remove the user from the index
+ */
+void ApiUser::UpdateClientCNIndex(bool remove)
 {
-	for (const ApiUser::Ptr& user : ConfigType::GetObjectsByType<ApiUser>()) {
-		if (user->GetClientCN() == cn)
-			return user;
+	String cn = remove ? String() : GetClientCN();
+
+	std::unique_lock<std::mutex> lock (l_ClientCNIndexMutex);
+
+	if (!m_IndexedClientCN.IsEmpty() && m_IndexedClientCN != cn) {
+		auto it (l_ClientCNIndex.find(m_IndexedClientCN));
+
+		if (it != l_ClientCNIndex.end() && it->second == this) {
+			l_ClientCNIndex.erase(it);
+
+			/* Another user might share the CN. */
+			for (const ApiUser::Ptr& user : ConfigType::GetObjectsByType<ApiUser>()) {
+				if (user != this && user->m_IndexedClientCN == m_IndexedClientCN) {
+					l_ClientCNIndex.emplace(m_IndexedClientCN, user);
+					break;
+				}
+			}
+		}
 	}
 
-	return nullptr;
+	m_IndexedClientCN = cn;
+
+	if (!cn.IsEmpty())
+		l_ClientCNIndex.emplace(cn, this);
+}
+
+ApiUser::Ptr ApiUser::GetByClientCN(const String& cn)
+{
+	std::unique_lock<std::mutex> lock (l_ClientCNIndexMutex);
+
+	auto it (l_ClientCNIndex.find(cn));
+
+	if (it == l_ClientCNIndex.end())
+		return nullptr;
+
+	return it->second;
+}
+
+void ApiUser::ClearAuthCache()
+{
+	std::unique_lock<std::mutex> lock (l_AuthCacheMutex);
+	l_AuthCache.clear();
+	l_AuthCacheGeneration++;
 }
 
 ApiUser::Ptr ApiUser::GetByAuthHeader(const String& auth_header)
 {
+	/* Keep-alive connections send the same header with every request. Only a hash of
+	 * it is kept so that the cache doesn't hold the plaintext credentials. */
+	String headerHash = SHA256(auth_header);
+	double now = Utility::GetTime();
+	uint_fast64_t generation;
+
+	{
+		std::unique_lock<std::mutex> lock (l_AuthCacheMutex);
+
+		generation = l_AuthCacheGeneration;
+
+		auto it (l_AuthCache.find(headerHash));
+
+		if (it != l_AuthCache.end()) {
+			if (it->second.second > now)
+				return it->second.first;
+
+			l_AuthCache.erase(it);
+		}
+	}
+
 	String::SizeType pos = auth_header.FindFirstOf(" ");
 	String username, password;
 
@@ -50,6 +160,16 @@ ApiUser::Ptr ApiUser::GetByAuthHeader(const String& auth_header)
 	else if (user && !Utility::ComparePasswords(password, user->GetPassword()))
 		return nullptr;
 
+	std::unique_lock<std::mutex> lock (l_AuthCacheMutex);
+
+	if (generation != l_AuthCacheGeneration)
+		return user;
+
+	if (l_AuthCache.size() >= l_AuthCacheMaxEntries)
+		l_AuthCache.clear();
+
+	l_AuthCache[headerHash] = std::make_pair(user, now + l_AuthCacheTtl);
+
 	return user;
 }
 
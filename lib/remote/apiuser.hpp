@@ -18,8 +18,20 @@ public:
 	DECLARE_OBJECT(ApiUser);
 	DECLARE_OBJECTNAME(ApiUser);
 
+	static void StaticInitialize();
+
 	static ApiUser::Ptr GetByClientCN(const String& cn);
 	static ApiUser::Ptr GetByAuthHeader(const String& auth_header);
+
+protected:
+	void OnAllConfigLoaded() override;
+	void Stop(bool runtimeRemoved) override;
+
+private:
+	String m_IndexedClientCN;
+
+	void UpdateClientCNIndex(bool remove = false);
+	static void ClearAuthCache();
 };
 
 }
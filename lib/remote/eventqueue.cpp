@@ -159,14 +159,14 @@ EventsInbox::EventsInbox(String filter, const String& filterSource)
 	if (m_Filter == m_Filters.end()) {
 		lock.unlock();
 
-		auto expr (ConfigCompiler::CompileText(filterSource, filter));
+		auto expr (FilterUtility::CompileFilter(filter, filterSource));
 
 		lock.lock();
 
 		m_Filter = m_Filters.find(filter);
 
 		if (m_Filter == m_Filters.end()) {
-			m_Filter = m_Filters.emplace(std::move(filter), Filter{1, Expression::Ptr(expr.release())}).first;
+			m_Filter = m_Filters.emplace(std::move(filter), Filter{1, std::move(expr)}).first;
 		} else {
 			++m_Filter->second.Refs;
 		}
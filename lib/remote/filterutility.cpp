@@ -2,6 +2,7 @@
 
 #include "remote/filterutility.hpp"
 #include "remote/httputility.hpp"
+#include "remote/objectindex.hpp"
 #include "config/configcompiler.hpp"
 #include "config/expression.hpp"
 #include "base/namespace.hpp"
@@ -10,10 +11,24 @@
 #include "base/logger.hpp"
 #include "base/utility.hpp"
 #include <boost/algorithm/string/case_conv.hpp>
+#include <cstdint>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 
 using namespace icinga;
 
+/* Compiled filter expressions are immutable and thus can be shared between requests.
+ * The cache is a simple LRU list, the most recently used entry is at the front.
+ */
+static const size_t l_FilterCacheSize = 1024;
+static std::mutex l_FilterCacheMutex;
+static std::list<std::pair<String, Expression::Ptr>> l_FilterCacheLru;
+static std::unordered_map<String, decltype(l_FilterCacheLru.begin())> l_FilterCacheIndex;
+static uint_fast64_t l_FilterCacheHits = 0;
+static uint_fast64_t l_FilterCacheMisses = 0;
+
 Type::Ptr FilterUtility::TypeFromPluralName(const String& pluralName)
 {
 	String uname = pluralName;
@@ -115,6 +130,218 @@ bool FilterUtility::EvaluateFilter(ScriptFrame& frame, Expression *filter,
 	return Convert::ToBool(filter->Evaluate(frame));
 }
 
+/**
+ * Compiles the given filter or returns an already compiled expression from the cache.
+ *
+ * The returned expression is shared with other callers and must not be modified.
+ * The source name is only used for the debug info of freshly compiled filters.
+ *
+ * @param filter The filter's source code
+ * @param source The name the filter's source is reported as in errors
+ *
+ * @return The compiled filter
+ */
+Expression::Ptr FilterUtility::CompileFilter(const String& filter, const String& source)
+{
+	{
+		std::unique_lock<std::mutex> lock (l_FilterCacheMutex);
+
+		auto it (l_FilterCacheIndex.find(filter));
+
+		if (it != l_FilterCacheIndex.end()) {
+			++l_FilterCacheHits;
+			l_FilterCacheLru.splice(l_FilterCacheLru.begin(), l_FilterCacheLru, it->second);
+			return it->second->second;
+		}
+
+		++l_FilterCacheMisses;
+	}
+
+	/* Compile without holding the lock, syntax errors are thrown to the caller and not cached. */
+	Expression::Ptr expr (ConfigCompiler::CompileText(source, filter).release());
+
+	std::unique_lock<std::mutex> lock (l_FilterCacheMutex);
+
+	auto it (l_FilterCacheIndex.find(filter));
+
+	if (it != l_FilterCacheIndex.end()) {
+		l_FilterCacheLru.splice(l_FilterCacheLru.begin(), l_FilterCacheLru, it->second);
+		return it->second->second;
+	}
+
+	l_FilterCacheLru.emplace_front(filter, expr);
+	l_FilterCacheIndex.emplace(filter, l_FilterCacheLru.begin());
+
+	while (l_FilterCacheLru.size() > l_FilterCacheSize) {
+		l_FilterCacheIndex.erase(l_FilterCacheLru.back().first);
+		l_FilterCacheLru.pop_back();
+	}
+
+	return expr;
+}
+
+Dictionary::Ptr FilterUtility::GetFilterCacheStats()
+{
+	std::unique_lock<std::mutex> lock (l_FilterCacheMutex);
+
+	return new Dictionary({
+		{ "entries", l_FilterCacheLru.size() },
+		{ "hits", l_FilterCacheHits },
+		{ "misses", l_FilterCacheMisses }
+	});
+}
+
+/**
+ * Resolves an operand of a filter condition to a constant, i.e. a literal or a filter variable.
+ */
+static bool GetFilterConstant(const Expression *expr, const Dictionary::Ptr& filterVars,
+	const std::set<String>& reservedVars, Value *value)
+{
+	auto *literal = dynamic_cast<const LiteralExpression *>(expr);
+
+	if (literal) {
+		*value = literal->GetValue();
+		return true;
+	}
+
+	auto *variable = dynamic_cast<const VariableExpression *>(expr);
+
+	if (variable && filterVars && reservedVars.find(variable->GetVariable()) == reservedVars.end())
+		return filterVars->Get(variable->GetVariable(), value);
+
+	return false;
+}
+
+/**
+ * Checks whether an operand of a filter condition is an attribute of the filtered object, e.g. `host.state`.
+ */
+static bool GetFilterAttribute(const Expression *expr, const std::set<String>& targetVars, String *attribute)
+{
+	auto *indexer = dynamic_cast<const IndexerExpression *>(expr);
+
+	if (!indexer)
+		return false;
+
+	auto *variable = dynamic_cast<const VariableExpression *>(indexer->GetOperand1().get());
+	auto *literal = dynamic_cast<const LiteralExpression *>(indexer->GetOperand2().get());
+
+	if (!variable || !literal || !literal->GetValue().IsString() || targetVars.find(variable->GetVariable()) == targetVars.end())
+		return false;
+
+	*attribute = literal->GetValue();
+	return true;
+}
+
+static void GetFilterConjuncts(const Expression *expr, std::vector<const Expression *>& conjuncts)
+{
+	auto *dict = dynamic_cast<const DictExpression *>(expr);
+
+	if (dict && dict->IsInline() && dict->GetExpressions().size() == 1) {
+		GetFilterConjuncts(dict->GetExpressions()[0].get(), conjuncts);
+		return;
+	}
+
+	auto *land = dynamic_cast<const LogicalAndExpression *>(expr);
+
+	if (land) {
+		GetFilterConjuncts(land->GetOperand1().get(), conjuncts);
+		GetFilterConjuncts(land->GetOperand2().get(), conjuncts);
+		return;
+	}
+
+	conjuncts.push_back(expr);
+}
+
+/**
+ * Uses the object indexes to find the objects a filter may match.
+ *
+ * The filter's top-level conjuncts are checked for conditions of the form
+ * `obj.attr == value` and `value in obj.attr` where `value` is a literal or a filter
+ * variable and an index exists for `attr`. The index yielding the fewest objects wins.
+ * The candidates are a superset of the matching objects, the filter still has to be
+ * evaluated for each of them.
+ *
+ * @return false if no index could be used and all objects have to be checked
+ */
+bool FilterUtility::GetIndexedCandidates(const String& type, const Expression *filter, const Dictionary::Ptr& filterVars,
+	const String& variableName, std::vector<ConfigObject::Ptr>& candidates)
+{
+	Type::Ptr ptype = Type::GetByName(type);
+
+	if (!ptype)
+		return false;
+
+	String varName = variableName.IsEmpty() ? ptype->GetName().ToLower() : variableName;
+
+	/* These are set by EvaluateFilter() and override filter variables of the same name. */
+	std::set<String> targetVars { varName, "obj" };
+	std::set<String> reservedVars (targetVars);
+
+	for (int fid = 0; fid < ptype->GetFieldCount(); fid++) {
+		Field field = ptype->GetFieldInfo(fid);
+
+		if (field.Attributes & FANavigation)
+			reservedVars.emplace(field.NavigationName ? field.NavigationName : field.Name);
+	}
+
+	std::vector<const Expression *> conjuncts;
+	GetFilterConjuncts(filter, conjuncts);
+
+	ObjectIndex::Ptr bestIndex;
+	Value bestValue;
+	size_t bestCount = SIZE_MAX;
+
+	for (const Expression *conjunct : conjuncts) {
+		const Expression *valueExpr;
+
+		auto *equal = dynamic_cast<const EqualExpression *>(conjunct);
+		auto *in = dynamic_cast<const InExpression *>(conjunct);
+
+		String attribute;
+		Value value;
+
+		if (equal) {
+			if (GetFilterAttribute(equal->GetOperand1().get(), targetVars, &attribute)) {
+				valueExpr = equal->GetOperand2().get();
+			} else if (GetFilterAttribute(equal->GetOperand2().get(), targetVars, &attribute)) {
+				valueExpr = equal->GetOperand1().get();
+			} else {
+				continue;
+			}
+		} else if (in) {
+			if (!GetFilterAttribute(in->GetOperand2().get(), targetVars, &attribute))
+				continue;
+
+			valueExpr = in->GetOperand1().get();
+		} else {
+			continue;
+		}
+
+		if (!GetFilterConstant(valueExpr, filterVars, reservedVars, &value))
+			continue;
+
+		ObjectIndex::Ptr index = ObjectIndex::GetByAttribute(ptype, attribute);
+
+		if (!index)
+			continue;
+
+		size_t count = index->GetCount(value);
+
+		if (count < bestCount) {
+			bestIndex = index;
+			bestValue = value;
+			bestCount = count;
+		}
+	}
+
+	if (!bestIndex)
+		return false;
+
+	candidates.reserve(bestCount);
+
+	return bestIndex->Find(bestValue, candidates);
+}
+
 static void FilteredAddTarget(ScriptFrame& permissionFrame, Expression *permissionFilter,
 	ScriptFrame& frame, Expression *ufilter, std::vector<Value>& result, const String& variableName, const Object::Ptr& target)
 {
@@ -270,7 +497,7 @@ std::vector<Value> FilterUtility::GetFilterTargets(const QueryDescription& qd, c
 
 		if (query->Contains("filter")) {
 			String filter = HttpUtility::GetLastParameter(query, "filter");
-			std::unique_ptr<Expression> ufilter = ConfigCompiler::CompileText("<API query>", filter);
+			Expression::Ptr ufilter = CompileFilter(filter);
 
 			Dictionary::Ptr filter_vars = query->Get("filter_vars");
 			if (filter_vars) {
@@ -280,9 +507,18 @@ std::vector<Value> FilterUtility::GetFilterTargets(const QueryDescription& qd, c
 				}
 			}
 
-			provider->FindTargets(type, [&permissionFrame, &permissionFilter, &frame, &ufilter, &result, variableName](const Object::Ptr& target) {
-				FilteredAddTarget(permissionFrame, permissionFilter.get(), frame, &*ufilter, result, variableName, target);
-			});
+			std::vector<ConfigObject::Ptr> candidates;
+
+			/* Custom target providers don't know about object indexes. */
+			if (!qd.Provider && GetIndexedCandidates(type, ufilter.get(), filter_vars, variableName, candidates)) {
+				for (const ConfigObject::Ptr& target : candidates) {
+					FilteredAddTarget(permissionFrame, permissionFilter.get(), frame, ufilter.get(), result, variableName, target);
+				}
+			} else {
+				provider->FindTargets(type, [&permissionFrame, &permissionFilter, &frame, &ufilter, &result, variableName](const Object::Ptr& target) {
+					FilteredAddTarget(permissionFrame, permissionFilter.get(), frame, ufilter.get(), result, variableName, target);
+				});
+			}
 		} else {
 			/* Ensure to pass a nullptr as filter expression.
 			 * GCC 8.1.1 on F28 causes problems, see GH #6533.
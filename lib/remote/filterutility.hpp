@@ -57,6 +57,11 @@ public:
 		const ApiUser::Ptr& user, const String& variableName = String());
 	static bool EvaluateFilter(ScriptFrame& frame, Expression *filter,
 		const Object::Ptr& target, const String& variableName = String());
+	static bool GetIndexedCandidates(const String& type, const Expression *filter, const Dictionary::Ptr& filterVars,
+		const String& variableName, std::vector<ConfigObject::Ptr>& candidates);
+
+	static Expression::Ptr CompileFilter(const String& filter, const String& source = "<API query>");
+	static Dictionary::Ptr GetFilterCacheStats();
 };
 
 }
@@ -0,0 +1,264 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/httpclient.hpp"
+#include "base/exception.hpp"
+#include "base/io-engine.hpp"
+#include "base/logger.hpp"
+#include "base/tcpsocket.hpp"
+#include "base/tlsutility.hpp"
+#include <boost/asio/error.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/error.hpp>
+#include <boost/beast/http/field.hpp>
+#include <boost/beast/http/parser.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/beast/http/write.hpp>
+#include <boost/system/system_error.hpp>
+#include <utility>
+
+using namespace icinga;
+
+HttpClient::HttpClient(String host, String port, size_t maxIdleConnections)
+	: m_Host(std::move(host)), m_Port(std::move(port)), m_MaxIdleConnections(maxIdleConnections)
+{ }
+
+/**
+ * Makes the client connect via TLS. Must be called before the first request.
+ *
+ * @param certPath Client certificate, may be empty
+ * @param keyPath Client certificate's key, may be empty
+ * @param caPath CA to verify the server's certificate with, may be empty
+ * @param insecureNoverify Whether to accept any server certificate
+ */
+void HttpClient::EnableTls(String certPath, String keyPath, String caPath, bool insecureNoverify)
+{
+	m_Tls = true;
+	m_CertPath = std::move(certPath);
+	m_KeyPath = std::move(keyPath);
+	m_CaPath = std::move(caPath);
+	m_InsecureNoverify = insecureNoverify;
+}
+
+const String& HttpClient::GetHost() const
+{
+	return m_Host;
+}
+
+const String& HttpClient::GetPort() const
+{
+	return m_Port;
+}
+
+/**
+ * Sends a request and reads its response.
+ *
+ * If an idle connection turns out to have been closed by the server,
+ * the request is sent again over a new connection.
+ *
+ * @param request The request, its version is set to HTTP/1.1
+ * @return The response
+ */
+HttpClient::Response HttpClient::Send(Request& request)
+{
+	namespace beast = boost::beast;
+	namespace http = beast::http;
+
+	request.version(11);
+	request.keep_alive(true);
+
+	for (;;) {
+		bool reused;
+		OptionalTlsStream stream = AcquireConnection(reused);
+
+		try {
+			if (stream.first) {
+				http::write(*stream.first, request);
+				stream.first->flush();
+			} else {
+				http::write(*stream.second, request);
+				stream.second->flush();
+			}
+		} catch (const std::exception&) {
+			CloseConnection(stream);
+
+			if (reused)
+				continue;
+
+			Log(LogWarning, "HttpClient")
+				<< "Cannot write to HTTP API on host '" << m_Host << "' port '" << m_Port << "'.";
+			throw;
+		}
+
+		http::parser<false, http::string_body> parser;
+		beast::flat_buffer buf;
+
+		try {
+			if (stream.first) {
+				http::read(*stream.first, buf, parser);
+			} else {
+				http::read(*stream.second, buf, parser);
+			}
+		} catch (const boost::system::system_error& ex) {
+			CloseConnection(stream);
+
+			if (reused && (ex.code() == http::error::end_of_stream || ex.code() == boost::asio::error::connection_reset))
+				continue;
+
+			Log(LogWarning, "HttpClient")
+				<< "Failed to parse HTTP response from host '" << m_Host << "' port '" << m_Port << "': " << DiagnosticInformation(ex, false);
+			throw;
+		}
+
+		if (parser.get().keep_alive())
+			ReleaseConnection(std::move(stream));
+		else
+			CloseConnection(stream);
+
+		return parser.release();
+	}
+}
+
+/**
+ * Closes all connections which aren't in use, e.g. when a writer is paused.
+ */
+void HttpClient::CloseIdleConnections()
+{
+	std::vector<OptionalTlsStream> connections;
+
+	{
+		std::unique_lock<std::mutex> lock (m_Mutex);
+		std::swap(connections, m_IdleConnections);
+	}
+
+	for (auto& stream : connections)
+		CloseConnection(stream);
+}
+
+/**
+ * Takes an idle connection or opens a new one.
+ *
+ * @param reused Set to whether the connection has been used before
+ */
+OptionalTlsStream HttpClient::AcquireConnection(bool& reused)
+{
+	{
+		std::unique_lock<std::mutex> lock (m_Mutex);
+
+		if (!m_IdleConnections.empty()) {
+			OptionalTlsStream stream = std::move(m_IdleConnections.back());
+			m_IdleConnections.pop_back();
+
+			reused = true;
+			return stream;
+		}
+	}
+
+	reused = false;
+	return Connect();
+}
+
+/**
+ * Keeps a connection for the next request after a complete request/response.
+ */
+void HttpClient::ReleaseConnection(OptionalTlsStream stream)
+{
+	if (stream.first) {
+		/* With TLS 1.3 the session ticket arrives after the handshake, i.e. it's available now. */
+		SSL_SESSION *session = SSL_get1_session(stream.first->next_layer().native_handle());
+
+		if (session) {
+			std::unique_lock<std::mutex> lock (m_Mutex);
+			m_TlsSession = std::shared_ptr<SSL_SESSION>(session, SSL_SESSION_free);
+		}
+	}
+
+	std::unique_lock<std::mutex> lock (m_Mutex);
+
+	if (m_IdleConnections.size() < m_MaxIdleConnections) {
+		m_IdleConnections.emplace_back(std::move(stream));
+		return;
+	}
+
+	lock.unlock();
+
+	CloseConnection(stream);
+}
+
+OptionalTlsStream HttpClient::Connect()
+{
+	Log(LogNotice, "HttpClient")
+		<< "Connecting to host '" << m_Host << "' port '" << m_Port << "'.";
+
+	OptionalTlsStream stream;
+	std::shared_ptr<SSL_SESSION> session;
+
+	if (m_Tls) {
+		Shared<boost::asio::ssl::context>::Ptr sslContext;
+
+		{
+			std::unique_lock<std::mutex> lock (m_Mutex);
+
+			if (!m_SslContext) {
+				try {
+					m_SslContext = MakeAsioSslContext(m_CertPath, m_KeyPath, m_CaPath);
+				} catch (const std::exception&) {
+					Log(LogWarning, "HttpClient")
+						<< "Unable to create SSL context.";
+					throw;
+				}
+			}
+
+			sslContext = m_SslContext;
+			session = m_TlsSession;
+		}
+
+		stream.first = Shared<AsioTlsStream>::Make(IoEngine::Get().GetIoContext(), *sslContext, m_Host);
+	} else {
+		stream.second = Shared<AsioTcpStream>::Make(IoEngine::Get().GetIoContext());
+	}
+
+	try {
+		icinga::Connect(m_Tls ? stream.first->lowest_layer() : stream.second->lowest_layer(), m_Host, m_Port);
+	} catch (const std::exception&) {
+		Log(LogWarning, "HttpClient")
+			<< "Can't connect to host '" << m_Host << "' port '" << m_Port << "'.";
+		throw;
+	}
+
+	if (m_Tls) {
+		auto& tlsStream (stream.first->next_layer());
+
+		if (session)
+			SSL_set_session(tlsStream.native_handle(), session.get());
+
+		try {
+			tlsStream.handshake(tlsStream.client);
+		} catch (const std::exception&) {
+			Log(LogWarning, "HttpClient")
+				<< "TLS handshake with host '" << m_Host << "' on port " << m_Port << " failed.";
+			throw;
+		}
+
+		if (!m_InsecureNoverify) {
+			if (!tlsStream.GetPeerCertificate()) {
+				BOOST_THROW_EXCEPTION(std::runtime_error("Host '" + m_Host + "' didn't present any TLS certificate."));
+			}
+
+			if (!tlsStream.IsVerifyOK()) {
+				BOOST_THROW_EXCEPTION(std::runtime_error(
+					"TLS certificate validation failed: " + std::string(tlsStream.GetVerifyError())
+				));
+			}
+		}
+	}
+
+	return stream;
+}
+
+void HttpClient::CloseConnection(const OptionalTlsStream& stream)
+{
+	if (stream.first) {
+		boost::system::error_code ec;
+		stream.first->next_layer().shutdown(ec);
+	}
+}
@@ -0,0 +1,74 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef HTTPCLIENT_H
+#define HTTPCLIENT_H
+
+#include "base/object.hpp"
+#include "base/shared.hpp"
+#include "base/string.hpp"
+#include "base/tlsstream.hpp"
+#include <boost/asio/ssl/context.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <openssl/ssl.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * A synchronous HTTP/1.1 client for a single server.
+ *
+ * Connections are kept alive and reused by subsequent requests, so that e.g.
+ * the perfdata writers don't connect (and do a TLS handshake) for every flush.
+ * New TLS connections resume the last session if the server supports it.
+ * Requests aren't pipelined as the writers only send non-idempotent POSTs.
+ *
+ * @ingroup remote
+ */
+class HttpClient final : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(HttpClient);
+
+	typedef boost::beast::http::request<boost::beast::http::string_body> Request;
+	typedef boost::beast::http::response<boost::beast::http::string_body> Response;
+
+	HttpClient(String host, String port, size_t maxIdleConnections = 1);
+
+	void EnableTls(String certPath, String keyPath, String caPath, bool insecureNoverify);
+
+	Response Send(Request& request);
+	void CloseIdleConnections();
+
+	const String& GetHost() const;
+	const String& GetPort() const;
+
+private:
+	String m_Host;
+	String m_Port;
+	size_t m_MaxIdleConnections;
+
+	bool m_Tls{false};
+	String m_CertPath;
+	String m_KeyPath;
+	String m_CaPath;
+	bool m_InsecureNoverify{false};
+
+	std::mutex m_Mutex;
+	Shared<boost::asio::ssl::context>::Ptr m_SslContext;
+	std::shared_ptr<SSL_SESSION> m_TlsSession;
+	std::vector<OptionalTlsStream> m_IdleConnections;
+
+	OptionalTlsStream AcquireConnection(bool& reused);
+	void ReleaseConnection(OptionalTlsStream stream);
+	OptionalTlsStream Connect();
+
+	static void CloseConnection(const OptionalTlsStream& stream);
+};
+
+}
+
+#endif /* HTTPCLIENT_H */
@@ -180,6 +180,26 @@ void JsonRpcConnection::SendRawMessage(const String& message)
 	});
 }
 
+/**
+ * Marks the zone config files as sent over this connection.
+ *
+ * @return Whether they haven't been marked so before, i.e. the caller shall send them
+ */
+bool JsonRpcConnection::MarkConfigUpdateSent()
+{
+	return !m_ConfigUpdateSent.exchange(true);
+}
+
+/**
+ * Marks the full zone config files, as requested by the endpoint after a failed delta update, as sent over this connection.
+ *
+ * @return Whether they haven't been marked so before, i.e. the caller shall send them
+ */
+bool JsonRpcConnection::MarkFullConfigUpdateSent()
+{
+	return !m_FullConfigUpdateSent.exchange(true);
+}
+
 void JsonRpcConnection::SendMessageInternal(const Dictionary::Ptr& message)
 {
 	m_OutgoingMessagesQueue.emplace_back(JsonEncode(message));
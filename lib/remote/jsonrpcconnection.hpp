@@ -9,6 +9,7 @@
 #include "base/tlsstream.hpp"
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
+#include <atomic>
 #include <memory>
 #include <vector>
 #include <boost/asio/io_context.hpp>
@@ -58,6 +59,9 @@ public:
 	void SendMessage(const Dictionary::Ptr& request);
 	void SendRawMessage(const String& request);
 
+	bool MarkConfigUpdateSent();
+	bool MarkFullConfigUpdateSent();
+
 	static Value HeartbeatAPIHandler(const intrusive_ptr<MessageOrigin>& origin, const Dictionary::Ptr& params);
 
 	static double GetWorkQueueRate();
@@ -78,6 +82,8 @@ private:
 	AsioConditionVariable m_OutgoingMessagesQueued;
 	AsioConditionVariable m_WriterDone;
 	bool m_ShuttingDown;
+	std::atomic<bool> m_ConfigUpdateSent{false};
+	std::atomic<bool> m_FullConfigUpdateSent{false};
 	boost::asio::deadline_timer m_CheckLivenessTimer, m_HeartbeatTimer;
 
 	JsonRpcConnection(const String& identity, bool authenticated, const Shared<AsioTlsStream>::Ptr& stream, ConnectionRole role, boost::asio::io_context& io);
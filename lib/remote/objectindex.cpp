@@ -0,0 +1,260 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/objectindex.hpp"
+#include "base/array.hpp"
+#include "base/initialize.hpp"
+#include "base/objectlock.hpp"
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+using namespace icinga;
+
+std::shared_timed_mutex ObjectIndex::m_IndexesMutex;
+std::map<std::pair<Type *, String>, ObjectIndex::Ptr> ObjectIndex::m_Indexes;
+
+INITIALIZE_ONCE([]() {
+	ConfigObject::OnActiveChanged.connect([](const ConfigObject::Ptr& object, const Value&) {
+		ObjectIndex::UpdateObject(object);
+	});
+});
+
+ObjectIndex::ObjectIndex(Type::Ptr type, String attribute)
+	: m_Type(std::move(type)), m_Attribute(std::move(attribute))
+{
+	m_FieldId = m_Type->GetFieldId(m_Attribute);
+
+	if (m_FieldId == -1)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Type '" + m_Type->GetName() + "' has no attribute '" + m_Attribute + "'."));
+}
+
+const String& ObjectIndex::GetAttribute() const
+{
+	return m_Attribute;
+}
+
+/**
+ * Builds the key a value is indexed by.
+ *
+ * Keys are built so that two values have the same key if (and only if) they are equal
+ * according to the DSL's == operator, i.e. numbers and booleans are compared as numbers
+ * and strings are compared with null being equal to the empty string.
+ *
+ * @param value The value
+ * @param key Receives the key
+ *
+ * @return Whether the value can be indexed
+ */
+bool ObjectIndex::GetKey(const Value& value, String *key)
+{
+	if (value.IsNumber() || value.IsBoolean()) {
+		double number = value;
+
+		/* -0 == 0 */
+		if (number == 0)
+			number = 0;
+
+		uint64_t bits;
+		memcpy(&bits, &number, sizeof(bits));
+
+		*key = "n" + String(std::to_string(bits));
+		return true;
+	}
+
+	if (value.IsString() || value.IsEmpty()) {
+		*key = "s" + static_cast<String>(value);
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * Re-indexes the object with its current attribute value.
+ *
+ * @param object The object
+ */
+void ObjectIndex::Update(const ConfigObject::Ptr& object)
+{
+	std::unique_lock<std::mutex> lock (m_Mutex);
+
+	std::vector<String> keys;
+
+	/* Deactivated objects must not re-appear in the index. */
+	if (object->IsActive()) {
+		Value value = object->GetField(m_FieldId);
+		String key;
+
+		if (value.IsObjectType<Array>()) {
+			Array::Ptr values = value;
+			ObjectLock olock(values);
+
+			for (const Value& item : values) {
+				if (GetKey(item, &key))
+					keys.emplace_back(std::move(key));
+			}
+		} else if (GetKey(value, &key)) {
+			keys.emplace_back(std::move(key));
+		}
+	}
+
+	auto it (m_Keys.find(object.get()));
+
+	if (it != m_Keys.end()) {
+		if (it->second == keys)
+			return;
+
+		for (const String& key : it->second) {
+			auto bucket (m_Objects.find(key));
+
+			if (bucket != m_Objects.end()) {
+				bucket->second.erase(object);
+
+				if (bucket->second.empty())
+					m_Objects.erase(bucket);
+			}
+		}
+
+		m_Keys.erase(it);
+	}
+
+	if (keys.empty())
+		return;
+
+	for (const String& key : keys)
+		m_Objects[key].insert(object);
+
+	m_Keys.emplace(object.get(), std::move(keys));
+}
+
+void ObjectIndex::Remove(const ConfigObject::Ptr& object)
+{
+	std::unique_lock<std::mutex> lock (m_Mutex);
+
+	auto it (m_Keys.find(object.get()));
+
+	if (it == m_Keys.end())
+		return;
+
+	for (const String& key : it->second) {
+		auto bucket (m_Objects.find(key));
+
+		if (bucket != m_Objects.end()) {
+			bucket->second.erase(object);
+
+			if (bucket->second.empty())
+				m_Objects.erase(bucket);
+		}
+	}
+
+	m_Keys.erase(it);
+}
+
+/**
+ * Retrieves all objects whose attribute is (or contains) the given value.
+ *
+ * @param value The value to look for
+ * @param result Receives the objects
+ *
+ * @return false if the value can't be looked up in an index
+ */
+bool ObjectIndex::Find(const Value& value, std::vector<ConfigObject::Ptr>& result) const
+{
+	String key;
+
+	if (!GetKey(value, &key))
+		return false;
+
+	std::unique_lock<std::mutex> lock (m_Mutex);
+
+	auto bucket (m_Objects.find(key));
+
+	if (bucket != m_Objects.end())
+		result.insert(result.end(), bucket->second.begin(), bucket->second.end());
+
+	return true;
+}
+
+/**
+ * Returns the number of objects Find() would return.
+ *
+ * @param value The value to look for
+ *
+ * @return The number of objects or SIZE_MAX if the value can't be looked up
+ */
+size_t ObjectIndex::GetCount(const Value& value) const
+{
+	String key;
+
+	if (!GetKey(value, &key))
+		return SIZE_MAX;
+
+	std::unique_lock<std::mutex> lock (m_Mutex);
+
+	auto bucket (m_Objects.find(key));
+
+	return bucket == m_Objects.end() ? 0 : bucket->second.size();
+}
+
+/**
+ * Creates an index for an attribute of a type. This has to happen before any objects
+ * of the type are activated, i.e. at initialization time.
+ *
+ * @param type The type
+ * @param attribute The attribute's name
+ */
+void ObjectIndex::Register(const Type::Ptr& type, const String& attribute)
+{
+	ObjectIndex::Ptr index = new ObjectIndex(type, attribute);
+
+	std::unique_lock<std::shared_timed_mutex> lock (m_IndexesMutex);
+	m_Indexes.emplace(std::make_pair(type.get(), attribute), index);
+}
+
+ObjectIndex::Ptr ObjectIndex::GetByAttribute(const Type::Ptr& type, const String& attribute)
+{
+	std::shared_lock<std::shared_timed_mutex> lock (m_IndexesMutex);
+
+	auto it (m_Indexes.find(std::make_pair(type.get(), attribute)));
+
+	if (it == m_Indexes.end())
+		return nullptr;
+
+	return it->second;
+}
+
+std::vector<ObjectIndex::Ptr> ObjectIndex::GetIndexesForType(Type *type)
+{
+	std::vector<ObjectIndex::Ptr> indexes;
+	std::shared_lock<std::shared_timed_mutex> lock (m_IndexesMutex);
+
+	for (auto it (m_Indexes.lower_bound(std::make_pair(type, String()))); it != m_Indexes.end() && it->first.first == type; ++it)
+		indexes.emplace_back(it->second);
+
+	return indexes;
+}
+
+/**
+ * Updates the indexes of an object's type after an attribute has changed.
+ *
+ * @param object The object
+ * @param attribute The changed attribute, all attributes if empty
+ */
+void ObjectIndex::UpdateObject(const ConfigObject::Ptr& object, const String& attribute)
+{
+	if (attribute.IsEmpty()) {
+		for (const ObjectIndex::Ptr& index : GetIndexesForType(object->GetReflectionType().get()))
+			index->Update(object);
+	} else {
+		ObjectIndex::Ptr index = GetByAttribute(object->GetReflectionType(), attribute);
+
+		if (index)
+			index->Update(object);
+	}
+}
+
+void ObjectIndex::RemoveObject(const ConfigObject::Ptr& object)
+{
+	for (const ObjectIndex::Ptr& index : GetIndexesForType(object->GetReflectionType().get()))
+		index->Remove(object);
+}
@@ -0,0 +1,69 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef OBJECTINDEX_H
+#define OBJECTINDEX_H
+
+#include "remote/i2-remote.hpp"
+#include "base/configobject.hpp"
+#include "base/type.hpp"
+#include <map>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * A secondary index which maps the values of one attribute to the active objects of a type.
+ *
+ * Array attributes (e.g. groups) are indexed by each of their elements. The index only
+ * knows numbers, booleans and strings, objects with other values simply aren't indexed.
+ * Lookups return a superset of the objects a filter on the attribute would match, so
+ * callers still have to evaluate the filter for each of them.
+ *
+ * @ingroup remote
+ */
+class ObjectIndex final : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(ObjectIndex);
+
+	ObjectIndex(Type::Ptr type, String attribute);
+
+	const String& GetAttribute() const;
+
+	void Update(const ConfigObject::Ptr& object);
+	void Remove(const ConfigObject::Ptr& object);
+
+	bool Find(const Value& value, std::vector<ConfigObject::Ptr>& result) const;
+	size_t GetCount(const Value& value) const;
+
+	static void Register(const Type::Ptr& type, const String& attribute);
+	static ObjectIndex::Ptr GetByAttribute(const Type::Ptr& type, const String& attribute);
+
+	static void UpdateObject(const ConfigObject::Ptr& object, const String& attribute = String());
+	static void RemoveObject(const ConfigObject::Ptr& object);
+
+private:
+	Type::Ptr m_Type;
+	String m_Attribute;
+	int m_FieldId;
+
+	mutable std::mutex m_Mutex;
+	std::map<String, std::set<ConfigObject::Ptr>> m_Objects;
+	std::unordered_map<ConfigObject *, std::vector<String>> m_Keys;
+
+	static std::shared_timed_mutex m_IndexesMutex;
+	static std::map<std::pair<Type *, String>, ObjectIndex::Ptr> m_Indexes;
+
+	static bool GetKey(const Value& value, String *key);
+	static std::vector<ObjectIndex::Ptr> GetIndexesForType(Type *type);
+};
+
+}
+
+#endif /* OBJECTINDEX_H */
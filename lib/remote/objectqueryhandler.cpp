@@ -6,7 +6,15 @@
 #include "base/serializer.hpp"
 #include "base/dependencygraph.hpp"
 #include "base/configtype.hpp"
+#include "base/convert.hpp"
+#include "base/io-engine.hpp"
+#include "base/json.hpp"
 #include <boost/algorithm/string/case_conv.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/write.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <set>
 #include <unordered_map>
 
@@ -14,6 +22,12 @@ using namespace icinga;
 
 REGISTER_URLHANDLER("/v1/objects", ObjectQueryHandler);
 
+/* Number of objects serialized at once in streamed mode. */
+static const size_t l_ObjectsPerChunk = 100;
+
+/* Upper bound for the 'limit' parameter. */
+static const size_t l_MaxLimit = UINT32_MAX;
+
 Dictionary::Ptr ObjectQueryHandler::SerializeObjectAttrs(const Object::Ptr& object,
 	const String& attrPrefix, const Array::Ptr& attrs, bool isJoin, bool allAttrs)
 {
@@ -99,6 +113,7 @@ bool ObjectQueryHandler::HandleRequest(
 	HttpServerConnection& server
 )
 {
+	namespace asio = boost::asio;
 	namespace http = boost::beast::http;
 
 	if (url->GetPath().size() < 3 || url->GetPath().size() > 4)
@@ -165,8 +180,58 @@ bool ObjectQueryHandler::HandleRequest(
 		return true;
 	}
 
-	ArrayData results;
-	results.reserve(objs.size());
+	std::vector<ConfigObject::Ptr> targets;
+	targets.reserve(objs.size());
+
+	for (const ConfigObject::Ptr& obj : objs)
+		targets.emplace_back(obj);
+
+	objs.clear();
+
+	Value ulimit = HttpUtility::GetLastParameter(params, "limit");
+	String cursor = HttpUtility::GetLastParameter(params, "cursor");
+	String nextCursor;
+
+	if (!ulimit.IsEmpty() || !cursor.IsEmpty()) {
+		size_t limit = 0;
+
+		if (!ulimit.IsEmpty()) {
+			double number = -1;
+
+			try {
+				number = Convert::ToDouble(ulimit);
+			} catch (const std::exception&) {
+			}
+
+			if (!std::isfinite(number) || number < 1) {
+				HttpUtility::SendJsonError(response, params, 400,
+					"Invalid value for 'limit' specified. A positive number is required.");
+				return true;
+			}
+
+			/* Larger limits are as good as no limit, but couldn't be converted to size_t. */
+			limit = number < l_MaxLimit ? number : l_MaxLimit;
+		}
+
+		/* Object names are unique per type, which makes them a stable sort key: a cursor
+		 * stays valid even if objects are created or deleted between two requests. */
+		std::sort(targets.begin(), targets.end(), [](const ConfigObject::Ptr& a, const ConfigObject::Ptr& b) {
+			return a->GetName() < b->GetName();
+		});
+
+		if (!cursor.IsEmpty()) {
+			auto first (std::upper_bound(targets.begin(), targets.end(), cursor, [](const String& name, const ConfigObject::Ptr& obj) {
+				return name < obj->GetName();
+			}));
+
+			targets.erase(targets.begin(), first);
+		}
+
+		if (limit > 0 && targets.size() > limit) {
+			targets.resize(limit);
+			nextCursor = targets.back()->GetName();
+		}
+	}
 
 	std::set<String> joinAttrs;
 	std::set<String> userJoinAttrs;
@@ -193,7 +258,8 @@ bool ObjectQueryHandler::HandleRequest(
 	std::unordered_map<Type*, std::pair<bool, std::unique_ptr<Expression>>> typePermissions;
 	std::unordered_map<Object*, bool> objectAccessAllowed;
 
-	for (const ConfigObject::Ptr& obj : objs) {
+	/* Throws a ScriptError for invalid user input. */
+	auto serializeObject = [&](const ConfigObject::Ptr& obj) -> Dictionary::Ptr {
 		DictionaryData result1{
 			{ "name", obj->GetName() },
 			{ "type", obj->GetReflectionType()->GetName() }
@@ -223,20 +289,14 @@ bool ObjectQueryHandler::HandleRequest(
 				} else if (meta == "location") {
 					metaAttrs.emplace_back("location", obj->GetSourceLocation());
 				} else {
-					HttpUtility::SendJsonError(response, params, 400, "Invalid field specified for meta: " + meta);
-					return true;
+					BOOST_THROW_EXCEPTION(ScriptError("Invalid field specified for meta: " + meta));
 				}
 			}
 		}
 
 		result1.emplace_back("meta", new Dictionary(std::move(metaAttrs)));
 
-		try {
-			result1.emplace_back("attrs", SerializeObjectAttrs(obj, String(), uattrs, false, false));
-		} catch (const ScriptError& ex) {
-			HttpUtility::SendJsonError(response, params, 400, ex.what());
-			return true;
-		}
+		result1.emplace_back("attrs", SerializeObjectAttrs(obj, String(), uattrs, false, false));
 
 		DictionaryData joins;
 
@@ -244,17 +304,13 @@ bool ObjectQueryHandler::HandleRequest(
 			Object::Ptr joinedObj;
 			int fid = type->GetFieldId(joinAttr);
 
-			if (fid < 0) {
-				HttpUtility::SendJsonError(response, params, 400, "Invalid field specified for join: " + joinAttr);
-				return true;
-			}
+			if (fid < 0)
+				BOOST_THROW_EXCEPTION(ScriptError("Invalid field specified for join: " + joinAttr));
 
 			Field field = type->GetFieldInfo(fid);
 
-			if (!(field.Attributes & FANavigation)) {
-				HttpUtility::SendJsonError(response, params, 400, "Not a joinable field: " + joinAttr);
-				return true;
-			}
+			if (!(field.Attributes & FANavigation))
+				BOOST_THROW_EXCEPTION(ScriptError("Not a joinable field: " + joinAttr));
 
 			joinedObj = obj->NavigateField(fid);
 
@@ -306,25 +362,103 @@ bool ObjectQueryHandler::HandleRequest(
 
 			String prefix = field.NavigationName;
 
-			try {
-				joins.emplace_back(prefix, SerializeObjectAttrs(joinedObj, prefix, ujoins, true, allJoins));
-			} catch (const ScriptError& ex) {
-				HttpUtility::SendJsonError(response, params, 400, ex.what());
-				return true;
-			}
+			joins.emplace_back(prefix, SerializeObjectAttrs(joinedObj, prefix, ujoins, true, allJoins));
 		}
 
 		result1.emplace_back("joins", new Dictionary(std::move(joins)));
 
-		results.push_back(new Dictionary(std::move(result1)));
+		return new Dictionary(std::move(result1));
+	};
+
+	if (!HttpUtility::GetLastParameter(params, "stream")) {
+		ArrayData results;
+		results.reserve(targets.size());
+
+		try {
+			for (const ConfigObject::Ptr& obj : targets)
+				results.push_back(serializeObject(obj));
+		} catch (const ScriptError& ex) {
+			HttpUtility::SendJsonError(response, params, 400, ex.what());
+			return true;
+		}
+
+		Dictionary::Ptr result = new Dictionary({
+			{ "results", new Array(std::move(results)) }
+		});
+
+		if (!nextCursor.IsEmpty())
+			result->Set("next_cursor", nextCursor);
+
+		response.result(http::status::ok);
+		HttpUtility::SendJsonBody(response, params, result);
+
+		return true;
 	}
 
-	Dictionary::Ptr result = new Dictionary({
-		{ "results", new Array(std::move(results)) }
-	});
+	/* Streamed mode: The response is written in chunks of objects so that neither the
+	 * serialized objects nor the JSON document have to be kept in memory as a whole.
+	 * As all objects are of the same type, invalid attrs/joins/meta are detected when
+	 * serializing the first object, i.e. before the response header has been sent.
+	 * Errors in later objects end the document with an "error" and "status" instead of "next_cursor". */
+	String body = "{\"results\":[";
+
+	if (!targets.empty()) {
+		try {
+			body += JsonEncode(serializeObject(targets.front()));
+		} catch (const ScriptError& ex) {
+			HttpUtility::SendJsonError(response, params, 400, ex.what());
+			return true;
+		}
+	}
+
+	server.StartStreaming();
 
 	response.result(http::status::ok);
-	HttpUtility::SendJsonBody(response, params, result);
+	response.set(http::field::content_type, "application/json");
+
+	IoBoundWorkSlot dontLockTheIoThread (yc);
+
+	http::async_write(stream, response, yc);
+
+	for (size_t i = 1;;) {
+		if (i >= targets.size()) {
+			body += "]";
+
+			if (!nextCursor.IsEmpty())
+				body += ",\"next_cursor\":" + JsonEncode(nextCursor);
+
+			body += "}";
+		}
+
+		asio::async_write(stream, asio::const_buffer(body.CStr(), body.GetLength()), yc);
+		stream.async_flush(yc);
+
+		if (i >= targets.size())
+			break;
+
+		CpuBoundWork serializingObjects (yc);
+
+		body.Clear();
+
+		try {
+			for (size_t end = std::min(i + l_ObjectsPerChunk, targets.size()); i < end; i++) {
+				String object = JsonEncode(serializeObject(targets[i]));
+
+				body += ",";
+				body += object;
+			}
+		} catch (const ScriptError& ex) {
+			/* The response header has already been sent, so end the document with the error instead. */
+			body += "],\"error\":400,\"status\":" + JsonEncode(ex.what()) + "}";
+
+			serializingObjects.Done();
+
+			asio::async_write(stream, asio::const_buffer(body.CStr(), body.GetLength()), yc);
+			stream.async_flush(yc);
+
+			return true;
+		}
+	}
 
 	return true;
 }
@@ -0,0 +1,61 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/configtype.hpp"
+#include "base/defer.hpp"
+#include "base/filelogger.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+static FileLogger::Ptr MakeLogger(const String& name)
+{
+	FileLogger::Ptr logger = new FileLogger();
+	logger->SetName(name);
+
+	return logger;
+}
+
+BOOST_AUTO_TEST_SUITE(base_configtype)
+
+BOOST_AUTO_TEST_CASE(snapshot)
+{
+	FileLogger::Ptr logger1 = MakeLogger("configtype-snapshot-1");
+	logger1->Register();
+
+	Defer unregister ([&logger1]() { logger1->Unregister(); });
+
+	auto before (ConfigType::GetObjectsByType<FileLogger>());
+	auto count (before.size());
+
+	/* Readers share the snapshot until an object is (un)registered. */
+	BOOST_CHECK(ConfigType::GetObjectsByType<FileLogger>().begin() == before.begin());
+
+	FileLogger::Ptr logger2 = MakeLogger("configtype-snapshot-2");
+	size_t visited = 0;
+
+	/* Iterations in progress keep the old contents. */
+	for (auto& logger : before) {
+		(void)logger;
+
+		if (visited++ == 0)
+			logger2->Register();
+	}
+
+	BOOST_CHECK(visited == count);
+	BOOST_CHECK(before.size() == count);
+
+	auto registered (ConfigType::GetObjectsByType<FileLogger>());
+	BOOST_CHECK(registered.size() == count + 1);
+	BOOST_CHECK(registered[count] == logger2);
+
+	logger2->Unregister();
+
+	auto unregistered (ConfigType::GetObjectsByType<FileLogger>());
+	BOOST_CHECK(unregistered.size() == count);
+	BOOST_CHECK(registered.size() == count + 1);
+
+	for (auto& logger : unregistered)
+		BOOST_CHECK(logger != logger2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
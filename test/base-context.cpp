@@ -0,0 +1,121 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/context.hpp"
+#include "base/utility.hpp"
+#include <BoostTestTargetConfig.h>
+#include <boost/thread/tss.hpp>
+#include <functional>
+#include <sstream>
+#include <vector>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_context)
+
+static int l_FormatCalls = 0;
+
+static String FormatCounted(const String& name)
+{
+	l_FormatCalls++;
+	return name;
+}
+
+BOOST_AUTO_TEST_CASE(trace)
+{
+	BOOST_CHECK(ContextTrace().GetLength() == 0);
+
+	String name = "host1";
+
+	{
+		CONTEXT("Executing check for object '" << FormatCounted(name) << "'");
+
+		{
+			CONTEXT("Resolving macro '" << FormatCounted("host.address") << "'");
+
+			BOOST_CHECK(l_FormatCalls == 0);
+
+			std::ostringstream msgbuf;
+			msgbuf << ContextTrace();
+
+			BOOST_CHECK(l_FormatCalls == 2);
+			BOOST_CHECK_EQUAL(msgbuf.str(), "\n\t(0) Resolving macro 'host.address'\n\t(1) Executing check for object 'host1'\n");
+		}
+
+		BOOST_CHECK(ContextTrace().GetLength() == 1);
+	}
+
+	BOOST_CHECK(ContextTrace().GetLength() == 0);
+}
+
+/* What a context frame used to be: a std::function in a boost::thread_specific_ptr'd vector. */
+static boost::thread_specific_ptr<std::vector<std::function<void(std::ostream&)>>> l_OldFrames;
+
+class OldContextFrame
+{
+public:
+	OldContextFrame(std::function<void(std::ostream&)> message)
+	{
+		if (!l_OldFrames.get())
+			l_OldFrames.reset(new std::vector<std::function<void(std::ostream&)>>());
+
+		l_OldFrames->emplace_back(std::move(message));
+	}
+
+	~OldContextFrame()
+	{
+		l_OldFrames->pop_back();
+	}
+};
+
+static void CheckWithOldContext(const String& name, const String& command, int timeout)
+{
+	volatile OldContextFrame frame ([&](std::ostream& fp) {
+		fp << "Executing check for object '" << name << "' (command '" << command << "', timeout " << timeout << ")";
+	});
+}
+
+static void CheckWithContext(const String& name, const String& command, int timeout)
+{
+	CONTEXT("Executing check for object '" << name << "' (command '" << command << "', timeout " << timeout << ")");
+}
+
+static void CheckWithEagerContext(const String& name, const String& command, int timeout)
+{
+	std::ostringstream msgbuf;
+	msgbuf << "Executing check for object '" << name << "' (command '" << command << "', timeout " << timeout << ")";
+	volatile String message = msgbuf.str();
+}
+
+/* Not run by default, see test/CMakeLists.txt. */
+BOOST_AUTO_TEST_CASE(benchmark, *boost::unit_test::disabled())
+{
+	const int iterations = 1000000;
+	String name = "example.localdomain!disk /var", command = "disk";
+
+	double start = Utility::GetTime();
+
+	for (int i = 0; i < iterations; i++)
+		CheckWithEagerContext(name, command, i);
+
+	double eager = (Utility::GetTime() - start) / iterations * 1e9;
+
+	start = Utility::GetTime();
+
+	for (int i = 0; i < iterations; i++)
+		CheckWithOldContext(name, command, i);
+
+	double old = (Utility::GetTime() - start) / iterations * 1e9;
+
+	start = Utility::GetTime();
+
+	for (int i = 0; i < iterations; i++)
+		CheckWithContext(name, command, i);
+
+	double current = (Utility::GetTime() - start) / iterations * 1e9;
+
+	BOOST_CHECK(ContextTrace().GetLength() == 0);
+
+	BOOST_TEST_MESSAGE("Formatted frame: " << eager << " ns, std::function frame: " << old << " ns, CONTEXT(): " << current << " ns");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
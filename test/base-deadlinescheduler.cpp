@@ -0,0 +1,93 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/deadlinescheduler.hpp"
+#include "base/dictionary.hpp"
+#include "base/utility.hpp"
+#include <BoostTestTargetConfig.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+using namespace icinga;
+
+/* Records the scheduler's calls, which happen on the timer thread. Boost.Test
+ * isn't thread-safe, so the checks are done by the test on the main thread.
+ */
+class CallRecorder
+{
+public:
+	DeadlineScheduler::Callback GetCallback()
+	{
+		return [this](const Object::Ptr& object) {
+			{
+				std::unique_lock<std::mutex> lock (m_Mutex);
+				m_Calls.emplace_back(object);
+			}
+
+			m_CV.notify_all();
+		};
+	}
+
+	/* Returns the calls so far once there are at least the given number or the timeout has passed. */
+	std::vector<Object::Ptr> WaitForCalls(size_t count, double timeout = 10)
+	{
+		std::unique_lock<std::mutex> lock (m_Mutex);
+
+		m_CV.wait_for(lock, std::chrono::duration<double>(timeout), [this, count]() { return m_Calls.size() >= count; });
+
+		return m_Calls;
+	}
+
+private:
+	std::mutex m_Mutex;
+	std::condition_variable m_CV;
+	std::vector<Object::Ptr> m_Calls;
+};
+
+BOOST_AUTO_TEST_SUITE(base_deadlinescheduler)
+
+BOOST_AUTO_TEST_CASE(due)
+{
+	CallRecorder recorder;
+	Object::Ptr due = new Dictionary(), later = new Dictionary(), unscheduled = new Dictionary();
+
+	DeadlineScheduler::Ptr scheduler = new DeadlineScheduler("test", recorder.GetCallback(), 0.1);
+
+	double now = Utility::GetTime();
+	scheduler->Schedule(unscheduled, now + 0.1);
+	scheduler->Schedule(due, now + 0.2);
+	scheduler->Schedule(later, now + 60);
+	scheduler->Unschedule(unscheduled);
+
+	BOOST_CHECK(scheduler->GetLength() == 2);
+
+	/* The unscheduled object would have been due first. */
+	BOOST_CHECK(recorder.WaitForCalls(1) == std::vector<Object::Ptr>({ due }));
+	BOOST_CHECK(scheduler->GetLength() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(reschedule)
+{
+	CallRecorder recorder;
+	Object::Ptr object = new Dictionary(), marker = new Dictionary();
+
+	DeadlineScheduler::Ptr scheduler = new DeadlineScheduler("test", recorder.GetCallback(), 0.1);
+
+	double now = Utility::GetTime();
+	scheduler->Schedule(object, now + 0.1);
+	scheduler->Schedule(object, now + 60);
+	scheduler->Schedule(marker, now + 0.2);
+
+	BOOST_CHECK(scheduler->GetLength() == 2);
+
+	/* The object's old deadline has passed before the marker's. */
+	BOOST_CHECK(recorder.WaitForCalls(1) == std::vector<Object::Ptr>({ marker }));
+
+	scheduler->Schedule(object, Utility::GetTime());
+
+	BOOST_CHECK(recorder.WaitForCalls(2) == std::vector<Object::Ptr>({ marker, object }));
+	BOOST_CHECK(scheduler->GetLength() == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -2,10 +2,14 @@
 
 #include "base/dictionary.hpp"
 #include "base/objectlock.hpp"
+#include "base/convert.hpp"
 #include "base/json.hpp"
 #include "base/string.hpp"
 #include "base/utility.hpp"
 #include <BoostTestTargetConfig.h>
+#include <atomic>
+#include <map>
+#include <thread>
 
 using namespace icinga;
 
@@ -197,4 +201,194 @@ BOOST_AUTO_TEST_CASE(keys_ordered)
 	BOOST_CHECK(std::is_sorted(keys.begin(), keys.end()));
 }
 
+BOOST_AUTO_TEST_CASE(hashed)
+{
+	/* Grow and shrink a dictionary beyond the size it gets a hash table at and compare it with a std::map. */
+	Dictionary::Ptr dictionary = new Dictionary();
+	std::map<String, Value> expected;
+
+	for (int i = 0; i < 20000; i++) {
+		String key = "key" + Convert::ToString(Utility::Random() % (i < 10000 ? 1000 : 40));
+
+		if (Utility::Random() % 3) {
+			dictionary->Set(key, i);
+			expected[key] = i;
+		} else {
+			dictionary->Remove(key);
+			expected.erase(key);
+		}
+
+		if (i % 500 == 0) {
+			for (int j = 0; j < 1000; j++) {
+				String key = "key" + Convert::ToString(j);
+				auto it (expected.find(key));
+
+				BOOST_REQUIRE(dictionary->Contains(key) == (it != expected.end()));
+
+				if (it != expected.end())
+					BOOST_REQUIRE(dictionary->Get(key) == it->second);
+			}
+		}
+	}
+
+	BOOST_CHECK(dictionary->GetLength() == expected.size());
+
+	std::vector<String> keys;
+
+	for (auto& kv : expected)
+		keys.push_back(kv.first);
+
+	BOOST_CHECK(dictionary->GetKeys() == keys);
+
+	DictionaryData data;
+
+	for (int i = 0; i < 100; i++)
+		data.emplace_back(Convert::ToString(99 - i), i);
+
+	data.emplace_back("0", "duplicate");
+
+	Dictionary::Ptr constructed = new Dictionary(std::move(data));
+
+	BOOST_CHECK(constructed->GetLength() == 100);
+	BOOST_CHECK(constructed->Get("0") == 99);
+	BOOST_CHECK(constructed->Get("99") == 0);
+
+	keys = constructed->GetKeys();
+	BOOST_CHECK(std::is_sorted(keys.begin(), keys.end()));
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_lookups)
+{
+	/* Keys set in descending order invalidate the hash table over and over again. */
+	Dictionary::Ptr dictionary = new Dictionary();
+
+	for (int i = 999; i >= 0; i--)
+		dictionary->Set("key" + Convert::ToString(i), i);
+
+	/* One of the readers rebuilds it, the others fall back to binary search meanwhile. */
+	std::atomic<int> mismatches (0);
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < 4; i++) {
+		threads.emplace_back([&dictionary, &mismatches]() {
+			for (int j = 0; j < 10000; j++) {
+				if (dictionary->Get("key" + Convert::ToString(j % 1000)) != j % 1000)
+					mismatches++;
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	BOOST_CHECK(mismatches == 0);
+
+	Dictionary::Ptr clone = dictionary->ShallowClone();
+
+	dictionary->Remove("key500");
+	BOOST_CHECK(!dictionary->Contains("key500"));
+	BOOST_CHECK(dictionary->Get("key501") == 501);
+	BOOST_CHECK(dictionary->Get("key499") == 499);
+
+	clone->Set("key1000", 1000);
+	BOOST_CHECK(clone->Get("key500") == 500);
+	BOOST_CHECK(clone->Get("key1000") == 1000);
+	BOOST_CHECK(clone->GetLength() == 1001);
+}
+
+/* Not run by default, see test/CMakeLists.txt. */
+BOOST_AUTO_TEST_CASE(benchmark, *boost::unit_test::disabled())
+{
+	/* The attributes of a serialized check result. */
+	std::vector<String> keys {
+		"active", "check_source", "command", "execution_end", "execution_start", "exit_status", "output",
+		"performance_data", "schedule_end", "schedule_start", "scheduling_source", "state", "ttl", "type",
+		"vars_after", "vars_before"
+	};
+
+	const int iterations = 100000;
+	double start = Utility::GetTime();
+
+	for (int i = 0; i < iterations; i++) {
+		std::map<String, Value> map;
+
+		for (auto& key : keys)
+			map.emplace(key, i);
+	}
+
+	double constructMap = (Utility::GetTime() - start) / iterations * 1e9;
+
+	start = Utility::GetTime();
+
+	for (int i = 0; i < iterations; i++) {
+		DictionaryData data;
+		data.reserve(keys.size());
+
+		for (auto& key : keys)
+			data.emplace_back(key, i);
+
+		Dictionary::Ptr dictionary = new Dictionary(std::move(data));
+	}
+
+	double construct = (Utility::GetTime() - start) / iterations * 1e9;
+
+	std::map<String, Value> map;
+	Dictionary::Ptr dictionary = new Dictionary();
+
+	for (auto& key : keys) {
+		map.emplace(key, 42);
+		dictionary->Set(key, 42);
+	}
+
+	size_t found = 0;
+	start = Utility::GetTime();
+
+	for (int i = 0; i < iterations; i++) {
+		for (auto& key : keys)
+			found += map.find(key) != map.end();
+	}
+
+	double lookupMap = (Utility::GetTime() - start) / iterations / keys.size() * 1e9;
+
+	start = Utility::GetTime();
+
+	for (int i = 0; i < iterations; i++) {
+		for (auto& key : keys)
+			found += dictionary->Contains(key);
+	}
+
+	double lookup = (Utility::GetTime() - start) / iterations / keys.size() * 1e9;
+
+	BOOST_CHECK(found == iterations * keys.size() * 2);
+
+	/* Not in key order, i.e. most pairs are inserted in the middle. */
+	start = Utility::GetTime();
+
+	Dictionary::Ptr large = new Dictionary();
+
+	for (int i = 0; i < 10000; i++)
+		large->Set("host" + Convert::ToString(i) + ".example.com", i);
+
+	double constructLarge = (Utility::GetTime() - start) / 10000 * 1e9;
+
+	start = Utility::GetTime();
+
+	for (int i = 0; i < iterations; i++)
+		found += large->Contains("host" + Convert::ToString(i % 10000) + ".example.com");
+
+	double lookupLarge = (Utility::GetTime() - start) / iterations * 1e9;
+
+	start = Utility::GetTime();
+
+	for (int i = 0; i < iterations / 10; i++)
+		JsonEncode(dictionary);
+
+	double encode = (Utility::GetTime() - start) / (iterations / 10) * 1e9;
+
+	BOOST_TEST_MESSAGE("Construct: std::map " << constructMap << " ns, Dictionary " << construct << " ns; "
+		<< "set 10000 pairs: " << constructLarge << " ns; "
+		<< "lookup: std::map " << lookupMap << " ns, Dictionary " << lookup << " ns, 10000 pairs " << lookupLarge << " ns; "
+		<< "JSON encode: " << encode << " ns");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -100,6 +100,23 @@ BOOST_AUTO_TEST_CASE(decode)
 	BOOST_CHECK(uint.IsNumber() && uint.Get<double>() == 23.0);
 }
 
+BOOST_AUTO_TEST_CASE(decode_objects)
+{
+	auto output ((Dictionary::Ptr)JsonDecode(R"EOF({"b": {"z": 1, "y": [{"x": 2}], "z": 3}, "a": 4})EOF"));
+	BOOST_CHECK(output->GetKeys() == std::vector<String>({"a", "b"}));
+	BOOST_CHECK(output->Get("a") == 4);
+
+	auto b ((Dictionary::Ptr)output->Get("b"));
+	BOOST_CHECK(b->GetKeys() == std::vector<String>({"y", "z"}));
+
+	/* The last of duplicate keys wins. */
+	BOOST_CHECK(b->Get("z") == 3);
+
+	auto y ((Array::Ptr)b->Get("y"));
+	BOOST_REQUIRE(y->GetLength() == 1u);
+	BOOST_CHECK(((Dictionary::Ptr)y->Get(0))->Get("x") == 2);
+}
+
 BOOST_AUTO_TEST_CASE(invalid1)
 {
 	BOOST_CHECK_THROW(JsonDecode("\"1.7"), std::exception);
@@ -0,0 +1,56 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "db_ido_pgsql/idopgsqlconnection.hpp"
+#include <BoostTestTargetConfig.h>
+#include <cstring>
+
+using namespace icinga;
+
+static String FormatCopyValue(const Value& rawvalue, bool timestamp = false)
+{
+	std::ostringstream row;
+	IdoPgsqlConnection::FormatCopyValue(rawvalue, timestamp, row);
+	return row.str();
+}
+
+BOOST_AUTO_TEST_SUITE(db_ido_pgsql_idopgsqlconnection)
+
+BOOST_AUTO_TEST_CASE(null_values)
+{
+	BOOST_CHECK(IdoPgsqlConnection::IsNull(Empty));
+	BOOST_CHECK(!IdoPgsqlConnection::IsNull(""));
+	BOOST_CHECK(!IdoPgsqlConnection::IsNull(0));
+	BOOST_CHECK(!IdoPgsqlConnection::IsNull(false));
+}
+
+BOOST_AUTO_TEST_CASE(parameters)
+{
+	std::vector<String> values;
+	std::vector<const char *> valuePtrs;
+
+	IdoPgsqlConnection::GetParameterValues({ Empty, "", "foo", 42, Empty }, values, valuePtrs);
+
+	BOOST_REQUIRE(valuePtrs.size() == 5);
+	BOOST_CHECK(valuePtrs[0] == nullptr);
+	BOOST_REQUIRE(valuePtrs[1] != nullptr);
+	BOOST_CHECK(strcmp(valuePtrs[1], "") == 0);
+	BOOST_REQUIRE(valuePtrs[2] != nullptr);
+	BOOST_CHECK(strcmp(valuePtrs[2], "foo") == 0);
+	BOOST_REQUIRE(valuePtrs[3] != nullptr);
+	BOOST_CHECK(strcmp(valuePtrs[3], "42") == 0);
+	BOOST_CHECK(valuePtrs[4] == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(copy_values)
+{
+	BOOST_CHECK(FormatCopyValue(Empty) == "\\N");
+	BOOST_CHECK(FormatCopyValue(Empty, true) == "\\N");
+	BOOST_CHECK(FormatCopyValue("") == "");
+	BOOST_CHECK(FormatCopyValue("foo") == "foo");
+	BOOST_CHECK(FormatCopyValue(42) == "42");
+	BOOST_CHECK(FormatCopyValue("a\\b\tc\nd\re") == "a\\\\b\\tc\\nd\\re");
+	BOOST_CHECK(FormatCopyValue("\\N") == "\\\\N");
+	BOOST_CHECK(FormatCopyValue(0, true) == "1970-01-01T00:00:00");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
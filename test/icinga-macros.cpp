@@ -34,6 +34,12 @@ BOOST_AUTO_TEST_CASE(simple)
 	Array::Ptr result = MacroProcessor::ResolveMacros("$testD$", resolvers);
 	BOOST_CHECK(result->GetLength() == 2);
 
+	/* compiled macro strings are cached, resolving them again must yield the same */
+	BOOST_CHECK(MacroProcessor::ResolveMacros("$macrosA.testB$ $macrosB.testC$", resolvers) == "hello world");
+	BOOST_CHECK(MacroProcessor::ResolveMacros("a $$ b $$", resolvers) == "a $ b $");
+	BOOST_CHECK_THROW(MacroProcessor::ResolveMacros("$testB$ $testD$", resolvers), std::invalid_argument);
+	BOOST_CHECK_THROW(MacroProcessor::ResolveMacros("$testB$ $testC", resolvers), std::runtime_error);
+
 	/* verify the config validator macro checks */
 	BOOST_CHECK(MacroProcessor::ValidateMacroString("$host.address") == false);
 	BOOST_CHECK(MacroProcessor::ValidateMacroString("host.vars.test$") == false);
@@ -1,7 +1,10 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "base/perfdatavalue.hpp"
+#include "icinga/checkresult.hpp"
 #include "icinga/pluginutility.hpp"
+#include "base/objectlock.hpp"
+#include "base/utility.hpp"
 #include <BoostTestTargetConfig.h>
 
 using namespace icinga;
@@ -389,4 +392,140 @@ BOOST_AUTO_TEST_CASE(parse_edgecases)
 	BOOST_CHECK(pv->GetUnit() == "bytes");
 }
 
+BOOST_AUTO_TEST_CASE(parse_view)
+{
+	std::vector<PerfdataValueView> pdvs;
+	String perfdata = "'used space'=1.5GB;2;3;0;10 check_multi::one::time=1ms two=1;1;1:2";
+
+	BOOST_CHECK(PluginUtility::ParsePerfdata(perfdata.GetData(), pdvs) == 0);
+	BOOST_REQUIRE(pdvs.size() == 3);
+
+	BOOST_CHECK(pdvs[0].Label == "used space");
+	BOOST_CHECK(pdvs[0].MultiPrefix.empty());
+	BOOST_CHECK(pdvs[0].Value == 1.5e9);
+	BOOST_CHECK(pdvs[0].Unit == std::string("bytes"));
+	BOOST_CHECK(pdvs[0].Warn == 2e9);
+	BOOST_CHECK(pdvs[0].Max == 10e9);
+
+	BOOST_CHECK(pdvs[1].Label == "check_multi::one::time");
+	BOOST_CHECK(pdvs[1].Value == 0.001);
+
+	PerfdataValue::Ptr pdv = new PerfdataValue(pdvs[2]);
+	BOOST_CHECK(pdv->GetLabel() == "check_multi::one::two");
+	BOOST_CHECK(pdv->GetWarn() == 1);
+	BOOST_CHECK(pdv->GetCrit() == Empty);
+
+	pdvs.clear();
+	BOOST_CHECK(PluginUtility::ParsePerfdata("a=1 b=1,5 c=x d=2", pdvs) == 2);
+	BOOST_CHECK(pdvs.size() == 2);
+}
+
+/* Performance data of the monitoring-plugins and some popular third party plugins. */
+static const std::vector<String> l_PerfdataCorpus {
+	"/=2643MB;5948;5958;0;5968 /boot=68MB;88;93;0;98 /home=69357MB;253404;253409;0;253414 /var/log=818MB;970;975;0;980",
+	"rta=0.062000ms;100.000000;500.000000;0.000000 pl=0%;20;60;0",
+	"load1=0.010;5.000;10.000;0; load5=0.040;4.000;6.000;0; load15=0.050;3.000;4.000;0;",
+	"time=0.001213s;;;0.000000;10.000000 size=8565B;;;0",
+	"procs=210;250;400;0; ",
+	"'swap'=2047MiB;0;0;0;2047",
+	"Connections=98017c;;; Open_files=10;;; Open_tables=64;;; Queries_per_second=17.98QPS;;; Slow_queries=0c;;;",
+	"users=3;20;50;0",
+	"'eth0_in_bps'=8123.34;;;0;1000000000 'eth0_out_bps'=20112.82;;;0;1000000000 'eth0_in_errors'=0c;;;0; 'eth0_out_errors'=0c;;;0;",
+	"offset=-0.000125s;60.000000;120.000000; jitter=0.012000s;;; stratum=3;;;0;16",
+	"check_multi::check_multi::plugins=2 time=0.11 'disk_root'::check_disk::/=2643MB;5948;5958;0;5968 'load'::check_load::load1=0.010;5.000;10.000;0;",
+	"'C:\\ used %'=24%;89;94;0;100 'C:\\ used'=56.51GB;209.13;220.88;0;235.01",
+	"temp=41.5C;60;80 fan1=2100;;;0; voltage=12.1V;;;0;13",
+	"days_valid=350;;;0; time=0.08s;5;10;0;"
+};
+
+BOOST_AUTO_TEST_CASE(parse_corpus)
+{
+	for (const String& perfdata : l_PerfdataCorpus) {
+		std::vector<PerfdataValueView> views;
+		BOOST_CHECK(PluginUtility::ParsePerfdata(perfdata.GetData(), views) == 0);
+
+		CheckResult::Ptr cr = new CheckResult();
+		cr->SetPerformanceData(PluginUtility::SplitPerfdata(perfdata));
+
+		auto parsed (cr->GetParsedPerformanceData());
+		BOOST_REQUIRE(views.size() == parsed->size());
+
+		for (size_t i = 0; i < views.size(); i++) {
+			PerfdataValue::Ptr expected = PerfdataValue::Parse((*parsed)[i].Raw);
+			PerfdataValue::Ptr actual = new PerfdataValue(views[i]);
+
+			BOOST_REQUIRE((*parsed)[i].Parsed);
+			BOOST_CHECK_EQUAL((*parsed)[i].Parsed->Format(), expected->Format());
+			BOOST_CHECK_EQUAL(actual->Format(), expected->Format());
+			BOOST_CHECK_EQUAL(actual->GetLabel(), expected->GetLabel());
+			BOOST_CHECK_EQUAL(actual->GetUnit(), expected->GetUnit());
+		}
+	}
+
+	CheckResult::Ptr cr = new CheckResult();
+	cr->SetPerformanceData(new Array({ "a=1", "b=1,5", 2, new PerfdataValue("c", 3) }));
+
+	auto parsed (cr->GetParsedPerformanceData());
+	BOOST_REQUIRE(parsed->size() == 4);
+	BOOST_CHECK((*parsed)[0].Parsed && (*parsed)[0].Parsed->GetValue() == 1);
+	BOOST_CHECK(!(*parsed)[1].Parsed);
+	BOOST_CHECK(!(*parsed)[2].Parsed);
+	BOOST_CHECK((*parsed)[3].Parsed && (*parsed)[3].Parsed->GetLabel() == "c");
+}
+
+/* Not run by default, see test/CMakeLists.txt.
+ *
+ * "SplitPerfdata() + Parse()" is the code path the checker and the perfdata writers used
+ * before PerfdataValue::ParseView() existed, run this test case on such a tree for a baseline. */
+BOOST_AUTO_TEST_CASE(parse_benchmark, *boost::unit_test::disabled())
+{
+	const int iterations = 2000;
+	size_t count = 0;
+	double start = Utility::GetTime();
+
+	for (int i = 0; i < iterations; i++) {
+		for (const String& perfdata : l_PerfdataCorpus) {
+			Array::Ptr pdvs = PluginUtility::SplitPerfdata(perfdata);
+			ObjectLock olock(pdvs);
+
+			for (const Value& pdv : pdvs) {
+				PerfdataValue::Parse(pdv);
+				count++;
+			}
+		}
+	}
+
+	double objects = (Utility::GetTime() - start) / count * 1e9;
+
+	count = 0;
+	start = Utility::GetTime();
+
+	for (int i = 0; i < iterations; i++) {
+		for (const String& perfdata : l_PerfdataCorpus) {
+			CheckResult::Ptr cr = new CheckResult();
+			cr->SetPerformanceData(PluginUtility::SplitPerfdata(perfdata));
+			count += cr->GetParsedPerformanceData()->size();
+		}
+	}
+
+	double checkResult = (Utility::GetTime() - start) / count * 1e9;
+
+	std::vector<PerfdataValueView> views;
+	count = 0;
+	start = Utility::GetTime();
+
+	for (int i = 0; i < iterations; i++) {
+		for (const String& perfdata : l_PerfdataCorpus) {
+			views.clear();
+			PluginUtility::ParsePerfdata(perfdata.GetData(), views);
+			count += views.size();
+		}
+	}
+
+	double flat = (Utility::GetTime() - start) / count * 1e9;
+
+	BOOST_TEST_MESSAGE("SplitPerfdata() + Parse(): " << objects << " ns/value, SplitPerfdata() + GetParsedPerformanceData(): "
+		<< checkResult << " ns/value, ParsePerfdata(): " << flat << " ns/value");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,86 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "livestatus/livestatuslistener.hpp"
+#include "base/defer.hpp"
+#include <boost/asio/buffers_iterator.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <BoostTestTargetConfig.h>
+#include <chrono>
+#include <iterator>
+
+using namespace icinga;
+
+namespace asio = boost::asio;
+namespace fs = boost::filesystem;
+
+#ifndef _WIN32
+
+/**
+ * Sends a query to a listener and reads the response until it closes the connection.
+ *
+ * @returns The response or, if the listener hasn't answered within 10 seconds, an empty string.
+ */
+static String Query(const String& socketPath, const String& query)
+{
+	using asio::local::stream_protocol;
+
+	asio::io_context io;
+	stream_protocol::socket client (io);
+
+	client.connect(stream_protocol::endpoint(socketPath.GetData()));
+	asio::write(client, asio::buffer(query.CStr(), query.GetLength()));
+
+	/* The connection isn't shut down for writing, so only the blank line ends the query. */
+	asio::streambuf buf;
+	bool done = false;
+
+	asio::async_read(client, buf, [&done](const boost::system::error_code&, size_t) {
+		done = true;
+	});
+
+	io.run_for(std::chrono::seconds(10));
+
+	if (!done)
+		return String();
+
+	return String(asio::buffers_begin(buf.data()), asio::buffers_end(buf.data()));
+}
+
+BOOST_AUTO_TEST_SUITE(livestatus_listener)
+
+BOOST_AUTO_TEST_CASE(crlf)
+{
+	fs::path dir (fs::temp_directory_path() / fs::unique_path("icinga2-livestatus-%%%%-%%%%"));
+	fs::create_directories(dir);
+
+	String socketPath = (dir / "livestatus").string();
+
+	LivestatusListener::Ptr listener = new LivestatusListener();
+	listener->SetName("livestatus-listener-crlf");
+	listener->SetSocketType("unix");
+	listener->SetSocketPath(socketPath);
+	listener->Register();
+	listener->Activate();
+
+	Defer cleanup ([&listener, &dir]() {
+		listener->Deactivate();
+		listener->Unregister();
+
+		fs::remove_all(dir);
+	});
+
+	String response = Query(socketPath, "GET hosts\r\nColumns: host_name\r\nFilter: host_name = test-01\r\n"
+		"ResponseHeader: fixed16\r\n\r\n");
+
+	BOOST_REQUIRE_MESSAGE(response.GetLength() >= 16 && response.SubStr(0, 3) == "200", "response: " + response);
+	BOOST_CHECK(response.SubStr(16) == "test-01\n");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif /* _WIN32 */
@@ -0,0 +1,199 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "livestatus/livestatuslogindex.hpp"
+#include "base/configuration.hpp"
+#include "base/tlsutility.hpp"
+#include "base/utility.hpp"
+#include <boost/filesystem/operations.hpp>
+#include <BoostTestTargetConfig.h>
+#include <fstream>
+#include <iterator>
+
+using namespace icinga;
+
+namespace fs = boost::filesystem;
+
+static const char * const l_LogLines =
+	"[1600001000] LOG VERSION: 2.0\n"
+	"[1600001001] HOST ALERT: host-1;DOWN;HARD;1;down\n"
+	"[1600001002] SERVICE ALERT: host-1;service-1;CRITICAL;HARD;1;critical\n"
+	"[1600001003] SERVICE ALERT: host-2;service-1;OK;HARD;1;ok\n"
+	"[1600001004] HOST NOTIFICATION: user;host-2;DOWN;DOWN;notify;down\n"
+	"[1600001005] SERVICE ALERT: host-1;service-2;WARNING;SOFT;1;warning\n";
+
+struct LogIndexFixture
+{
+	LogIndexFixture()
+		: Dir(fs::temp_directory_path() / fs::unique_path("icinga2-logindex-%%%%-%%%%")), OldDataDir(Configuration::DataDir)
+	{
+		fs::create_directories(Dir / "archives");
+		Configuration::DataDir = (Dir / "data").string();
+	}
+
+	~LogIndexFixture()
+	{
+		Configuration::DataDir = OldDataDir;
+		fs::remove_all(Dir);
+		LivestatusLogIndex::RemoveMissing();
+	}
+
+	String GetPath(const String& name) const
+	{
+		return (Dir / name.GetData()).string();
+	}
+
+	static void Write(const String& path, const String& text, std::ios::openmode mode = std::ios::trunc)
+	{
+		std::ofstream fp (path.CStr(), std::ios::out | std::ios::binary | mode);
+		fp << text;
+	}
+
+	fs::path Dir;
+	String OldDataDir;
+};
+
+static std::vector<size_t> MakeLines(std::initializer_list<size_t> lines)
+{
+	return lines;
+}
+
+static std::vector<std::pair<size_t, String>> ReadLines(const LivestatusLogIndex::Ptr& index, const std::vector<size_t>& linenos)
+{
+	std::vector<std::pair<size_t, String>> lines;
+
+	index->ReadLines(linenos, [&lines](size_t lineno, const String& line) {
+		lines.emplace_back(lineno, line);
+	});
+
+	return lines;
+}
+
+BOOST_FIXTURE_TEST_SUITE(livestatus_logindex, LogIndexFixture)
+
+BOOST_AUTO_TEST_CASE(lines)
+{
+	String path = GetPath("icinga.log");
+	Write(path, l_LogLines);
+
+	LivestatusLogIndex::Ptr index = LivestatusLogIndex::GetByPath(path, false);
+
+	BOOST_CHECK(index->GetLineCount() == 6);
+	BOOST_CHECK(index->GetStartTime() == 1600001000);
+	BOOST_CHECK(index->GetEndTime() == 1600001005);
+
+	BOOST_CHECK(index->FindLine(0) == 0);
+	BOOST_CHECK(index->FindLine(1600001002) == 2);
+	BOOST_CHECK(index->FindLine(1600002000) == 6);
+
+	BOOST_CHECK(index->GetLinesByObject("host-1") == MakeLines({ 1, 2, 5 }));
+	BOOST_CHECK(index->GetLinesByObject("host-1", "service-1") == MakeLines({ 2 }));
+	BOOST_CHECK(index->GetLinesByObject("host-2") == MakeLines({ 3, 4 }));
+	BOOST_CHECK(index->GetLinesByObject("host-2", "service-2").empty());
+	BOOST_CHECK(index->GetLinesByObject("host-3").empty());
+
+	auto lines (ReadLines(index, { 2, 5 }));
+	BOOST_REQUIRE(lines.size() == 2);
+	BOOST_CHECK(lines[0].first == 2);
+	BOOST_CHECK(lines[0].second == "[1600001002] SERVICE ALERT: host-1;service-1;CRITICAL;HARD;1;critical");
+	BOOST_CHECK(lines[1].first == 5);
+	BOOST_CHECK(lines[1].second == "[1600001005] SERVICE ALERT: host-1;service-2;WARNING;SOFT;1;warning");
+
+	size_t count = 0;
+	index->ReadLines(4, SIZE_MAX, [&count](size_t lineno, const String&) {
+		BOOST_CHECK(lineno == 4 + count);
+		count++;
+	});
+	BOOST_CHECK(count == 2);
+}
+
+BOOST_AUTO_TEST_CASE(append_and_rotate)
+{
+	String path = GetPath("icinga.log");
+	Write(path, l_LogLines);
+
+	LivestatusLogIndex::Ptr index = LivestatusLogIndex::GetByPath(path, false);
+	BOOST_CHECK(index->GetLineCount() == 6);
+
+	/* Incomplete lines are only indexed once they're complete. */
+	Write(path, "[1600001006] HOST ALERT: host-2;UP;HARD;1;up\n[1600001007] HOST ALE", std::ios::app);
+
+	BOOST_CHECK(LivestatusLogIndex::GetByPath(path, false) == index);
+	BOOST_CHECK(index->GetLineCount() == 7);
+	BOOST_CHECK(index->GetLinesByObject("host-2") == MakeLines({ 3, 4, 6 }));
+
+	Write(path, "RT: host-1;UP;HARD;1;up\n", std::ios::app);
+
+	LivestatusLogIndex::GetByPath(path, false);
+	BOOST_CHECK(index->GetLineCount() == 8);
+	BOOST_CHECK(index->GetLinesByObject("host-1") == MakeLines({ 1, 2, 5, 7 }));
+
+	auto lines (ReadLines(index, { 7 }));
+	BOOST_REQUIRE(lines.size() == 1);
+	BOOST_CHECK(lines[0].second == "[1600001007] HOST ALERT: host-1;UP;HARD;1;up");
+
+	/* A rotated log file starts from scratch. */
+	Write(path, "[1600002000] LOG VERSION: 2.0\n[1600002001] HOST ALERT: host-3;DOWN;HARD;1;down\n");
+
+	LivestatusLogIndex::GetByPath(path, false);
+	BOOST_CHECK(index->GetLineCount() == 2);
+	BOOST_CHECK(index->GetStartTime() == 1600002000);
+	BOOST_CHECK(index->GetLinesByObject("host-1").empty());
+	BOOST_CHECK(index->GetLinesByObject("host-3") == MakeLines({ 1 }));
+}
+
+BOOST_AUTO_TEST_CASE(persistence)
+{
+	String path = GetPath("archives/icinga-01-01-1970-00.log");
+	Write(path, l_LogLines);
+
+	LivestatusLogIndex::Ptr index = LivestatusLogIndex::GetByPath(path, true);
+	BOOST_CHECK(index->GetLineCount() == 6);
+
+	String indexPath = Configuration::DataDir + "/livestatus/log-index/" + SHA256(path) + ".idx";
+	BOOST_REQUIRE(Utility::PathExists(indexPath));
+
+	String indexText;
+
+	{
+		std::ifstream fp (indexPath.CStr());
+		indexText = String(std::istreambuf_iterator<char>(fp), std::istreambuf_iterator<char>());
+	}
+
+	/* Evicted along with the file on disk once the log file is gone. */
+	String movedPath = GetPath("moved.log");
+	fs::rename(path.CStr(), movedPath.CStr());
+
+	LivestatusLogIndex::RemoveMissing();
+	BOOST_CHECK(!Utility::PathExists(indexPath));
+
+	/* Restore the log file (with its mtime) and a modified copy of its index,
+	 * which proves that the index is loaded rather than rebuilt. */
+	fs::rename(movedPath.CStr(), path.CStr());
+
+	String::SizeType pos = indexText.Find("host-1\t");
+	BOOST_REQUIRE(pos != String::NPos);
+	indexText = indexText.SubStr(0, pos) + "host-1\t5 \n" + indexText.SubStr(indexText.Find("\n", pos) + 1);
+
+	Write(indexPath, indexText);
+
+	LivestatusLogIndex::Ptr loadedIndex = LivestatusLogIndex::GetByPath(path, true);
+	BOOST_CHECK(loadedIndex != index);
+	BOOST_CHECK(loadedIndex->GetLineCount() == 6);
+	BOOST_CHECK(loadedIndex->GetLinesByObject("host-1") == MakeLines({ 5 }));
+	BOOST_CHECK(loadedIndex->GetLinesByObject("host-2") == MakeLines({ 3, 4 }));
+
+	/* A stored index doesn't match a log file with a different size. */
+	fs::remove(path.CStr());
+	LivestatusLogIndex::RemoveMissing();
+	Write(path, String(l_LogLines) + "[1600001006] HOST ALERT: host-1;UP;HARD;1;up\n");
+	Write(indexPath, indexText);
+
+	loadedIndex = LivestatusLogIndex::GetByPath(path, true);
+	BOOST_CHECK(loadedIndex->GetLineCount() == 7);
+	BOOST_CHECK(loadedIndex->GetLinesByObject("host-1") == MakeLines({ 1, 2, 5, 6 }));
+
+	fs::remove(path.CStr());
+	LivestatusLogIndex::RemoveMissing();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
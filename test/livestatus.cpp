@@ -1,16 +1,22 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "livestatus/livestatusquery.hpp"
+#include "config/configcompiler.hpp"
+#include "config/configitem.hpp"
 #include "base/application.hpp"
+#include "base/function.hpp"
 #include "base/stdiostream.hpp"
 #include "base/json.hpp"
+#include "base/utility.hpp"
+#include <boost/filesystem/operations.hpp>
 #include <BoostTestTargetConfig.h>
+#include <fstream>
 
 using namespace icinga;
 
-String LivestatusQueryHelper(const std::vector<String>& lines)
+String LivestatusQueryHelper(const std::vector<String>& lines, const String& compatLogPath = "")
 {
-	LivestatusQuery::Ptr query = new LivestatusQuery(lines, "");
+	LivestatusQuery::Ptr query = new LivestatusQuery(lines, compatLogPath);
 
 	std::stringstream stream;
 	StdioStream::Ptr sstream = new StdioStream(&stream, false);
@@ -102,6 +108,112 @@ BOOST_AUTO_TEST_CASE(services)
 
 	BOOST_TEST_MESSAGE("Done with testing livestatus services...");
 }
+
+BOOST_AUTO_TEST_CASE(log_object_filter)
+{
+	namespace fs = boost::filesystem;
+
+	fs::path dir (fs::temp_directory_path() / fs::unique_path("icinga2-livestatus-%%%%-%%%%"));
+	fs::create_directories(dir / "archives");
+
+	{
+		std::ofstream fp ((dir / "icinga.log").string());
+		fp << "[1600001000] LOG VERSION: 2.0\n"
+			<< "[1600001001] HOST ALERT: test-01;DOWN;HARD;1;down\n"
+			<< "[1600001002] SERVICE ALERT: test-01;livestatus;CRITICAL;HARD;1;critical\n"
+			<< "[1600001003] SERVICE ALERT: test-02;livestatus;OK;HARD;1;ok\n"
+			<< "[1600001004] HOST ALERT: test-02;DOWN;HARD;1;down\n"
+			<< "[1600001005] SERVICE ALERT: test-01;livestatus;OK;HARD;1;ok\n";
+	}
+
+	String compatLogPath = dir.string();
+
+	/* '~' isn't pushed down to the table, i.e. all log entries are read. */
+	auto query ([&compatLogPath](const String& table, const String& columns, const std::vector<String>& filters) {
+		std::vector<String> lines { "GET " + table, "Columns: " + columns, "OutputFormat: json" };
+		lines.insert(lines.end(), filters.begin(), filters.end());
+
+		return LivestatusQueryHelper(lines, compatLogPath);
+	});
+
+	String hostLines = query("log", "lineno", { "Filter: host_name = test-01" });
+	BOOST_CHECK(hostLines.Contains("[2]") && hostLines.Contains("[5]") && !hostLines.Contains("[3]"));
+	BOOST_CHECK_EQUAL(query("log", "lineno", { "Filter: host_name ~ ^test-01$" }), hostLines);
+
+	String serviceLines = query("log", "lineno", { "Filter: host_name = test-01", "Filter: service_description = livestatus" });
+	BOOST_CHECK_EQUAL(serviceLines, "[[2], [5]]\n");
+	BOOST_CHECK_EQUAL(query("log", "lineno", { "Filter: host_name ~ ^test-01$", "Filter: service_description = livestatus" }), serviceLines);
+
+	BOOST_CHECK_EQUAL(query("log", "lineno", { "Filter: host_name = test-03" }), "[]\n");
+
+	String history = query("statehist", "host_name service_description state from", { "Filter: host_name = test-01", "Filter: service_description = livestatus" });
+	BOOST_CHECK_EQUAL(history, "[[\"test-01\",\"livestatus\",2,1600001002], [\"test-01\",\"livestatus\",0,1600001005]]\n");
+	BOOST_CHECK_EQUAL(query("statehist", "host_name service_description state from", { "Filter: host_name ~ ^test-01$", "Filter: service_description = livestatus" }), history);
+
+	fs::remove_all(dir);
+}
+
+static void CreateBenchmarkObjects()
+{
+	String config = R"CONFIG(
+object ServiceGroup "bench-sg" { }
+
+for (i in range(200)) {
+  object Host "bench-" + i {
+    check_command = "dummy"
+  }
+}
+
+for (i in range(10)) {
+  apply Service "bench-svc-" + i {
+    check_command = "dummy"
+    groups = [ "bench-sg" ]
+    assign where match("bench-*", host.name)
+  }
+}
+)CONFIG";
+
+	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<livestatus-benchmark>", config);
+	ScriptFrame frame(true);
+	expr->Evaluate(frame);
+}
+
+static double BenchmarkQuery(const std::vector<String>& lines, size_t expectedRows)
+{
+	const int iterations = 20;
+	double start = Utility::GetTime();
+
+	for (int i = 0; i < iterations; i++) {
+		Array::Ptr result = JsonDecode(LivestatusQueryHelper(lines));
+		BOOST_CHECK_EQUAL(result->GetLength(), expectedRows);
+	}
+
+	return (Utility::GetTime() - start) / iterations * 1000;
+}
+
+/* Not run by default, see test/CMakeLists.txt. */
+BOOST_AUTO_TEST_CASE(services_benchmark, *boost::unit_test::disabled())
+{
+	ConfigItem::RunWithActivationContext(new Function("CreateBenchmarkObjects", CreateBenchmarkObjects));
+
+	std::vector<std::pair<String, std::vector<String>>> queries {
+		{ "full table", { } },
+		{ "checks_enabled filter", { "Filter: checks_enabled = 1", "Filter: description ~ ^bench-svc-[0-4]$" } },
+		{ "host_name filter", { "Filter: host_name = bench-42", "Filter: description ~ ^bench-svc-[0-4]$" } },
+		{ "groups filter", { "Filter: groups >= bench-sg", "Filter: host_name ~~ ^BENCH-1" } }
+	};
+
+	std::vector<size_t> expectedRows { 2002, 1000, 5, 1110 };
+
+	for (size_t i = 0; i < queries.size(); i++) {
+		std::vector<String> lines { "GET services", "Columns: host_name description state plugin_output", "OutputFormat: json" };
+		lines.insert(lines.end(), queries[i].second.begin(), queries[i].second.end());
+
+		double ms = BenchmarkQuery(lines, expectedRows[i]);
+		BOOST_TEST_MESSAGE(queries[i].first << ": " << ms << " ms");
+	}
+}
+
 //____________________________________________________________________________//
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,221 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "perfdata/perfdataspool.hpp"
+#include <boost/filesystem/directory.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <BoostTestTargetConfig.h>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+using namespace icinga;
+
+namespace fs = boost::filesystem;
+
+struct PerfdataSpoolFixture
+{
+	PerfdataSpoolFixture()
+		: Dir(fs::temp_directory_path() / fs::unique_path("icinga2-perfdataspool-%%%%-%%%%"))
+	{
+	}
+
+	~PerfdataSpoolFixture()
+	{
+		fs::remove_all(Dir);
+	}
+
+	PerfdataSpool::Ptr Open(uint64_t maxSize = 1024 * 1024) const
+	{
+		return new PerfdataSpool(Dir.string(), maxSize, 0);
+	}
+
+	fs::path Dir;
+};
+
+static std::vector<String> MakeRecords(int begin, int end)
+{
+	std::vector<String> records;
+
+	for (int i = begin; i < end; i++)
+		records.emplace_back("record-" + std::to_string(i));
+
+	return records;
+}
+
+static std::vector<String> ReplayAll(const PerfdataSpool::Ptr& spool, size_t batchSize = 1024)
+{
+	std::vector<String> records;
+
+	spool->Replay(batchSize, [&records](const std::vector<String>& batch) {
+		records.insert(records.end(), batch.begin(), batch.end());
+	});
+
+	return records;
+}
+
+BOOST_FIXTURE_TEST_SUITE(perfdata_perfdataspool, PerfdataSpoolFixture)
+
+BOOST_AUTO_TEST_CASE(append_and_replay)
+{
+	PerfdataSpool::Ptr spool = Open();
+
+	BOOST_CHECK(spool->IsEmpty());
+	BOOST_CHECK(spool->GetAge() == 0);
+
+	spool->Append(MakeRecords(0, 5));
+	spool->Append({ });
+
+	BOOST_CHECK(!spool->IsEmpty());
+	BOOST_CHECK(spool->GetRecordCount() == 5);
+	BOOST_CHECK(spool->GetSize() > 0);
+
+	std::vector<size_t> batches;
+
+	size_t replayed = spool->Replay(2, [&batches](const std::vector<String>& batch) {
+		batches.push_back(batch.size());
+	});
+
+	BOOST_CHECK(replayed == 5);
+	BOOST_CHECK(batches == std::vector<size_t>({ 2, 2, 1 }));
+	BOOST_CHECK(spool->IsEmpty());
+
+	spool->Append(MakeRecords(5, 7));
+	BOOST_CHECK(ReplayAll(spool) == MakeRecords(5, 7));
+	BOOST_CHECK(spool->Replay(1024, [](const std::vector<String>&) { BOOST_FAIL("nothing to replay"); }) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(failed_send)
+{
+	PerfdataSpool::Ptr spool = Open();
+
+	spool->Append(MakeRecords(0, 5));
+
+	/* The first batch is sent, the second one fails and stays in the spool. */
+	int calls = 0;
+
+	BOOST_CHECK_THROW(spool->Replay(2, [&calls](const std::vector<String>&) {
+		if (++calls == 2)
+			throw std::runtime_error("connection lost");
+	}), std::runtime_error);
+
+	BOOST_CHECK(spool->GetRecordCount() == 3);
+	BOOST_CHECK(ReplayAll(spool) == MakeRecords(2, 5));
+}
+
+BOOST_AUTO_TEST_CASE(send_unlocked)
+{
+	PerfdataSpool::Ptr spool = Open();
+
+	spool->Append(MakeRecords(0, 2));
+
+	std::vector<String> sent;
+
+	spool->Replay(1024, [&spool, &sent](const std::vector<String>& batch) {
+		/* Neither deadlocks nor sends the same records twice. */
+		spool->Append(MakeRecords(2, 3));
+		BOOST_CHECK(spool->Replay(1024, [](const std::vector<String>&) { BOOST_FAIL("replayed twice"); }) == 0);
+
+		sent.insert(sent.end(), batch.begin(), batch.end());
+	});
+
+	BOOST_CHECK(sent == MakeRecords(0, 2));
+	BOOST_CHECK(ReplayAll(spool) == MakeRecords(2, 3));
+	BOOST_CHECK(spool->IsEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(overflow)
+{
+	/* Segments are at least 64 KiB large. */
+	const uint64_t maxSize = 256 * 1024;
+	PerfdataSpool::Ptr spool = Open(maxSize);
+
+	String padding (1000, 'x');
+
+	for (int i = 0; i < 1000; i++)
+		spool->Append({ std::to_string(i) + padding });
+
+	size_t count = spool->GetRecordCount();
+
+	BOOST_CHECK(spool->GetSize() <= maxSize);
+	BOOST_CHECK(count > 0 && count < 1000);
+
+	/* The oldest records are dropped first. */
+	std::vector<String> records = ReplayAll(spool);
+	BOOST_REQUIRE(records.size() == count);
+	BOOST_CHECK(records.back() == "999" + padding);
+
+	for (size_t i = 1; i < records.size(); i++)
+		BOOST_CHECK(std::stoi(records[i].GetData()) == std::stoi(records[i - 1].GetData()) + 1);
+
+	BOOST_CHECK(spool->IsEmpty());
+	BOOST_CHECK(spool->GetSize() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(persistence)
+{
+	{
+		PerfdataSpool::Ptr spool = Open();
+		spool->Append(MakeRecords(0, 5));
+	}
+
+	{
+		PerfdataSpool::Ptr spool = Open();
+		BOOST_CHECK(spool->GetRecordCount() == 5);
+		BOOST_CHECK(spool->GetAge() < 60);
+
+		int calls = 0;
+
+		BOOST_CHECK_THROW(spool->Replay(2, [&calls](const std::vector<String>&) {
+			if (++calls == 2)
+				throw std::runtime_error("connection lost");
+		}), std::runtime_error);
+	}
+
+	/* Replayed records don't come back. */
+	{
+		PerfdataSpool::Ptr spool = Open();
+		BOOST_CHECK(spool->GetRecordCount() == 3);
+
+		spool->Append(MakeRecords(5, 6));
+	}
+
+	PerfdataSpool::Ptr spool = Open();
+	BOOST_CHECK(ReplayAll(spool) == MakeRecords(2, 6));
+
+	spool = nullptr;
+	spool = Open();
+	BOOST_CHECK(spool->IsEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(corrupt_record)
+{
+	PerfdataSpool::Ptr spool = Open();
+	spool->Append(MakeRecords(0, 3));
+
+	/* Replace the length of the first record with a huge one. */
+	for (fs::directory_iterator it (Dir), end; it != end; ++it) {
+		if (it->path().extension() != ".seg")
+			continue;
+
+		std::string content;
+
+		{
+			std::ifstream fp (it->path().string(), std::ifstream::binary);
+			content.assign(std::istreambuf_iterator<char>(fp), std::istreambuf_iterator<char>());
+		}
+
+		std::ofstream fp (it->path().string(), std::ofstream::binary | std::ofstream::trunc);
+		fp << "0 1000000000000000" << content.substr(content.find('\n'));
+	}
+
+	int calls = 0;
+
+	BOOST_CHECK(spool->Replay(1024, [&calls](const std::vector<String>&) { calls++; }) == 0);
+	BOOST_CHECK(calls == 0);
+	BOOST_CHECK(spool->IsEmpty());
+
+	spool->Append(MakeRecords(3, 4));
+	BOOST_CHECK(ReplayAll(spool) == MakeRecords(3, 4));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
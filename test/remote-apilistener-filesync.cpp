@@ -0,0 +1,163 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/apilistener.hpp"
+#include "base/utility.hpp"
+#include "base/workqueue.hpp"
+#include <boost/filesystem/operations.hpp>
+#include <BoostTestTargetConfig.h>
+#include <ctime>
+#include <fstream>
+
+using namespace icinga;
+
+namespace fs = boost::filesystem;
+
+struct FileSyncFixture
+{
+	FileSyncFixture()
+		: Dir(fs::temp_directory_path() / fs::unique_path("icinga2-filesync-%%%%-%%%%")),
+		ParentDir((Dir / "parent").string()), ChildDir((Dir / "child").string())
+	{
+		for (const String& dir : { ParentDir, ChildDir }) {
+			Write(dir, "/.timestamp", "1600000000.000000");
+			Write(dir, "/hosts.conf", "object Host \"host-1\" { }");
+			Write(dir, "/services.conf", "object Service \"service-1\" { }");
+			Write(dir, "/scripts/check.sh", "#!/bin/sh");
+		}
+
+		Write(ParentDir, "/.timestamp", "1600000001.000000");
+		Write(ParentDir, "/services.conf", "object Service \"service-2\" { }");
+		Write(ParentDir, "/users.conf", "object User \"user-1\" { }");
+		Write(ChildDir, "/removed.conf", "object User \"user-2\" { }");
+	}
+
+	~FileSyncFixture()
+	{
+		fs::remove_all(Dir);
+	}
+
+	/* The checksums of files modified just now aren't cached, so they'd always be sent. */
+	static void Write(const String& dir, const String& file, const String& content)
+	{
+		String path = dir + file;
+		Utility::MkDirP(Utility::DirName(path), 0755);
+
+		{
+			std::ofstream fp (path.CStr(), std::ios::out | std::ios::binary | std::ios::trunc);
+			fp << content;
+		}
+
+		fs::last_write_time(path.GetData(), std::time(nullptr) - 60);
+	}
+
+	fs::path Dir;
+	String ParentDir;
+	String ChildDir;
+};
+
+BOOST_FIXTURE_TEST_SUITE(remote_apilistener_filesync, FileSyncFixture)
+
+BOOST_AUTO_TEST_CASE(delta_update)
+{
+	/* The child sends the checksums of its files, the parent only the changed files' content.
+	 * The child takes the unchanged ones from its production copy.
+	 */
+	Dictionary::Ptr childChecksums = ApiListener::LoadConfigDirChecksums(ChildDir);
+	BOOST_CHECK(childChecksums->GetLength() == 5);
+
+	/* The parent has hashed its files before, e.g. for a previous sync. */
+	ApiListener::LoadConfigDirChecksums(ParentDir);
+
+	ConfigDirInformation update = ApiListener::LoadConfigDir(ParentDir, childChecksums);
+
+	BOOST_CHECK(update.UpdateV1->GetKeys() == std::vector<String>({ "/services.conf", "/users.conf" }));
+	BOOST_CHECK(update.UpdateV2->GetKeys() == std::vector<String>({ "/.timestamp" }));
+	BOOST_CHECK(update.Checksums->GetKeys() == std::vector<String>({ "/.timestamp", "/hosts.conf", "/scripts/check.sh", "/services.conf", "/users.conf" }));
+
+	ConfigDirInformation production = ApiListener::LoadConfigDir(ChildDir);
+	String mismatchedFile;
+
+	BOOST_REQUIRE(ApiListener::CompleteConfigUpdate(update, production, mismatchedFile));
+
+	Dictionary::Ptr expected = ApiListener::MergeConfigUpdate(ApiListener::LoadConfigDir(ParentDir));
+	Dictionary::Ptr received = ApiListener::MergeConfigUpdate(update);
+
+	BOOST_CHECK(received->GetKeys() == expected->GetKeys());
+
+	for (const String& key : expected->GetKeys())
+		BOOST_CHECK_MESSAGE(received->Get(key) == expected->Get(key), key);
+
+	BOOST_CHECK(update.UpdateV1->Contains("/hosts.conf"));
+	BOOST_CHECK(update.UpdateV2->Contains("/scripts/check.sh"));
+}
+
+BOOST_AUTO_TEST_CASE(delta_update_uncached)
+{
+	/* Unchanged files are left out even if the parent hashes them for the first time. */
+	Dictionary::Ptr childChecksums = ApiListener::LoadConfigDirChecksums(ChildDir);
+	ConfigDirInformation update = ApiListener::LoadConfigDir(ParentDir, childChecksums);
+
+	BOOST_CHECK(update.UpdateV1->GetKeys() == std::vector<String>({ "/services.conf", "/users.conf" }));
+	BOOST_CHECK(update.UpdateV2->GetKeys() == std::vector<String>({ "/.timestamp" }));
+	BOOST_CHECK(update.Checksums->GetKeys() == std::vector<String>({ "/.timestamp", "/hosts.conf", "/scripts/check.sh", "/services.conf", "/users.conf" }));
+}
+
+BOOST_AUTO_TEST_CASE(delta_update_mismatch)
+{
+	Dictionary::Ptr childChecksums = ApiListener::LoadConfigDirChecksums(ChildDir);
+	ApiListener::LoadConfigDirChecksums(ParentDir);
+
+	ConfigDirInformation update = ApiListener::LoadConfigDir(ParentDir, childChecksums);
+
+	/* The child's copy has been changed after it sent its checksums. */
+	Write(ChildDir, "/hosts.conf", "object Host \"host-10\" { }");
+
+	ConfigDirInformation production = ApiListener::LoadConfigDir(ChildDir);
+	String mismatchedFile;
+
+	BOOST_CHECK(!ApiListener::CompleteConfigUpdate(update, production, mismatchedFile));
+	BOOST_CHECK(mismatchedFile == "/hosts.conf");
+
+	/* A full update doesn't depend on the child's copy. */
+	ConfigDirInformation fullUpdate = ApiListener::LoadConfigDir(ParentDir);
+
+	BOOST_CHECK(ApiListener::CompleteConfigUpdate(fullUpdate, production, mismatchedFile));
+	BOOST_CHECK(ApiListener::MergeConfigUpdate(fullUpdate)->Get("/hosts.conf") == "object Host \"host-1\" { }");
+}
+
+BOOST_AUTO_TEST_CASE(full_update)
+{
+	ConfigDirInformation update = ApiListener::LoadConfigDir(ParentDir);
+
+	BOOST_CHECK(update.UpdateV1->GetKeys() == std::vector<String>({ "/hosts.conf", "/services.conf", "/users.conf" }));
+	BOOST_CHECK(update.UpdateV2->GetKeys() == std::vector<String>({ "/.timestamp", "/scripts/check.sh" }));
+	BOOST_CHECK(update.Checksums->GetLength() == 5);
+
+	/* Checksums of unchanged files are the same on both sides. */
+	Dictionary::Ptr parentChecksums = ApiListener::LoadConfigDirChecksums(ParentDir);
+	Dictionary::Ptr childChecksums = ApiListener::LoadConfigDirChecksums(ChildDir);
+
+	BOOST_CHECK(parentChecksums->Get("/hosts.conf") == update.Checksums->Get("/hosts.conf"));
+	BOOST_CHECK(parentChecksums->Get("/hosts.conf") == childChecksums->Get("/hosts.conf"));
+	BOOST_CHECK(parentChecksums->Get("/services.conf") != childChecksums->Get("/services.conf"));
+}
+
+BOOST_AUTO_TEST_CASE(shared_queue)
+{
+	/* Several directories may be loaded one after another via the same queue. */
+	WorkQueue upq (25000, 4);
+
+	for (const String& dir : { ParentDir, ChildDir }) {
+		Dictionary::Ptr expected = ApiListener::MergeConfigUpdate(ApiListener::LoadConfigDir(dir));
+		Dictionary::Ptr loaded = ApiListener::MergeConfigUpdate(ApiListener::LoadConfigDir(dir, nullptr, &upq));
+
+		BOOST_CHECK(loaded->GetKeys() == expected->GetKeys());
+
+		for (const String& key : expected->GetKeys())
+			BOOST_CHECK_MESSAGE(loaded->Get(key) == expected->Get(key), key);
+
+		BOOST_CHECK(ApiListener::LoadConfigDirChecksums(dir, &upq)->GetKeys() == ApiListener::LoadConfigDirChecksums(dir)->GetKeys());
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,86 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/apiuser.hpp"
+#include "base/base64.hpp"
+#include <BoostTestTargetConfig.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace icinga;
+
+static String GetAuthHeader(const String& username, const String& password)
+{
+	return "Basic " + Base64::Encode(username + ":" + password);
+}
+
+BOOST_AUTO_TEST_SUITE(remote_apiuser)
+
+BOOST_AUTO_TEST_CASE(auth_header)
+{
+	ApiUser::Ptr user = new ApiUser();
+	user->SetName("apiuser-auth-header");
+	user->SetPassword("secret");
+	user->Register();
+	user->SetActive(true);
+	user->Activate();
+
+	BOOST_CHECK(ApiUser::GetByAuthHeader(GetAuthHeader("apiuser-auth-header", "secret")) == user);
+
+	/* Served from the cache */
+	BOOST_CHECK(ApiUser::GetByAuthHeader(GetAuthHeader("apiuser-auth-header", "secret")) == user);
+
+	BOOST_CHECK(!ApiUser::GetByAuthHeader(GetAuthHeader("apiuser-auth-header", "wrong")));
+	BOOST_CHECK(!ApiUser::GetByAuthHeader(GetAuthHeader("apiuser-auth-header", "")));
+	BOOST_CHECK(!ApiUser::GetByAuthHeader(GetAuthHeader("apiuser-nonexistent", "secret")));
+	BOOST_CHECK(!ApiUser::GetByAuthHeader("Bearer secret"));
+
+	user->Deactivate();
+	user->Unregister();
+}
+
+BOOST_AUTO_TEST_CASE(password_rotation)
+{
+	ApiUser::Ptr user = new ApiUser();
+	user->SetName("apiuser-password-rotation");
+	user->SetPassword("password-0");
+	user->Register();
+	user->SetActive(true);
+	user->Activate();
+
+	String header = GetAuthHeader("apiuser-password-rotation", "password-0");
+
+	BOOST_CHECK(ApiUser::GetByAuthHeader(header) == user);
+
+	/* Authentications racing with the password change must not leave the
+	 * old password in the cache once the change is done. */
+	for (int i = 1; i <= 100; i++) {
+		std::atomic<bool> stop (false);
+		std::vector<std::thread> threads;
+
+		for (int j = 0; j < 4; j++) {
+			threads.emplace_back([&header, &stop]() {
+				while (!stop)
+					ApiUser::GetByAuthHeader(header);
+			});
+		}
+
+		user->SetPassword("password-" + std::to_string(i));
+
+		stop = true;
+
+		for (auto& thread : threads)
+			thread.join();
+
+		BOOST_REQUIRE_MESSAGE(!ApiUser::GetByAuthHeader(header), "old password accepted after rotation " + std::to_string(i));
+
+		header = GetAuthHeader("apiuser-password-rotation", "password-" + std::to_string(i));
+
+		BOOST_REQUIRE(ApiUser::GetByAuthHeader(header) == user);
+	}
+
+	user->Deactivate();
+	user->Unregister();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,186 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "icinga/host.hpp"
+#include "remote/filterutility.hpp"
+#include "remote/objectindex.hpp"
+#include "base/array.hpp"
+#include <BoostTestTargetConfig.h>
+#include <algorithm>
+
+using namespace icinga;
+
+static Host::Ptr CreateHost(const String& name)
+{
+	Host::Ptr host = new Host();
+	host->SetName(name);
+	host->Register();
+	host->SetActive(true);
+	host->Activate();
+	host->SetAuthority(true);
+	host->SetStateRaw(ServiceOK);
+
+	return host;
+}
+
+static void DestroyHost(const Host::Ptr& host)
+{
+	host->Deactivate();
+	host->Unregister();
+}
+
+static bool Contains(const std::vector<ConfigObject::Ptr>& objects, const ConfigObject::Ptr& object)
+{
+	return std::find(objects.begin(), objects.end(), object) != objects.end();
+}
+
+static std::vector<ConfigObject::Ptr> FindInIndex(const String& attribute, const Value& value)
+{
+	ObjectIndex::Ptr index = ObjectIndex::GetByAttribute(Host::TypeInstance, attribute);
+	BOOST_REQUIRE(index);
+
+	std::vector<ConfigObject::Ptr> result;
+	BOOST_CHECK(index->Find(value, result));
+
+	return result;
+}
+
+static bool GetCandidates(const String& filter, const Dictionary::Ptr& filterVars, std::vector<ConfigObject::Ptr>& candidates)
+{
+	Expression::Ptr expr = FilterUtility::CompileFilter(filter);
+
+	return FilterUtility::GetIndexedCandidates("Host", expr.get(), filterVars, String(), candidates);
+}
+
+static std::vector<Value> GetFilterTargets(const String& filter)
+{
+	QueryDescription qd;
+	qd.Types.insert("Host");
+
+	Dictionary::Ptr query = new Dictionary({
+		{ "type", "Host" },
+		{ "filter", filter }
+	});
+
+	return FilterUtility::GetFilterTargets(qd, query, nullptr);
+}
+
+BOOST_AUTO_TEST_SUITE(remote_objectindex)
+
+BOOST_AUTO_TEST_CASE(maintenance)
+{
+	Host::Ptr host = CreateHost("objectindex-maintenance");
+
+	BOOST_CHECK(Contains(FindInIndex("state", HostUp), host));
+	BOOST_CHECK(!Contains(FindInIndex("state", HostDown), host));
+
+	host->SetStateRaw(ServiceCritical);
+	BOOST_CHECK(!Contains(FindInIndex("state", HostUp), host));
+	BOOST_CHECK(Contains(FindInIndex("state", HostDown), host));
+
+	/* Numbers and booleans share their keys, just like == does. */
+	BOOST_CHECK(Contains(FindInIndex("state", true), host));
+
+	BOOST_CHECK(FindInIndex("groups", "objectindex-a").empty());
+
+	host->SetGroups(new Array({ "objectindex-a", "objectindex-b" }));
+	BOOST_CHECK(Contains(FindInIndex("groups", "objectindex-a"), host));
+	BOOST_CHECK(Contains(FindInIndex("groups", "objectindex-b"), host));
+
+	host->SetGroups(new Array({ "objectindex-b" }));
+	BOOST_CHECK(FindInIndex("groups", "objectindex-a").empty());
+	BOOST_CHECK(Contains(FindInIndex("groups", "objectindex-b"), host));
+
+	host->AddGroup("objectindex-c");
+	BOOST_CHECK(Contains(FindInIndex("groups", "objectindex-c"), host));
+
+	ObjectIndex::Ptr index = ObjectIndex::GetByAttribute(Host::TypeInstance, "groups");
+	BOOST_CHECK(index->GetCount("objectindex-b") == 1);
+	BOOST_CHECK(index->GetCount(new Array()) == SIZE_MAX);
+
+	DestroyHost(host);
+
+	BOOST_CHECK(!Contains(FindInIndex("state", HostDown), host));
+	BOOST_CHECK(FindInIndex("groups", "objectindex-b").empty());
+	BOOST_CHECK(FindInIndex("groups", "objectindex-c").empty());
+
+	/* Inactive objects stay out of the index. */
+	host->SetStateRaw(ServiceOK);
+	BOOST_CHECK(!Contains(FindInIndex("state", HostUp), host));
+}
+
+BOOST_AUTO_TEST_CASE(planner)
+{
+	Host::Ptr up = CreateHost("objectindex-planner-up");
+	Host::Ptr down = CreateHost("objectindex-planner-down");
+
+	down->SetStateRaw(ServiceCritical);
+	up->SetGroups(new Array({ "objectindex-planner" }));
+
+	std::vector<ConfigObject::Ptr> candidates;
+
+	BOOST_CHECK(GetCandidates("host.state == 1", nullptr, candidates));
+	BOOST_CHECK(Contains(candidates, down));
+	BOOST_CHECK(!Contains(candidates, up));
+
+	/* The smallest bucket wins. */
+	candidates.clear();
+	BOOST_CHECK(GetCandidates("host.state == 0 && \"objectindex-planner\" in host.groups", nullptr, candidates));
+	BOOST_CHECK(candidates.size() == 1);
+	BOOST_CHECK(Contains(candidates, up));
+
+	candidates.clear();
+	BOOST_CHECK(GetCandidates("1 == obj.state && host.name != \"\"", nullptr, candidates));
+	BOOST_CHECK(Contains(candidates, down));
+	BOOST_CHECK(!Contains(candidates, up));
+
+	candidates.clear();
+	BOOST_CHECK(GetCandidates("host.state == s", new Dictionary({ { "s", 1 } }), candidates));
+	BOOST_CHECK(Contains(candidates, down));
+	BOOST_CHECK(!Contains(candidates, up));
+
+	/* Filters which can't be answered from an index fall back to a full scan. */
+	candidates.clear();
+	BOOST_CHECK(!GetCandidates("host.state == 1 || host.state == 0", nullptr, candidates));
+	BOOST_CHECK(!GetCandidates("host.state != 1", nullptr, candidates));
+	BOOST_CHECK(!GetCandidates("host.name == \"objectindex-planner-up\"", nullptr, candidates));
+	BOOST_CHECK(!GetCandidates("host.state == s", nullptr, candidates));
+	BOOST_CHECK(!GetCandidates("host.state == host.last_hard_state", nullptr, candidates));
+	BOOST_CHECK(!GetCandidates("host.state == [ 1 ]", nullptr, candidates));
+	BOOST_CHECK(!GetCandidates("match(\"objectindex-*\", host.name)", nullptr, candidates));
+	BOOST_CHECK(candidates.empty());
+
+	DestroyHost(up);
+	DestroyHost(down);
+}
+
+BOOST_AUTO_TEST_CASE(filter_targets)
+{
+	Host::Ptr up = CreateHost("objectindex-targets-up");
+	Host::Ptr down = CreateHost("objectindex-targets-down");
+
+	down->SetStateRaw(ServiceCritical);
+
+	/* Indexed and full scan queries have to return the same objects. */
+	std::vector<Value> indexed = GetFilterTargets("host.state == 1 && match(\"objectindex-targets-*\", host.name)");
+	std::vector<Value> scanned = GetFilterTargets("(host.state == 1 || false) && match(\"objectindex-targets-*\", host.name)");
+
+	BOOST_REQUIRE(indexed.size() == 1);
+	BOOST_CHECK(indexed == scanned);
+	BOOST_CHECK(indexed[0] == down);
+
+	down->SetStateRaw(ServiceOK);
+
+	indexed = GetFilterTargets("host.state == 1 && match(\"objectindex-targets-*\", host.name)");
+	BOOST_CHECK(indexed.empty());
+
+	indexed = GetFilterTargets("host.state == 0 && match(\"objectindex-targets-*\", host.name)");
+	BOOST_CHECK(indexed.size() == 2);
+
+	DestroyHost(up);
+	DestroyHost(down);
+
+	indexed = GetFilterTargets("host.state == 0 && match(\"objectindex-targets-*\", host.name)");
+	BOOST_CHECK(indexed.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
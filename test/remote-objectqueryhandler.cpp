@@ -0,0 +1,112 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "icinga/host.hpp"
+#include "remote/apiuser.hpp"
+#include "remote/httpserverconnection.hpp"
+#include "remote/httputility.hpp"
+#include "remote/objectqueryhandler.hpp"
+#include "remote/url.hpp"
+#include "base/array.hpp"
+#include "base/json.hpp"
+#include "base/tlsstream.hpp"
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/spawn.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+namespace asio = boost::asio;
+namespace http = boost::beast::http;
+
+/**
+ * Runs an object query through ObjectQueryHandler.
+ *
+ * The handler only touches the connection in streamed mode, so it is
+ * connected to a listening socket nobody ever accepts.
+ */
+static http::response<http::string_body> Query(const String& path)
+{
+	asio::io_context io;
+	asio::ssl::context sslContext (asio::ssl::context::tls);
+
+	auto stream (Shared<AsioTlsStream>::Make(io, sslContext));
+	asio::ip::tcp::acceptor acceptor (io, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+	stream->lowest_layer().connect(acceptor.local_endpoint());
+
+	HttpServerConnection::Ptr server = new HttpServerConnection(String(), false, stream);
+
+	ApiUser::Ptr user = new ApiUser();
+	user->SetPermissions(new Array({ "*" }));
+
+	Url::Ptr url = new Url(path);
+	Dictionary::Ptr params = HttpUtility::FetchRequestParameters(url, "");
+
+	http::request<http::string_body> request (http::verb::get, std::string(path), 11);
+	http::response<http::string_body> response;
+
+	asio::spawn(io, [&](asio::yield_context yc) {
+		ObjectQueryHandler::Ptr handler = new ObjectQueryHandler();
+
+		BOOST_CHECK(handler->HandleRequest(*stream, user, request, url, response, params, yc, *server));
+	});
+
+	io.run();
+
+	return response;
+}
+
+static void CheckInvalidLimit(const String& limit)
+{
+	auto response (Query("/v1/objects/hosts?limit=" + limit));
+
+	BOOST_CHECK_MESSAGE(response.result() == http::status::bad_request, "limit=" + limit);
+}
+
+BOOST_AUTO_TEST_SUITE(remote_objectqueryhandler)
+
+BOOST_AUTO_TEST_CASE(limit)
+{
+	std::vector<Host::Ptr> hosts;
+
+	for (const char *name : { "objectqueryhandler-1", "objectqueryhandler-2", "objectqueryhandler-3" }) {
+		Host::Ptr host = new Host();
+		host->SetName(name);
+		host->Register();
+		hosts.emplace_back(host);
+	}
+
+	CheckInvalidLimit("0");
+	CheckInvalidLimit("-1");
+	CheckInvalidLimit("-1e400");
+	CheckInvalidLimit("0.5");
+	CheckInvalidLimit("foo");
+	CheckInvalidLimit("nan");
+	CheckInvalidLimit("inf");
+	CheckInvalidLimit("1e400");
+
+	auto response (Query("/v1/objects/hosts?limit=2&filter=match(%22objectqueryhandler-*%22,host.name)"));
+	BOOST_CHECK(response.result() == http::status::ok);
+
+	Dictionary::Ptr result = JsonDecode(response.body());
+	Array::Ptr results = result->Get("results");
+	BOOST_CHECK(results->GetLength() == 2);
+	BOOST_CHECK(result->Get("next_cursor") == "objectqueryhandler-2");
+
+	/* Huge limits are capped rather than overflowing size_t. */
+	for (const char *limit : { "4294967296", "1e19", "1e300" }) {
+		response = Query("/v1/objects/hosts?filter=match(%22objectqueryhandler-*%22,host.name)&limit=" + String(limit));
+		BOOST_CHECK_MESSAGE(response.result() == http::status::ok, String("limit=") + limit);
+
+		result = JsonDecode(response.body());
+		results = result->Get("results");
+		BOOST_CHECK(results->GetLength() == 3);
+		BOOST_CHECK(!result->Contains("next_cursor"));
+	}
+
+	for (const Host::Ptr& host : hosts)
+		host->Unregister();
+}
+
+BOOST_AUTO_TEST_SUITE_END()